@@ -88,6 +88,17 @@ class EXPORT SMCBatteryManager : public IOService {
 	 */
 	IONotifier *vsmcNotifier {nullptr};
 
+	/**
+	 *  Owned key ranges
+	 */
+	const VirtualSMCAPI::KeyRange keyRanges[5] {
+		VirtualSMCAPI::makeKeyRange('A', 'C'),
+		VirtualSMCAPI::makeKeyRange('B'),
+		VirtualSMCAPI::makeKeyRange('C', 'H'),
+		VirtualSMCAPI::makeKeyRange('D'),
+		VirtualSMCAPI::makeKeyRange('T', 'B')
+	};
+
 	/**
 	 *  Registered plugin instance
 	 */
@@ -95,6 +106,10 @@ class EXPORT SMCBatteryManager : public IOService {
 		xStringify(PRODUCT_NAME),
 		parseModuleVersion(xStringify(MODULE_VERSION)),
 		VirtualSMCAPI::Version,
+		{},
+		{},
+		keyRanges,
+		arrsize(keyRanges)
 	};
 
 public:
@@ -123,24 +123,19 @@ bool SMCLightSensor::vsmcNotificationHandler(void *sensors, void *refCon, IOServ
 		if (ret == kIOReturnSuccess) {
 			DBGLOG("asld", "submitted plugin");
 
-			self->workloop = self->getWorkLoop();
-			self->poller = IOTimerEventSource::timerEventSource(self, [](OSObject *object, IOTimerEventSource *sender) {
-				auto ls = OSDynamicCast(SMCLightSensor, object);
+			VirtualSMCAPI::SamplingTask task {};
+			task.action = [](void *context) {
+				auto ls = OSDynamicCast(SMCLightSensor, static_cast<OSObject *>(context));
 				if (ls) ls->refreshSensor(true);
-			});
-
-			if (!self->poller || !self->workloop) {
-				SYSLOG("asld", "failed to create poller or workloop");
-				return false;
-			}
-
-			if (self->workloop->addEventSource(self->poller) != kIOReturnSuccess) {
-				SYSLOG("asld", "failed to add timer event source to workloop");
-				return false;
-			}
-
-			if (self->poller->setTimeoutMS(SensorUpdateTimeoutMS) != kIOReturnSuccess) {
-				SYSLOG("asld", "failed to set timeout");
+			};
+			task.context = self;
+			task.periodMs = SensorUpdateTimeoutMS;
+			task.jitterMs = SensorUpdateJitterMS;
+			task.costUs = SensorUpdateCostUS;
+			self->poller = VirtualSMCAPI::registerSamplingTask(task);
+
+			if (!self->poller) {
+				SYSLOG("asld", "failed to register poller");
 				return false;
 			}
 
@@ -165,10 +160,8 @@ bool SMCLightSensor::refreshSensor(bool post) {
 
 	atomic_store_explicit(&currentLux, lux, memory_order_release);
 
-	if (post) {
+	if (post)
 		VirtualSMCAPI::postInterrupt(SmcEventALSChange);
-		poller->setTimeoutMS(SensorUpdateTimeoutMS);
-	}
 
 	return ret == kIOReturnSuccess;
 }
@@ -178,12 +171,8 @@ void SMCLightSensor::stop(IOService *provider) {
 
 	// In case this is supported one day
 #if 0
-	if (poller)
-		poller->cancelTimeout();
-	if (workloop && poller)
-		workloop->removeEventSource(poller);
-	OSSafeReleaseNULL(workloop);
-	OSSafeReleaseNULL(poller);
+	VirtualSMCAPI::unregisterTimer(poller);
+	poller = 0;
 #endif
 }
 
@@ -13,7 +13,6 @@
 #include <Headers/kern_util.hpp>
 
 #include <IOKit/acpi/IOACPIPlatformDevice.h>
-#include <IOKit/IOTimerEventSource.h>
 
 #include "AmbientLightValue.hpp"
 
@@ -26,14 +25,9 @@ class EXPORT SMCLightSensor : public IOService {
 	IONotifier *vsmcNotifier {nullptr};
 
 	/**
-	 *  A workloop in charge of handling timer events with requests.
+	 *  Shared VirtualSMC sampling task for status updates
 	 */
-	IOWorkLoop *workloop {nullptr};
-
-	/**
-	 *  Workloop timer event source for status updates
-	 */
-	IOTimerEventSource *poller {nullptr};
+	uint32_t poller {0};
 
 	/**
 	 *  Refresh sensor values to inform macOS with light changes
@@ -47,6 +41,16 @@ class EXPORT SMCLightSensor : public IOService {
 	 */
 	static constexpr uint32_t SensorUpdateTimeoutMS {1000};
 
+	/**
+	 *  Allowed interrupt submission deviation to share timer wakeups
+	 */
+	static constexpr uint32_t SensorUpdateJitterMS {100};
+
+	/**
+	 *  Expected _ALI evaluation duration
+	 */
+	static constexpr uint32_t SensorUpdateCostUS {500};
+
 	/**
 	 *  Key name definitions
 	 */
@@ -60,6 +64,15 @@ class EXPORT SMCLightSensor : public IOService {
 	static constexpr SMC_KEY KeyLKSS = SMC_MAKE_IDENTIFIER('L','K','S','S');
 	static constexpr SMC_KEY KeyMSLD = SMC_MAKE_IDENTIFIER('M','S','L','D');
 
+	/**
+	 *  Owned key ranges
+	 */
+	const VirtualSMCAPI::KeyRange keyRanges[3] {
+		VirtualSMCAPI::makeKeyRange('A', 'L'),
+		VirtualSMCAPI::makeKeyRange('L', 'K'),
+		{KeyMSLD, KeyMSLD}
+	};
+
 	/**
 	 *  Registered plugin instance
 	 */
@@ -67,6 +80,10 @@ class EXPORT SMCLightSensor : public IOService {
 		xStringify(PRODUCT_NAME),
 		parseModuleVersion(xStringify(MODULE_VERSION)),
 		VirtualSMCAPI::Version,
+		{},
+		{},
+		keyRanges,
+		arrsize(keyRanges)
 	};
 
 	/**
@@ -62,77 +62,32 @@ void SMCProcessor::readRapl() {
 	}
 }
 
-bool SMCProcessor::bindCurrentThreadToCpu(uint32_t cpu)
-{
-	// Obtain power management callbacks
-	pmCallBacks_t callbacks {};
-	pmKextRegister(PM_DISPATCH_VERSION, nullptr, &callbacks);
-	
-	if (!callbacks.LCPUtoProcessor) {
-		SYSLOG("scpu", "failed to obtain LCPUtoProcessor");
-		return false;
-	}
-	
-	if (!callbacks.ThreadBind) {
-		SYSLOG("scpu", "failed to obtain ThreadBind");
-		return false;
-	}
-	
-	auto preemptionLock = IOSimpleLockAlloc();
-	if (!preemptionLock) {
-		SYSLOG("scpu", "Preemption lock cannot be allocated");
-		return false;
-	}
-	
-	IOSimpleLockLock(preemptionLock);
-	
-	bool success = true;
-	auto enable = ml_set_interrupts_enabled(FALSE);
-	auto processor = callbacks.LCPUtoProcessor(cpu);
-	if (processor != nullptr) {
-		callbacks.ThreadBind(processor);
-	} else {
-		SYSLOG("scpu", "failed to call LCPUtoProcessor with cpu %u", cpu);
-		success = false;
-	}
-
-	IOSimpleLockUnlock(preemptionLock);
-	ml_set_interrupts_enabled(enable);
-	
-	IOSimpleLockFree(preemptionLock);
-
-	return success;
-}
-
-void SMCProcessor::staticThreadEntry(thread_call_param_t param0, thread_call_param_t param1)
-{
-	auto *that = OSDynamicCast(SMCProcessor, reinterpret_cast<OSObject*>(param0));
-	if (!that) {
-		SYSLOG("scpu", "Failed to get pointer to SMIMonitor");
-		return;
-	}
-	
-	uint32_t cpu = static_cast<uint32_t>(reinterpret_cast<uint64_t>(param1));
-	// This should not happen
-	if (cpu >= CPUInfo::MaxCpus) {
-		SYSLOG("scpu", "CPU number cannot exceed %zu", CPUInfo::MaxCpus);
-		return;
+bool SMCProcessor::registerSamplers() {
+	VirtualSMCAPI::SamplingTask task {};
+	task.action = [](void *context) {
+		// Sampling tasks run on a thread bound to their CPU.
+		auto cp = OSDynamicCast(SMCProcessor, static_cast<OSObject *>(context));
+		if (cp) cp->updateCounters(cpu_number());
+	};
+	task.context = this;
+	task.periodMs = TimerTimeoutMs;
+	task.jitterMs = SamplerJitterMs;
+	task.costUs = SamplerCostUs;
+
+	for (uint32_t cpu = 0; cpu < cpuTopology.totalLogical() && cpu < CPUInfo::MaxCpus; cpu++) {
+		// Hyper-threaded cores are ignored by updateCounters.
+		if (cpuTopology.numberToLogical[cpu] >= cpuTopology.physicalCount[cpuTopology.numberToPackage[cpu]])
+			continue;
+
+		task.cpu = static_cast<int32_t>(cpu);
+		samplers[cpu] = VirtualSMCAPI::registerSamplingTask(task);
+		if (!samplers[cpu]) {
+			SYSLOG("scpu", "failed to register sampler for cpu %u", cpu);
+			return false;
+		}
 	}
-	
-	DBGLOG("scpu", "staticThreadEntry for CPU number %u is started", cpu);
 
-	if (!that->bindCurrentThreadToCpu(cpu))
-		return;
-#ifdef DEBUG
-	auto enable = ml_set_interrupts_enabled(FALSE);
-	assert(cpu_number() == cpu);
-	ml_set_interrupts_enabled(enable);
-#endif
-	
-	while (true) {
-		IOSleep(TimerTimeoutMs);
-		that->updateCounters(cpu);
-	}
+	return true;
 }
 
 void SMCProcessor::updateCounters(uint32_t cpu) {
@@ -400,29 +355,11 @@ bool SMCProcessor::start(IOService *provider) {
 
 	DBGLOG("scpu", "read tjmax is %d", counters.tjmax[0]);
 	
-	if (success) {
-		for (uint32_t cpu=0; cpu < cpuTopology.totalLogical(); ++cpu) {
-			threadHandles[cpu] = thread_call_allocate(staticThreadEntry, this);
-			if (threadHandles[cpu])
-				thread_call_enter1(threadHandles[cpu], reinterpret_cast<thread_call_param_t>(cpu));
-			else {
-				SYSLOG("scpu", "Thread for cpu %u cannot be created", cpu);
-				success = false;
-				break;
-			}
-		}
-	}
-	
 	if (!success) {
 		if (counterLock) {
 			IOSimpleLockFree(counterLock);
 			counterLock = nullptr;
 		}
-		for (uint8_t cpu=0; cpu < cpuTopology.totalLogical(); ++cpu) {
-			while (threadHandles[cpu] && !thread_call_free(threadHandles[cpu]))
-				thread_call_cancel(threadHandles[cpu]);
-			threadHandles[cpu] = nullptr;
-		}
 		OSSafeReleaseNULL(workloop);
 		OSSafeReleaseNULL(timerEventSource);
 		return false;
@@ -487,11 +424,11 @@ void SMCProcessor::quickReschedule() {
 bool SMCProcessor::vsmcNotificationHandler(void *sensors, void *refCon, IOService *vsmc, IONotifier *notifier) {
 	if (sensors && vsmc) {
 		DBGLOG("scpu", "got vsmc notification");
-		auto &plugin = static_cast<SMCProcessor *>(sensors)->vsmcPlugin;
-		auto ret = vsmc->callPlatformFunction(VirtualSMCAPI::SubmitPlugin, true, sensors, &plugin, nullptr, nullptr);
+		auto self = static_cast<SMCProcessor *>(sensors);
+		auto ret = vsmc->callPlatformFunction(VirtualSMCAPI::SubmitPlugin, true, sensors, &self->vsmcPlugin, nullptr, nullptr);
 		if (ret == kIOReturnSuccess) {
 			DBGLOG("scpu", "submitted plugin");
-			return true;
+			return self->registerSamplers();
 		} else if (ret != kIOReturnUnsupported) {
 			SYSLOG("scpu", "plugin submission failure %X", ret);
 		} else {
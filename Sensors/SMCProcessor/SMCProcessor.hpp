@@ -28,6 +28,15 @@ class EXPORT SMCProcessor : public IOService {
 	 */
 	IONotifier *vsmcNotifier {nullptr};
 
+	/**
+	 *  Owned key ranges
+	 */
+	const VirtualSMCAPI::KeyRange keyRanges[3] {
+		VirtualSMCAPI::makeKeyRange('P', 'C'),
+		VirtualSMCAPI::makeKeyRange('T', 'C'),
+		VirtualSMCAPI::makeKeyRange('V', 'C')
+	};
+
 	/**
 	 *  Registered plugin instance
 	 */
@@ -35,6 +44,10 @@ class EXPORT SMCProcessor : public IOService {
 		xStringify(PRODUCT_NAME),
 		parseModuleVersion(xStringify(MODULE_VERSION)),
 		VirtualSMCAPI::Version,
+		{},
+		{},
+		keyRanges,
+		arrsize(keyRanges)
 	};
 
 	/**
@@ -212,24 +225,28 @@ class EXPORT SMCProcessor : public IOService {
 	 *  CPU model info
 	 */
 	uint32_t cpuFamily {0}, cpuModel {0}, cpuStepping {0};
-		
+
 	/**
-	 *  Array of thread' handles used to update cpu specific counters
+	 *  Shared VirtualSMC sampling tasks updating CPU specific counters, indexed by CPU number
 	 */
-	thread_call_t threadHandles[CPUInfo::MaxCpus] {};
-	
+	uint32_t samplers[CPUInfo::MaxCpus] {};
+
 	/**
-	 *  Helper function to bind current thread to specified CPU
+	 *  Allowed counter update deviation to share timer wakeups
 	 */
-	bool bindCurrentThreadToCpu(uint32_t cpu);
-	
+	static constexpr uint32_t SamplerJitterMs {50};
+
 	/**
-	 *  static Thread Entry method
+	 *  Expected counter update duration on a single CPU
+	 */
+	static constexpr uint32_t SamplerCostUs {20};
+
+	/**
+	 *  Register counter update tasks bound to every physical core
 	 *
-	 *  @param param0 unused
-	 *  @param param1 unused
+	 *  @return true on success
 	 */
-	static void staticThreadEntry(thread_call_param_t param0, thread_call_param_t param1);
+	bool registerSamplers();
 
 	/**
 	 *  Timer scheduling status
@@ -85,7 +85,7 @@ namespace EC {
 	SMC_KEY ECDeviceNUC::getTemperatureSMCKeyForType(uint16_t type, int index) {
 		switch (type) {
 			case B_NUC_EC_TEMP_TYPE_INTERNAL_AMBIENT: return KeyTH0P(index);
-			case B_NUC_EC_TEMP_TYPE_CPU_VRM: return KeyTC0P(index);
+			case B_NUC_EC_TEMP_TYPE_CPU_VRM: return KeyInvalid; // don't override SMCProcessor value
 			case B_NUC_EC_TEMP_TYPE_DGPU_VRM: return KeyTG0P(index);
 			case B_NUC_EC_TEMP_TYPE_SSD_M2_SLOT_1: return KeyTH0P(0);
 			case B_NUC_EC_TEMP_TYPE_MEMORY: return KeyTM0P(index);
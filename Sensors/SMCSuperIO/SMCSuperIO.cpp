@@ -26,9 +26,14 @@ uint32_t ADDPR(debugPrintDelay) = 0;
 
 void SMCSuperIO::timerCallback() {
 	dataSource->update();
+	// Back off while nobody reads the keys, the next read restores the default rate via quickReschedule.
+	if (atomic_exchange_explicit(&keysRead, false, memory_order_relaxed))
+		timerTimeout = TimerTimeoutMs;
+	else if (timerTimeout < TimerTimeoutMaxMs)
+		timerTimeout *= 2;
 	// timerEventSource->setTimeoutMS calls thread_call_enter_delayed_with_leeway, which spins.
 	// If the previous one was too long ago, schedule another one for differential recalculation!
-	timerEventSource->setTimeoutMS(TimerTimeoutMs);
+	timerEventSource->setTimeoutMS(timerTimeout);
 	atomic_flag_clear_explicit(&timerEventScheduled, memory_order_release);
 }
 
@@ -101,6 +106,7 @@ startFailed:
 }
 
 void SMCSuperIO::quickReschedule() {
+	atomic_store_explicit(&keysRead, true, memory_order_relaxed);
 	if (!atomic_flag_test_and_set_explicit(&timerEventScheduled, memory_order_acquire)) {
 		// Make it 10 times faster
 		timerEventSource->setTimeoutMS(TimerTimeoutMs/10);
@@ -65,6 +65,22 @@ private:
 	 */
 	SuperIODevice *dataSource {nullptr};
 	
+	/**
+	 *  Owned key ranges
+	 */
+	const VirtualSMCAPI::KeyRange keyRanges[10] {
+		VirtualSMCAPI::makeKeyRange('F'),
+		VirtualSMCAPI::makeKeyRange('T', 'A'),
+		VirtualSMCAPI::makeKeyRange('T', 'G'),
+		VirtualSMCAPI::makeKeyRange('T', 'H'),
+		VirtualSMCAPI::makeKeyRange('T', 'M'),
+		VirtualSMCAPI::makeKeyRange('T', 'P'),
+		VirtualSMCAPI::makeKeyRange('T', 'V'),
+		VirtualSMCAPI::makeKeyRange('V', '5'),
+		VirtualSMCAPI::makeKeyRange('V', 'D'),
+		VirtualSMCAPI::makeKeyRange('V', 'M')
+	};
+
 	/**
 	 *  Registered plugin instance
 	 */
@@ -72,6 +88,10 @@ private:
 		xStringify(PRODUCT_NAME),
 		parseModuleVersion(xStringify(MODULE_VERSION)),
 		VirtualSMCAPI::Version,
+		{},
+		{},
+		keyRanges,
+		arrsize(keyRanges)
 	};
 
 	/**
@@ -89,6 +109,21 @@ private:
 	 */
 	static constexpr uint32_t TimerTimeoutMs {500};
 
+	/**
+	 *  Longest event timer timeout, reached while nobody reads the keys
+	 */
+	static constexpr uint32_t TimerTimeoutMaxMs {8000};
+
+	/**
+	 *  Current event timer timeout, only accessed from the timer callback
+	 */
+	uint32_t timerTimeout {TimerTimeoutMs};
+
+	/**
+	 *  Keys were read since the last timer callback
+	 */
+	_Atomic(bool) keysRead {false};
+
 	/**
 	 *  Maximum delta between timer triggers for a reschedule
 	 */
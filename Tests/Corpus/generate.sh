@@ -0,0 +1,69 @@
+#!/bin/bash
+#
+#  generate.sh
+#  VirtualSMC Tests
+#
+#  Copyright © 2026 vit9696. All rights reserved.
+#
+#  Regenerates the fuzzing seeds in this directory. The seeds model AppleSMC
+#  transactions, see README.md for the input encoding.
+#
+
+cd "$(dirname "$0")" || exit 1
+rm -rf pmio mmio
+mkdir -p pmio mmio
+
+hex() { printf "\\x$1"; }
+chars() { local s=$1; for ((i = 0; i < ${#s}; i++)); do printf '%02x ' "'${s:i:1}"; done; }
+
+# PMIO: operation and value pairs (0 command, 1 write, 2 read, 3 status, 4 result, 5 interrupt)
+pcmd() { hex 00; hex "$1"; }
+pwrite() { for b in "$@"; do hex 01; hex "$b"; done; }
+pread() { for ((n = 0; n < $1; n++)); do hex 02; hex 00; hex 03; hex 00; done; }
+presult() { hex 04; hex 00; }
+pintr() { hex 05; hex "$1"; }
+
+pmio_read() { pcmd 10; pwrite $(chars "$1") "$2"; pread $((16#$2)); presult; }
+pmio_write() { local k=$1; shift; pcmd 11; pwrite $(chars "$k") "$(printf '%02x' $#)" "$@"; presult; }
+pmio_info() { pcmd 13; pwrite $(chars "$1"); pread 6; presult; }
+pmio_index() { pcmd 12; pwrite 00 00 00 "$1"; pread 4; presult; }
+
+pmio_read TC0P 02 > pmio/read_tc0p
+pmio_read XXXX 02 > pmio/read_missing
+pmio_read TC0P 04 > pmio/read_wrong_size
+pmio_write NATJ 01 > pmio/write_natj
+pmio_write TC0P 30 00 > pmio/write_read_only
+pmio_info TC0P > pmio/info_tc0p
+pmio_index 00 > pmio/index_zero
+{ pcmd 11; pwrite $(chars HBKP) 80 00 01 02 03; presult; } > pmio/write_oversize
+{ pcmd 14; pwrite 00; presult; } > pmio/reset
+{ pcmd 10; pread 1; pwrite $(chars TC0P); pcmd 10; pwrite $(chars TC0P) 02; pread 2; presult; } > pmio/collision
+# Startup: walk the keys, query their info and read them
+{ for i in 00 01 02 03 04 05; do pmio_index $i; done; pmio_read '#KEY' 04; pmio_info 'REV '; pmio_read 'REV ' 06; } > pmio/startup
+# Monitoring: temperature and fan reads with an event in between
+{ for n in 1 2 3; do pmio_read TC0P 02; pmio_read F0Ac 02; pintr 01; done; pmio_info F0Tg; } > pmio/monitoring
+
+# MMIO: operation and arguments (0 store off val, 1 command cmd, 2 key status, 3 event status,
+# 4 post code size, 5 direct write lo hi val, 6 direct read lo hi)
+mstore() { hex 00; hex "$1"; hex "$2"; }
+mkey() { local off=$((16#78)); for b in "$@"; do mstore "$(printf '%02x' $off)" "$b"; off=$((off + 1)); done; }
+mtx() { mstore 7d "$2"; mstore 7e 00; hex 01; hex "$1"; hex 03; hex 02; }
+mdirect() { local off=$((16#$1)); shift; for b in "$@"; do hex 05; hex "$(printf '%02x' $off)"; hex 00; hex "$b"; off=$((off + 1)); done; }
+mdata() { local off=0; for b in "$@"; do mstore "$(printf '%02x' $off)" "$b"; off=$((off + 1)); done; }
+
+mmio_read() { mkey $(chars "$1"); mtx 10 "$2"; }
+mmio_write() { local k=$1; shift; mdata "$@"; mkey $(chars "$k"); mtx 11 "$(printf '%02x' $#)"; }
+
+mmio_read TC0P 02 > mmio/read_tc0p
+mmio_read XXXX 02 > mmio/read_missing
+mmio_write NATJ 01 > mmio/write_natj
+mmio_write TC0P 30 00 > mmio/write_read_only
+{ mkey $(chars TC0P); mtx 13 00; } > mmio/info_tc0p
+{ mkey 00 00 00 03; mtx 12 00; } > mmio/index_three
+{ mdata 01 02 03 04 05 06 07 08; mkey $(chars HBKP); mtx 11 80; } > mmio/write_oversize
+{ mkey $(chars TC0P); mstore 7d 02; mstore 7e 01; hex 01; hex 10; hex 03; hex 02; } > mmio/read_attr
+{ hex 04; hex 01; hex 40; hex 03; hex 04; hex 01; hex 08; hex 03; } > mmio/log_messages
+{ hex 04; hex 02; hex 00; mmio_read TC0P 02; hex 03; } > mmio/als_during_read
+{ mdirect 78 $(chars F0Ac); mdirect 7d 02; mdirect 7f 10; hex 06; hex 00; hex 40; hex 06; hex 05; hex 40; hex 06; hex 00; hex 00; } > mmio/direct_read
+{ for i in 00 01 02 03; do mkey 00 00 00 $i; mtx 12 00; done; mmio_read '#KEY' 04; mkey $(chars 'REV '); mtx 13 00; mmio_read 'REV ' 06; } > mmio/startup
+{ for n in 1 2 3; do mmio_read TC0P 02; mmio_read F0Ac 02; hex 04; hex 02; hex 00; done; } > mmio/monitoring
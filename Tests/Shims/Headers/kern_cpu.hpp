@@ -0,0 +1,22 @@
+//
+//  kern_cpu.hpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Userspace stand-in for the parts of Lilu kern_cpu.hpp used by the timer service.
+//
+
+#ifndef kern_cpu_hpp
+#define kern_cpu_hpp
+
+#include <stddef.h>
+
+namespace CPUInfo {
+	/**
+	 *  Maximum supported CPU count
+	 */
+	static constexpr size_t MaxCpus {256};
+}
+
+#endif /* kern_cpu_hpp */
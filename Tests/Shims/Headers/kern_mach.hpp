@@ -0,0 +1,33 @@
+//
+//  kern_mach.hpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Userspace stand-in for Lilu kern_mach.hpp, the MMIO window is ordinary writable memory here.
+//
+
+#ifndef kern_mach_hpp
+#define kern_mach_hpp
+
+#include <Headers/kern_util.hpp>
+#include <IOKit/IOLocks.h>
+
+typedef int kern_return_t;
+#define KERN_SUCCESS 0
+
+class MachInfo {
+public:
+	/**
+	 *  Number of write windows opened, lets the benchmarks count them
+	 */
+	inline static size_t kernelWriteWindows {0};
+
+	static kern_return_t setKernelWriting(bool enable, IOSimpleLock *) {
+		if (enable)
+			kernelWriteWindows++;
+		return KERN_SUCCESS;
+	}
+};
+
+#endif /* kern_mach_hpp */
@@ -0,0 +1,20 @@
+//
+//  kern_patcher.hpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Userspace stand-in for Lilu kern_patcher.hpp.
+//
+
+#ifndef kern_patcher_hpp
+#define kern_patcher_hpp
+
+#include <IOKit/IOLocks.h>
+
+class KernelPatcher {
+public:
+	inline static IOSimpleLock *kernelWriteLock {nullptr};
+};
+
+#endif /* kern_patcher_hpp */
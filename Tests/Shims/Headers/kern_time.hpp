@@ -0,0 +1,41 @@
+//
+//  kern_time.hpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Userspace stand-in for Lilu kern_time.hpp.
+//
+
+#ifndef kern_time_hpp
+#define kern_time_hpp
+
+#include <atomic>
+#include <stdint.h>
+#include <time.h>
+
+#ifndef NSEC_PER_USEC
+#define NSEC_PER_USEC 1000ULL
+#endif
+#ifndef NSEC_PER_MSEC
+#define NSEC_PER_MSEC 1000000ULL
+#endif
+#ifndef NSEC_PER_SEC
+#define NSEC_PER_SEC  1000000000ULL
+#endif
+
+/**
+ *  Simulated time in nanoseconds, the monotonic clock is used while it is 0
+ */
+inline std::atomic<uint64_t> testClockNs {0};
+
+inline uint64_t getCurrentTimeNs() {
+	auto simulated = testClockNs.load(std::memory_order_relaxed);
+	if (simulated != 0)
+		return simulated;
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+#endif /* kern_time_hpp */
@@ -0,0 +1,85 @@
+//
+//  kern_util.hpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Userspace stand-in for the parts of Lilu kern_util.hpp used by the protocol code.
+//
+
+#ifndef kern_util_hpp
+#define kern_util_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <libkern/OSByteOrder.h>
+#include <mach/vm_types.h>
+
+#define EXPORT __attribute__((visibility("default")))
+#define PACKED __attribute__((packed))
+#define UNUSED(x) ((void)(x))
+
+/**
+ *  Tests are quiet by default, set VSMC_TEST_LOG=1 in the environment to see the logs
+ */
+inline bool testLogEnabled() {
+	static int enabled = -1;
+	if (enabled < 0) {
+		auto env = getenv("VSMC_TEST_LOG");
+		enabled = env && env[0] == '1';
+	}
+	return enabled;
+}
+
+#define SYSLOG(module, str, ...) do { if (testLogEnabled()) fprintf(stderr, "%s: " str "\n", module, ## __VA_ARGS__); } while (0)
+#define SYSLOG_COND(cond, module, str, ...) do { if (cond) SYSLOG(module, str, ## __VA_ARGS__); } while (0)
+#define DBGLOG(module, str, ...) SYSLOG(module, str, ## __VA_ARGS__)
+#define DBGLOG_COND(cond, module, str, ...) SYSLOG_COND(cond, module, str, ## __VA_ARGS__)
+#define DBGTRACE(module, str, ...) SYSLOG(module, str, ## __VA_ARGS__)
+#define PANIC(module, str, ...) do { fprintf(stderr, "%s: panic: " str "\n", module, ## __VA_ARGS__); abort(); } while (0)
+
+template <typename T, size_t N>
+constexpr size_t arrsize(const T (&)[N]) {
+	return N;
+}
+
+/**
+ *  Bytes copied and erased by the kext code, let the benchmarks count the work done
+ */
+inline size_t testCopiedBytes {0};
+inline size_t testClearedBytes {0};
+
+inline void *lilu_os_memcpy(void *dst, const void *src, size_t len) {
+	testCopiedBytes += len;
+	return memcpy(dst, src, len);
+}
+
+inline void testBzero(void *dst, size_t len) {
+	testClearedBytes += len;
+	memset(dst, 0, len);
+}
+
+#define bzero testBzero
+
+inline void *lilu_os_memset(void *dst, int c, size_t len) {
+	return memset(dst, c, len);
+}
+
+namespace Buffer {
+	template <typename T>
+	T *create(size_t size) {
+		return static_cast<T *>(calloc(size, sizeof(T)));
+	}
+
+	template <typename T>
+	void deleter(T *buf) {
+		free(buf);
+	}
+}
+
+#endif /* kern_util_hpp */
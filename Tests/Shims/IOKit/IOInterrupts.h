@@ -0,0 +1,16 @@
+//
+//  IOInterrupts.h
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef IOInterrupts_h
+#define IOInterrupts_h
+
+class OSObject;
+class IOService;
+
+typedef void (*IOInterruptAction)(OSObject *target, void *refCon, IOService *nub, int source);
+
+#endif /* IOInterrupts_h */
@@ -0,0 +1,72 @@
+//
+//  IOLocks.h
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef IOLocks_h
+#define IOLocks_h
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+struct IOSimpleLock {
+	std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
+inline IOSimpleLock *IOSimpleLockAlloc() {
+	return new IOSimpleLock;
+}
+
+inline void IOSimpleLockFree(IOSimpleLock *lock) {
+	delete lock;
+}
+
+inline void IOSimpleLockLock(IOSimpleLock *lock) {
+	while (lock->flag.test_and_set(std::memory_order_acquire))
+		;
+}
+
+inline void IOSimpleLockUnlock(IOSimpleLock *lock) {
+	lock->flag.clear(std::memory_order_release);
+}
+
+// Sleeping locks wake every sleeper, events are not told apart.
+#define THREAD_UNINT    0
+#define THREAD_AWAKENED 0
+
+struct IOLock {
+	std::mutex mutex;
+	std::condition_variable cond;
+};
+
+inline IOLock *IOLockAlloc() {
+	return new IOLock;
+}
+
+inline void IOLockFree(IOLock *lock) {
+	delete lock;
+}
+
+inline void IOLockLock(IOLock *lock) {
+	lock->mutex.lock();
+}
+
+inline void IOLockUnlock(IOLock *lock) {
+	lock->mutex.unlock();
+}
+
+inline int IOLockSleep(IOLock *lock, void *event, int interType) {
+	std::unique_lock<std::mutex> guard(lock->mutex, std::adopt_lock);
+	lock->cond.wait(guard);
+	guard.release();
+	return THREAD_AWAKENED;
+}
+
+inline void IOLockWakeup(IOLock *lock, void *event, bool oneThread) {
+	lock->cond.notify_all();
+}
+
+#endif /* IOLocks_h */
@@ -0,0 +1,20 @@
+//
+//  IOReturn.h
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef IOReturn_h
+#define IOReturn_h
+
+#include <stdint.h>
+
+typedef int32_t IOReturn;
+
+#define kIOReturnSuccess     0
+#define kIOReturnError       static_cast<IOReturn>(0xe00002bc)
+#define kIOReturnNoResources static_cast<IOReturn>(0xe00002be)
+#define kIOReturnNotFound    static_cast<IOReturn>(0xe00002f0)
+
+#endif /* IOReturn_h */
@@ -0,0 +1,81 @@
+//
+//  IOTimerEventSource.h
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Timer event source driven by the test: it records the armed deadline (in the getCurrentTimeNs
+//  time base), and expire runs the action within the work loop gate once the deadline has passed.
+//
+
+#ifndef IOTimerEventSource_h
+#define IOTimerEventSource_h
+
+#include <Headers/kern_time.hpp>
+#include <IOKit/IOWorkLoop.h>
+
+class IOTimerEventSource;
+
+/**
+ *  Last created timer event source
+ */
+inline IOTimerEventSource *testTimerSource {nullptr};
+
+class IOTimerEventSource : public IOEventSource {
+public:
+	typedef void (*Action)(OSObject *owner, IOTimerEventSource *sender);
+
+	static IOTimerEventSource *timerEventSource(OSObject *owner, Action action) {
+		auto source = new IOTimerEventSource;
+		source->owner = owner;
+		source->action = action;
+		testTimerSource = source;
+		return source;
+	}
+
+	IOReturn setTimeoutUS(uint32_t us) {
+		armed = true;
+		deadline = getCurrentTimeNs() + us * NSEC_PER_USEC;
+		return kIOReturnSuccess;
+	}
+
+	IOReturn setTimeoutMS(uint32_t ms) {
+		return setTimeoutUS(ms * 1000);
+	}
+
+	void cancelTimeout() {
+		armed = false;
+	}
+
+	/**
+	 *  Whether a timeout is pending
+	 */
+	bool armed {false};
+
+	/**
+	 *  Pending timeout deadline in nanoseconds
+	 */
+	uint64_t deadline {0};
+
+	/**
+	 *  Run the action if the timeout has passed
+	 *
+	 *  @return true if the action ran
+	 */
+	bool expire() {
+		workLoop->closeGate();
+		bool due = armed && deadline <= getCurrentTimeNs();
+		if (due) {
+			armed = false;
+			action(owner, this);
+		}
+		workLoop->openGate();
+		return due;
+	}
+
+private:
+	OSObject *owner {nullptr};
+	Action action {nullptr};
+};
+
+#endif /* IOTimerEventSource_h */
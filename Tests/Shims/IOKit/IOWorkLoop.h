@@ -0,0 +1,63 @@
+//
+//  IOWorkLoop.h
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Work loop without a thread, actions run in the calling thread with the gate held.
+//
+
+#ifndef IOWorkLoop_h
+#define IOWorkLoop_h
+
+#include <mutex>
+
+#include <IOKit/IOReturn.h>
+#include <libkern/c++/OSObject.h>
+
+class IOWorkLoop;
+
+class IOEventSource : public OSObject {
+public:
+	/**
+	 *  Work loop the source is added to
+	 */
+	IOWorkLoop *workLoop {nullptr};
+};
+
+class IOWorkLoop : public OSObject {
+public:
+	typedef IOReturn (*Action)(OSObject *target, void *arg0, void *arg1, void *arg2, void *arg3);
+
+	static IOWorkLoop *workLoop() {
+		return new IOWorkLoop;
+	}
+
+	IOReturn addEventSource(IOEventSource *source) {
+		source->workLoop = this;
+		return kIOReturnSuccess;
+	}
+
+	IOReturn removeEventSource(IOEventSource *source) {
+		source->workLoop = nullptr;
+		return kIOReturnSuccess;
+	}
+
+	IOReturn runAction(Action action, OSObject *target, void *arg0 = nullptr, void *arg1 = nullptr, void *arg2 = nullptr, void *arg3 = nullptr) {
+		std::lock_guard<std::recursive_mutex> lock(gate);
+		return action(target, arg0, arg1, arg2, arg3);
+	}
+
+	void closeGate() {
+		gate.lock();
+	}
+
+	void openGate() {
+		gate.unlock();
+	}
+
+private:
+	std::recursive_mutex gate;
+};
+
+#endif /* IOWorkLoop_h */
@@ -0,0 +1,49 @@
+//
+//  pmCPU.h
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Thread binding records the CPU in testBoundCpu of the calling thread.
+//
+
+#ifndef pmCPU_h
+#define pmCPU_h
+
+#include <stdint.h>
+
+#define PM_DISPATCH_VERSION 102
+
+#ifndef FALSE
+#define FALSE false
+#endif
+
+typedef struct processor *processor_t;
+
+typedef struct {
+	processor_t (*LCPUtoProcessor)(int lcpu);
+	void (*ThreadBind)(processor_t proc);
+} pmCallBacks_t;
+
+/**
+ *  CPU the current thread is bound to or -1
+ */
+inline thread_local int testBoundCpu {-1};
+
+inline void pmKextRegister(uint32_t version, void *dispatch, pmCallBacks_t *callbacks) {
+	callbacks->LCPUtoProcessor = [](int lcpu) {
+		return reinterpret_cast<processor_t>(static_cast<uintptr_t>(lcpu) + 1);
+	};
+	callbacks->ThreadBind = [](processor_t proc) {
+		testBoundCpu = static_cast<int>(reinterpret_cast<uintptr_t>(proc) - 1);
+	};
+}
+
+/**
+ *  Declared by the kernel headers IOKit pulls in
+ */
+inline bool ml_set_interrupts_enabled(bool enable) {
+	return true;
+}
+
+#endif /* pmCPU_h */
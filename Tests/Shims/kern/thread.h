@@ -0,0 +1,47 @@
+//
+//  thread.h
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Kernel threads run on detached threads, testRunningThreads counts the ones not returned yet.
+//
+
+#ifndef thread_h
+#define thread_h
+
+#include <atomic>
+#include <thread>
+
+typedef int kern_return_t;
+#ifndef KERN_SUCCESS
+#define KERN_SUCCESS 0
+#endif
+
+typedef struct thread *thread_t;
+typedef int wait_result_t;
+typedef void (*thread_continue_t)(void *parameter, wait_result_t wresult);
+
+/**
+ *  Amount of started kernel threads still running
+ */
+inline std::atomic<size_t> testRunningThreads {0};
+
+inline kern_return_t kernel_thread_start(thread_continue_t continuation, void *parameter, thread_t *new_thread) {
+	testRunningThreads++;
+	std::thread([continuation, parameter]() {
+		continuation(parameter, 0);
+		testRunningThreads--;
+	}).detach();
+	*new_thread = nullptr;
+	return KERN_SUCCESS;
+}
+
+inline void thread_deallocate(thread_t thread) {}
+
+inline thread_t current_thread() {
+	static thread_local char self;
+	return reinterpret_cast<thread_t>(&self);
+}
+
+#endif /* thread_h */
@@ -0,0 +1,21 @@
+//
+//  OSByteOrder.h
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef OSByteOrder_h
+#define OSByteOrder_h
+
+#include <stdint.h>
+
+#define OSSwapInt16(x) __builtin_bswap16(x)
+#define OSSwapInt32(x) __builtin_bswap32(x)
+#define OSSwapInt64(x) __builtin_bswap64(x)
+#define OSSwapBigToHostInt16(x) OSSwapInt16(x)
+#define OSSwapBigToHostInt32(x) OSSwapInt32(x)
+#define OSSwapHostToBigInt16(x) OSSwapInt16(x)
+#define OSSwapHostToBigInt32(x) OSSwapInt32(x)
+
+#endif /* OSByteOrder_h */
@@ -0,0 +1,41 @@
+//
+//  OSData.h
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef OSData_h
+#define OSData_h
+
+#include <stdlib.h>
+#include <string.h>
+
+class OSData {
+	void *bytes {nullptr};
+	unsigned int length {0};
+
+public:
+	static OSData *withBytes(const void *src, unsigned int size) {
+		auto data = new OSData;
+		data->bytes = malloc(size ? size : 1);
+		memcpy(data->bytes, src, size);
+		data->length = size;
+		return data;
+	}
+
+	const void *getBytesNoCopy() const {
+		return bytes;
+	}
+
+	unsigned int getLength() const {
+		return length;
+	}
+
+	void release() {
+		free(bytes);
+		delete this;
+	}
+};
+
+#endif /* OSData_h */
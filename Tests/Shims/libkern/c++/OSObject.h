@@ -0,0 +1,22 @@
+//
+//  OSObject.h
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef OSObject_h
+#define OSObject_h
+
+class OSObject {
+public:
+	virtual ~OSObject() = default;
+
+	virtual void release() {
+		delete this;
+	}
+};
+
+#define OSSafeReleaseNULL(x) do { if (x) { (x)->release(); (x) = nullptr; } } while (0)
+
+#endif /* OSObject_h */
@@ -0,0 +1,25 @@
+//
+//  vm_types.h
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef vm_types_h
+#define vm_types_h
+
+#include <stdint.h>
+
+typedef uint64_t mach_vm_address_t;
+typedef uint64_t mach_vm_size_t;
+typedef int vm_prot_t;
+
+#define VM_PROT_NONE  0x00
+#define VM_PROT_READ  0x01
+#define VM_PROT_WRITE 0x02
+
+#ifndef PAGE_SIZE
+#define PAGE_SIZE 4096
+#endif
+
+#endif /* vm_types_h */
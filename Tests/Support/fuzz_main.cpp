@@ -0,0 +1,183 @@
+//
+//  fuzz_main.cpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Standalone driver for the LLVMFuzzerTestOneInput targets when libFuzzer is not available
+//  (make FUZZ=1 links libFuzzer instead). Every corpus input is run first, then random
+//  mutations of the corpus inputs. Execution rate is reported and optionally checked.
+//
+//  Usage: fuzz_<target> [-runs=N] [-seed=N] [-min_rate=EXECS_PER_SEC] [corpus file or dir...]
+//
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "test_util.hpp"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+/**
+ *  Largest generated input
+ */
+static constexpr size_t MaxInputSize {4096};
+
+/**
+ *  Maximum amount of corpus inputs
+ */
+static constexpr size_t MaxInputs {1024};
+
+struct Input {
+	uint8_t *data;
+	size_t size;
+};
+
+static Input inputs[MaxInputs];
+static size_t inputNum;
+
+static void loadFile(const char *path) {
+	auto f = fopen(path, "rb");
+	if (!f) {
+		fprintf(stderr, "cannot open %s\n", path);
+		testFailures++;
+		return;
+	}
+
+	auto data = static_cast<uint8_t *>(malloc(MaxInputSize));
+	auto size = fread(data, 1, MaxInputSize, f);
+	fclose(f);
+
+	if (inputNum < MaxInputs)
+		inputs[inputNum++] = {data, size};
+	else
+		free(data);
+}
+
+static void load(const char *path) {
+	struct stat st;
+	if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+		loadFile(path);
+		return;
+	}
+
+	auto dir = opendir(path);
+	if (!dir)
+		return;
+	while (auto ent = readdir(dir)) {
+		if (ent->d_name[0] == '.')
+			continue;
+		char name[1024];
+		snprintf(name, sizeof(name), "%s/%s", path, ent->d_name);
+		if (stat(name, &st) == 0 && S_ISREG(st.st_mode))
+			loadFile(name);
+	}
+	closedir(dir);
+}
+
+/**
+ *  Produce a mutation of a random corpus input
+ *
+ *  @param rnd   random generator
+ *  @param out   output buffer of MaxInputSize bytes
+ *
+ *  @return output size
+ */
+static size_t mutate(TestRandom &rnd, uint8_t *out) {
+	size_t size = 0;
+	if (inputNum > 0) {
+		auto &in = inputs[rnd.below(static_cast<uint32_t>(inputNum))];
+		memcpy(out, in.data, in.size);
+		size = in.size;
+	}
+
+	auto steps = 1 + rnd.below(8);
+	for (uint32_t i = 0; i < steps; i++) {
+		switch (rnd.below(5)) {
+			case 0: // Flip a byte
+				if (size > 0)
+					out[rnd.below(static_cast<uint32_t>(size))] ^= static_cast<uint8_t>(1 + rnd.below(255));
+				break;
+			case 1: // Insert a byte
+				if (size < MaxInputSize) {
+					auto pos = rnd.below(static_cast<uint32_t>(size + 1));
+					memmove(out + pos + 1, out + pos, size - pos);
+					out[pos] = static_cast<uint8_t>(rnd.next());
+					size++;
+				}
+				break;
+			case 2: // Erase a range
+				if (size > 0) {
+					auto pos = rnd.below(static_cast<uint32_t>(size));
+					auto len = 1 + rnd.below(static_cast<uint32_t>(size - pos < 16 ? size - pos : 16));
+					memmove(out + pos, out + pos + len, size - pos - len);
+					size -= len;
+				}
+				break;
+			case 3: // Splice another input
+				if (inputNum > 0) {
+					auto &in = inputs[rnd.below(static_cast<uint32_t>(inputNum))];
+					auto pos = rnd.below(static_cast<uint32_t>(size + 1));
+					auto len = in.size < MaxInputSize - pos ? in.size : MaxInputSize - pos;
+					memcpy(out + pos, in.data, len);
+					if (pos + len > size)
+						size = pos + len;
+				}
+				break;
+			case 4: // Set an interesting value
+				if (size > 0) {
+					static const uint8_t values[] {0, 1, 0x10, 0x11, 0x12, 0x13, 0x40, 0x7F, 0x78, 0x80, 0xFF};
+					out[rnd.below(static_cast<uint32_t>(size))] = values[rnd.below(sizeof(values))];
+				}
+				break;
+		}
+	}
+
+	return size;
+}
+
+int main(int argc, char *argv[]) {
+	size_t runs = 100000;
+	uint64_t seed = 1;
+	double minRate = 0;
+	const char *name = strrchr(argv[0], '/') ? strrchr(argv[0], '/') + 1 : argv[0];
+
+	for (int i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "-runs=", 6))
+			runs = strtoul(argv[i] + 6, nullptr, 0);
+		else if (!strncmp(argv[i], "-seed=", 6))
+			seed = strtoull(argv[i] + 6, nullptr, 0);
+		else if (!strncmp(argv[i], "-min_rate=", 10))
+			minRate = strtod(argv[i] + 10, nullptr);
+		else
+			load(argv[i]);
+	}
+
+	for (size_t i = 0; i < inputNum; i++)
+		LLVMFuzzerTestOneInput(inputs[i].data, inputs[i].size);
+
+	TestRandom rnd(seed);
+	static uint8_t buf[MaxInputSize];
+	size_t bytes = 0;
+	auto start = getCurrentTimeNs();
+	for (size_t i = 0; i < runs; i++) {
+		auto size = mutate(rnd, buf);
+		bytes += size;
+		LLVMFuzzerTestOneInput(buf, size);
+	}
+	auto elapsed = getCurrentTimeNs() - start;
+
+	double rate = elapsed > 0 ? runs * 1e9 / elapsed : 0;
+	printf("%s: %zu corpus inputs, %zu runs, %.0f execs/s, %.0f bytes/exec\n", name, inputNum, runs, rate, runs ? static_cast<double>(bytes) / runs : 0);
+	if (minRate > 0 && runs > 0 && rate < minRate) {
+		fprintf(stderr, "%s: %.0f execs/s is below the expected %.0f\n", name, rate, minRate);
+		testFailures++;
+	}
+
+	for (size_t i = 0; i < inputNum; i++)
+		free(inputs[i].data);
+
+	return testResult(name);
+}
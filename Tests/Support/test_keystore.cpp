@@ -0,0 +1,118 @@
+//
+//  test_keystore.cpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#include "test_keystore.hpp"
+
+static constexpr SMC_KEY KeyKEY = SMC_MAKE_IDENTIFIER('#', 'K', 'E', 'Y');
+
+TestKeystore::TestKeystore() {
+	static const uint8_t rev[] {0x02, 0x33, 0x0f, 0x00, 0x00, 0x10};
+	static const uint8_t temp[] {0x2e, 0x80};
+	static const uint8_t fan[] {0x1f, 0x40};
+	static const uint8_t one[] {1};
+
+	add(KeyKEY, SmcKeyTypeUint32, 4, SMC_KEY_ATTRIBUTE_READ);
+	add(SMC_MAKE_IDENTIFIER('R','E','V',' '), SmcKeyTypeCh8s, sizeof(rev), SMC_KEY_ATTRIBUTE_READ, rev);
+	add(SMC_MAKE_IDENTIFIER('R','P','l','t'), SmcKeyTypeCh8s, 8, SMC_KEY_ATTRIBUTE_READ, "j137\0\0\0");
+	add(SMC_MAKE_IDENTIFIER('O','S','K','0'), SmcKeyTypeCh8s, 32, SMC_KEY_ATTRIBUTE_READ, "ourhardworkbythesewordsguardedpl");
+	add(SMC_MAKE_IDENTIFIER('T','C','0','P'), SmcKeyTypeSp78, sizeof(temp), SMC_KEY_ATTRIBUTE_READ, temp);
+	add(SMC_MAKE_IDENTIFIER('T','G','0','P'), SmcKeyTypeSp78, sizeof(temp), SMC_KEY_ATTRIBUTE_READ, temp);
+	add(SMC_MAKE_IDENTIFIER('F','N','u','m'), SmcKeyTypeUint8, 1, SMC_KEY_ATTRIBUTE_READ, one);
+	add(SMC_MAKE_IDENTIFIER('F','0','A','c'), SmcKeyTypeFpe2, sizeof(fan), SMC_KEY_ATTRIBUTE_READ, fan);
+	add(SMC_MAKE_IDENTIFIER('F','0','T','g'), SmcKeyTypeFpe2, sizeof(fan), SMC_KEY_ATTRIBUTE_READ | SMC_KEY_ATTRIBUTE_WRITE, fan);
+	add(SMC_MAKE_IDENTIFIER('N','A','T','J'), SmcKeyTypeUint8, 1, SMC_KEY_ATTRIBUTE_READ | SMC_KEY_ATTRIBUTE_WRITE);
+	add(SMC_MAKE_IDENTIFIER('C','L','K','T'), SmcKeyTypeUint32, 4, SMC_KEY_ATTRIBUTE_READ | SMC_KEY_ATTRIBUTE_WRITE);
+	add(SMC_MAKE_IDENTIFIER('H','B','K','P'), SmcKeyTypeCh8s, SMC_HBKP_SIZE, SMC_KEY_ATTRIBUTE_READ | SMC_KEY_ATTRIBUTE_WRITE);
+	add(SMC_MAKE_IDENTIFIER('K','P','P','W'), SmcKeyTypeUint8, 1, SMC_KEY_ATTRIBUTE_WRITE);
+	add(SMC_MAKE_IDENTIFIER('L','O','G','B'), SmcKeyTypeCh8s, SMC_MAX_DATA_SIZE, SMC_KEY_ATTRIBUTE_READ);
+
+	// Key count is also refreshed on read, set it here so that keystores with the same keys compare equal.
+	uint32_t count = OSSwapInt32(static_cast<uint32_t>(keyNum));
+	lilu_os_memcpy(lookup(KeyKEY)->data, &count, sizeof(count));
+}
+
+bool TestKeystore::add(SMC_KEY name, SMC_KEY_TYPE type, SMC_DATA_SIZE size, SMC_KEY_ATTRIBUTES attr, const void *data) {
+	if (keyNum == MaxKeys || size > SMC_MAX_DATA_SIZE || lookup(name))
+		return false;
+
+	// Keys are ordered as SMC does, by their big endian names.
+	size_t pos = keyNum;
+	while (pos > 0 && OSSwapInt32(keys[pos-1].name) > OSSwapInt32(name)) {
+		keys[pos] = keys[pos-1];
+		pos--;
+	}
+
+	auto &key = keys[pos];
+	key = {};
+	key.name = name;
+	key.type = type;
+	key.size = size;
+	key.attr = attr;
+	if (data)
+		lilu_os_memcpy(key.data, data, size);
+	keyNum++;
+	return true;
+}
+
+TestKeystore::Key *TestKeystore::lookup(SMC_KEY name) {
+	for (size_t i = 0; i < keyNum; i++)
+		if (keys[i].name == name)
+			return &keys[i];
+	return nullptr;
+}
+
+const TestKeystore::Key *TestKeystore::find(SMC_KEY name) const {
+	return const_cast<TestKeystore *>(this)->lookup(name);
+}
+
+SMC_RESULT TestKeystore::readValueByName(SMC_KEY name, SMC_DATA *data, SMC_DATA_SIZE &size) {
+	reads++;
+	auto key = lookup(name);
+	if (!key)
+		return SmcNotFound;
+	if (!(key->attr & SMC_KEY_ATTRIBUTE_READ))
+		return SmcNotReadable;
+
+	if (name == KeyKEY) {
+		uint32_t count = OSSwapInt32(static_cast<uint32_t>(keyNum));
+		lilu_os_memcpy(key->data, &count, sizeof(count));
+	}
+
+	size = key->size;
+	lilu_os_memcpy(data, key->data, size);
+	return SmcSuccess;
+}
+
+SMC_RESULT TestKeystore::readNameByIndex(SMC_KEY_INDEX idx, SMC_KEY &key) {
+	reads++;
+	if (idx >= keyNum)
+		return SmcKeyIndexRangeError;
+	key = keys[idx].name;
+	return SmcSuccess;
+}
+
+SMC_RESULT TestKeystore::writeValueByName(SMC_KEY name, const SMC_DATA *data) {
+	writes++;
+	auto key = lookup(name);
+	if (!key)
+		return SmcNotFound;
+	if (!(key->attr & SMC_KEY_ATTRIBUTE_WRITE))
+		return SmcNotWritable;
+	lilu_os_memcpy(key->data, data, key->size);
+	return SmcSuccess;
+}
+
+SMC_RESULT TestKeystore::getInfoByName(SMC_KEY name, SMC_DATA_SIZE &size, SMC_KEY_TYPE &type, SMC_KEY_ATTRIBUTES &attr) {
+	reads++;
+	auto key = lookup(name);
+	if (!key)
+		return SmcNotFound;
+	size = key->size;
+	type = key->type;
+	attr = key->attr;
+	return SmcSuccess;
+}
@@ -0,0 +1,82 @@
+//
+//  test_keystore.hpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef test_keystore_hpp
+#define test_keystore_hpp
+
+#include <Headers/kern_util.hpp>
+
+#include "kern_protocol.hpp"
+
+/**
+ *  Userspace keystore with a fixed key set resembling a real Mac.
+ *  Access rules follow VirtualSMCKeystore: attributes are checked and values have fixed sizes.
+ */
+class TestKeystore : public SMCProtocolKeystore {
+public:
+	struct Key {
+		SMC_KEY name;
+		SMC_KEY_TYPE type;
+		SMC_DATA_SIZE size;
+		SMC_KEY_ATTRIBUTES attr;
+		SMC_DATA data[SMC_MAX_DATA_SIZE];
+	};
+
+	static constexpr size_t MaxKeys {64};
+
+	/**
+	 *  Create a keystore with the default key set
+	 */
+	TestKeystore();
+
+	/**
+	 *  Add a key keeping the keys sorted by name
+	 *
+	 *  @return true on success
+	 */
+	bool add(SMC_KEY name, SMC_KEY_TYPE type, SMC_DATA_SIZE size, SMC_KEY_ATTRIBUTES attr, const void *data = nullptr);
+
+	/**
+	 *  Find a key by name
+	 *
+	 *  @return key or nullptr
+	 */
+	const Key *find(SMC_KEY name) const;
+
+	/**
+	 *  Obtain key by its index
+	 */
+	const Key &at(size_t index) const {
+		return keys[index];
+	}
+
+	/**
+	 *  Obtain key count
+	 */
+	size_t count() const {
+		return keyNum;
+	}
+
+	SMC_RESULT readValueByName(SMC_KEY name, SMC_DATA *data, SMC_DATA_SIZE &size) override;
+	SMC_RESULT readNameByIndex(SMC_KEY_INDEX idx, SMC_KEY &key) override;
+	SMC_RESULT writeValueByName(SMC_KEY name, const SMC_DATA *data) override;
+	SMC_RESULT getInfoByName(SMC_KEY name, SMC_DATA_SIZE &size, SMC_KEY_TYPE &type, SMC_KEY_ATTRIBUTES &attr) override;
+
+	/**
+	 *  Operation counters
+	 */
+	size_t reads {0};
+	size_t writes {0};
+
+private:
+	Key keys[MaxKeys] {};
+	size_t keyNum {0};
+
+	Key *lookup(SMC_KEY name);
+};
+
+#endif /* test_keystore_hpp */
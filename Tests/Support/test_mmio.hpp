@@ -0,0 +1,227 @@
+//
+//  test_mmio.hpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef test_mmio_hpp
+#define test_mmio_hpp
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "kern_mmio.hpp"
+
+/**
+ *  Interrupt queue standing in for VirtualSMC, delivers queued codes to the protocol
+ *  in posting order when the host reads the event status, same codes coalesce while pending.
+ */
+class TestEvents : public SMCProtocolEvents {
+public:
+	/**
+	 *  Protocol receiving the consumed interrupts
+	 */
+	SMCProtocolMMIO *mmio {nullptr};
+
+	/**
+	 *  Number of posted interrupts, including the coalesced ones
+	 */
+	size_t posted {0};
+
+	void postInterrupt(SMC_EVENT_CODE code) override {
+		post(code, nullptr, 0);
+	}
+
+	/**
+	 *  Post an interrupt with data
+	 *
+	 *  @param code  event code
+	 *  @param data  event data (optional)
+	 *  @param size  event data size
+	 */
+	void post(SMC_EVENT_CODE code, const void *data, size_t size) {
+		posted++;
+		if (size > sizeof(stored[code].data))
+			size = sizeof(stored[code].data);
+		stored[code].size = size;
+		if (size > 0)
+			memcpy(stored[code].data, data, size);
+		if (!stored[code].pending && num < MaxQueued) {
+			stored[code].pending = true;
+			queue[(head + num++) % MaxQueued] = code;
+		}
+	}
+
+	SMC_EVENT_CODE getInterrupt() override {
+		if (num == 0)
+			return 0;
+		auto code = queue[head];
+		head = (head + 1) % MaxQueued;
+		num--;
+		stored[code].pending = false;
+		if (mmio)
+			mmio->setInterrupt(code, stored[code].data, stored[code].size);
+		return code;
+	}
+
+	/**
+	 *  Number of interrupts awaiting delivery
+	 */
+	size_t queued() const {
+		return num;
+	}
+
+private:
+	static constexpr size_t MaxQueued {256};
+
+	struct Stored {
+		uint8_t data[SMC_MAX_LOG_SIZE];
+		size_t size;
+		bool pending;
+	};
+
+	Stored stored[MaxQueued] {};
+	SMC_EVENT_CODE queue[MaxQueued] {};
+	size_t head {0};
+	size_t num {0};
+};
+
+/**
+ *  Drives SMCProtocolMMIO the way AppleSMC does, over an ordinary memory window.
+ *  In trap mode every host store is followed by handleWrite and every status load
+ *  is preceded by handleRead, as the page fault handler does. In direct mode the
+ *  registers are accessed through directRead and directWrite.
+ */
+class MMIODriver {
+public:
+	explicit MMIODriver(SMCProtocolMMIO &mmio, bool direct = false) : mmio(mmio), direct(direct) {
+		window = static_cast<uint8_t *>(aligned_alloc(SMCProtocolMMIO::WindowAlign, SMCProtocolMMIO::WindowAllocSize));
+		memset(window, 0, SMCProtocolMMIO::WindowAllocSize);
+		base = reinterpret_cast<mach_vm_address_t>(window);
+	}
+
+	~MMIODriver() {
+		free(window);
+	}
+
+	MMIODriver(const MMIODriver &) = delete;
+	MMIODriver &operator=(const MMIODriver &) = delete;
+
+	/**
+	 *  Device memory as seen by the host
+	 */
+	uint8_t *window {nullptr};
+
+	/**
+	 *  Device memory base address
+	 */
+	mach_vm_address_t base {};
+
+	SMC_RESULT readKey(SMC_KEY key, SMC_DATA_SIZE size, SMC_DATA *out) {
+		auto r = transact(SmcCmdReadValue, &key, sizeof(key), size);
+		auto got = load<SMC_DATA_SIZE>(SMC_MMIO_WRITE_DATA_SIZE);
+		for (SMC_DATA_SIZE i = 0; i < size; i++)
+			out[i] = i < got ? load<SMC_DATA>(SMC_MMIO_DATA_VARIABLE + i) : 0;
+		return r;
+	}
+
+	SMC_RESULT writeKey(SMC_KEY key, const SMC_DATA *data, SMC_DATA_SIZE size) {
+		for (SMC_DATA_SIZE i = 0; i < size; i++)
+			store<SMC_DATA>(SMC_MMIO_DATA_VARIABLE + i, data[i]);
+		return transact(SmcCmdWriteValue, &key, sizeof(key), size);
+	}
+
+	SMC_RESULT getKeyInfo(SMC_KEY key, SMC_DATA_SIZE &size, SMC_KEY_TYPE &type, SMC_KEY_ATTRIBUTES &attr) {
+		auto r = transact(SmcCmdGetKeyInfo, &key, sizeof(key), 0);
+		type = load<SMC_KEY_TYPE>(SMC_MMIO_READ_KEY_TYPE);
+		size = load<SMC_DATA_SIZE>(SMC_MMIO_READ_DATA_SIZE);
+		attr = load<SMC_KEY_ATTRIBUTES>(SMC_MMIO_READ_KEY_ATTRIBUTES);
+		return r;
+	}
+
+	SMC_RESULT getKeyFromIndex(SMC_KEY_INDEX index, SMC_KEY &key) {
+		auto be = OSSwapInt32(index);
+		auto r = transact(SmcCmdGetKeyFromIndex, &be, sizeof(be), 0);
+		key = load<SMC_KEY>(SMC_MMIO_READ_KEY);
+		return r;
+	}
+
+	/**
+	 *  Submit a command and wait for its completion
+	 *
+	 *  @param cmd   command
+	 *  @param key   key or index bytes
+	 *  @param len   key or index length
+	 *  @param size  value size
+	 *
+	 *  @return command result
+	 */
+	SMC_RESULT transact(SMC_COMMAND cmd, const void *key, size_t len, SMC_DATA_SIZE size) {
+		for (size_t i = 0; i < len; i++)
+			store<uint8_t>(SMC_MMIO_WRITE_KEY + i, static_cast<const uint8_t *>(key)[i]);
+		store<SMC_DATA_SIZE>(SMC_MMIO_WRITE_DATA_SIZE, size);
+		store<SMC_KEY_ATTRIBUTES>(SMC_MMIO_WRITE_KEY_ATTRIBUTES, 0);
+		store<SMC_COMMAND>(SMC_MMIO_WRITE_COMMAND, cmd);
+		// AppleSMC waits for the key done interrupt, then acknowledges it.
+		status(SMC_MMIO_READ_EVENT_STATUS);
+		status(SMC_MMIO_READ_KEY_STATUS);
+		return load<SMC_RESULT>(SMC_MMIO_READ_RESULT);
+	}
+
+	/**
+	 *  Host store to the device memory
+	 *
+	 *  @param off  register offset
+	 *  @param v    value
+	 */
+	template <typename T>
+	void store(uint32_t off, T v) {
+		if (direct) {
+			for (size_t i = 0; i < sizeof(T); i++)
+				mmio.directWrite(base, off + static_cast<uint32_t>(i), reinterpret_cast<const uint8_t *>(&v)[i]);
+		} else {
+			memcpy(window + off, &v, sizeof(T));
+			mmio.handleWrite(base, base + off);
+		}
+	}
+
+	/**
+	 *  Host load from the device memory outside of the status page
+	 *
+	 *  @param off  register offset
+	 *
+	 *  @return value
+	 */
+	template <typename T>
+	T load(uint32_t off) {
+		T v;
+		if (direct) {
+			for (size_t i = 0; i < sizeof(T); i++)
+				reinterpret_cast<uint8_t *>(&v)[i] = mmio.directRead(base, off + static_cast<uint32_t>(i));
+		} else {
+			memcpy(&v, window + off, sizeof(T));
+		}
+		return v;
+	}
+
+	/**
+	 *  Host load from a status register
+	 *
+	 *  @param off  SMC_MMIO_READ_KEY_STATUS or SMC_MMIO_READ_EVENT_STATUS
+	 *
+	 *  @return status value
+	 */
+	SMC_STATUS status(uint32_t off) {
+		if (direct)
+			return mmio.directRead(base, off);
+		mmio.handleRead(base, base + off);
+		return window[off];
+	}
+
+private:
+	SMCProtocolMMIO &mmio;
+	bool direct;
+};
+
+#endif /* test_mmio_hpp */
@@ -0,0 +1,218 @@
+//
+//  test_pmio.hpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef test_pmio_hpp
+#define test_pmio_hpp
+
+#include <string.h>
+
+#include "kern_intrs.hpp"
+#include "kern_pmio.hpp"
+
+/**
+ *  Interrupt delivery standing in for VirtualSMC on its interrupt queue: posts update the data
+ *  and queue a code once while it is pending, event port reads hand the oldest code to the protocol.
+ *  An interrupt is caused for the first queued code and again after a read while more are queued.
+ */
+class PMIOEvents : public SMCProtocolEvents {
+public:
+	/**
+	 *  Protocol receiving the consumed interrupts
+	 */
+	SMCProtocolPMIO *pmio {nullptr};
+
+	/**
+	 *  Number of caused interrupts
+	 */
+	size_t interrupts {0};
+
+	/**
+	 *  Data of the last consumed interrupt
+	 */
+	uint8_t lastData[SMC_MAX_LOG_SIZE] {};
+	uint32_t lastSize {0};
+
+	bool init() {
+		return queue.init();
+	}
+
+	void deinit() {
+		queue.deinit();
+	}
+
+	void postInterrupt(SMC_EVENT_CODE code) override {
+		post(code, nullptr, 0);
+	}
+
+	/**
+	 *  Post an interrupt with data
+	 *
+	 *  @param code  event code
+	 *  @param data  event data (optional)
+	 *  @param size  event data size, up to SMC_MAX_LOG_SIZE
+	 */
+	void post(SMC_EVENT_CODE code, const void *data, uint32_t size) {
+		queue.store(code, data, size);
+		if (queue.setPending(code) && queue.push(code))
+			interrupts++;
+	}
+
+	SMC_EVENT_CODE getInterrupt() override {
+		uint64_t postTime, queueTime;
+		auto code = queue.pop(postTime, queueTime);
+		if (code != 0) {
+			lastSize = queue.load(code, lastData);
+			if (pmio)
+				pmio->setInterrupt(code, lastData, lastSize);
+			if (queue.complete())
+				interrupts++;
+		}
+		return code;
+	}
+
+private:
+	SMCInterruptQueue queue;
+};
+
+/**
+ *  Drives SMCProtocolPMIO port by port the way AppleSMC does,
+ *  optionally recording every port access with the status seen after it.
+ */
+class PMIODriver {
+public:
+	enum Op : uint8_t {
+		OpCommand,
+		OpWrite,
+		OpRead,
+		OpResult
+	};
+
+	struct Step {
+		Op op;
+		uint8_t value;   // Written or read value (result for OpResult)
+		uint8_t status;  // Status port after the access (unused for OpResult)
+	};
+
+	static constexpr size_t MaxSteps {160};
+
+	explicit PMIODriver(SMCProtocolPMIO &pmio) : pmio(pmio) {}
+
+	/**
+	 *  Start recording a trace
+	 */
+	void startTrace() {
+		tracing = true;
+		stepNum = 0;
+	}
+
+	/**
+	 *  Compare the recorded trace with the expected one
+	 *
+	 *  @return true if identical
+	 */
+	bool matchTrace(const Step *expected, size_t num) const {
+		if (num != stepNum) {
+			fprintf(stderr, "trace has %zu steps, expected %zu\n", stepNum, num);
+			return false;
+		}
+
+		for (size_t i = 0; i < num; i++) {
+			if (steps[i].op != expected[i].op || steps[i].value != expected[i].value ||
+				(steps[i].op != OpResult && steps[i].status != expected[i].status)) {
+				fprintf(stderr, "trace step %zu is op %u value %02X status %02X, expected op %u value %02X status %02X\n", i,
+						steps[i].op, steps[i].value, steps[i].status, expected[i].op, expected[i].value, expected[i].status);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	SMC_RESULT readKey(SMC_KEY key, SMC_DATA_SIZE size, SMC_DATA *out) {
+		command(SmcCmdReadValue);
+		writeBytes(&key, sizeof(key));
+		write(size);
+		for (SMC_DATA_SIZE i = 0; i < size; i++)
+			out[i] = read();
+		return result();
+	}
+
+	SMC_RESULT writeKey(SMC_KEY key, const SMC_DATA *data, SMC_DATA_SIZE size) {
+		command(SmcCmdWriteValue);
+		writeBytes(&key, sizeof(key));
+		write(size);
+		writeBytes(data, size);
+		return result();
+	}
+
+	SMC_RESULT getKeyInfo(SMC_KEY key, SMC_DATA_SIZE &size, SMC_KEY_TYPE &type, SMC_KEY_ATTRIBUTES &attr) {
+		command(SmcCmdGetKeyInfo);
+		writeBytes(&key, sizeof(key));
+		uint8_t info[6];
+		for (auto &b : info)
+			b = read();
+		size = info[0];
+		memcpy(&type, &info[1], sizeof(type));
+		attr = info[5];
+		return result();
+	}
+
+	SMC_RESULT getKeyFromIndex(SMC_KEY_INDEX index, SMC_KEY &key) {
+		command(SmcCmdGetKeyFromIndex);
+		auto be = OSSwapInt32(index);
+		writeBytes(&be, sizeof(be));
+		uint8_t name[4];
+		for (auto &b : name)
+			b = read();
+		memcpy(&key, name, sizeof(key));
+		return result();
+	}
+
+	void command(SMC_COMMAND cmd) {
+		pmio.writeCommand(cmd);
+		record(OpCommand, cmd);
+	}
+
+	void write(uint8_t v) {
+		pmio.writeData(v);
+		record(OpWrite, v);
+	}
+
+	void writeBytes(const void *src, size_t size) {
+		for (size_t i = 0; i < size; i++)
+			write(static_cast<const uint8_t *>(src)[i]);
+	}
+
+	uint8_t read() {
+		auto v = pmio.readData();
+		record(OpRead, v);
+		return v;
+	}
+
+	SMC_EVENT_CODE event() {
+		return pmio.readEvent();
+	}
+
+	SMC_RESULT result() {
+		auto r = pmio.readResult();
+		if (tracing && stepNum < MaxSteps)
+			steps[stepNum++] = {OpResult, r, 0};
+		return r;
+	}
+
+private:
+	SMCProtocolPMIO &pmio;
+	Step steps[MaxSteps] {};
+	size_t stepNum {0};
+	bool tracing {false};
+
+	void record(Op op, uint8_t value) {
+		if (tracing && stepNum < MaxSteps)
+			steps[stepNum++] = {op, value, pmio.readStatus()};
+	}
+};
+
+#endif /* test_pmio_hpp */
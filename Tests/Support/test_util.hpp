@@ -0,0 +1,85 @@
+//
+//  test_util.hpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef test_util_hpp
+#define test_util_hpp
+
+#include <Headers/kern_time.hpp>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ *  Number of failed checks in the current program
+ */
+inline size_t testFailures {0};
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		testFailures++; \
+	} \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+	auto checkA = static_cast<unsigned long long>(a); \
+	auto checkB = static_cast<unsigned long long>(b); \
+	if (checkA != checkB) { \
+		fprintf(stderr, "%s:%d: check failed: %s == %s (%llX != %llX)\n", __FILE__, __LINE__, #a, #b, checkA, checkB); \
+		testFailures++; \
+	} \
+} while (0)
+
+/**
+ *  Fuzz target oracle, aborts so that the fuzzer keeps the failing input
+ */
+#define FUZZ_CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: oracle failed: %s\n", __FILE__, __LINE__, #cond); \
+		abort(); \
+	} \
+} while (0)
+
+/**
+ *  Report the test outcome
+ *
+ *  @param name  program name
+ *
+ *  @return process exit code
+ */
+inline int testResult(const char *name) {
+	if (testFailures > 0) {
+		fprintf(stderr, "%s: %zu checks failed\n", name, testFailures);
+		return 1;
+	}
+
+	printf("%s: passed\n", name);
+	return 0;
+}
+
+/**
+ *  Simple xorshift generator, deterministic across platforms
+ */
+class TestRandom {
+	uint64_t state;
+
+public:
+	explicit TestRandom(uint64_t seed) : state(seed ? seed : 0x106689D45497FDB5) {}
+
+	uint64_t next() {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 0x2545F4914F6CDD1D;
+	}
+
+	uint32_t below(uint32_t bound) {
+		return static_cast<uint32_t>(next() % bound);
+	}
+};
+
+#endif /* test_util_hpp */
@@ -0,0 +1,111 @@
+//
+//  bench_mmio.cpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Transaction-level MMIO microbenchmark in trap and direct-call modes. Besides the time
+//  per transaction it reports the kernel write windows opened (MachInfo::setKernelWriting)
+//  and the bytes copied and erased by the protocol and keystore code, counted by the shims.
+//  The page fault cost of trap mode is not included.
+//
+//  Usage: bench_mmio [iterations]
+//
+
+#include <stdlib.h>
+#include <Headers/kern_mach.hpp>
+
+#include "test_keystore.hpp"
+#include "test_mmio.hpp"
+#include "test_util.hpp"
+
+static constexpr SMC_KEY KeyTC0P = SMC_MAKE_IDENTIFIER('T','C','0','P');
+static constexpr SMC_KEY KeyFNum = SMC_MAKE_IDENTIFIER('F','N','u','m');
+static constexpr SMC_KEY KeyOSK0 = SMC_MAKE_IDENTIFIER('O','S','K','0');
+static constexpr SMC_KEY KeyNATJ = SMC_MAKE_IDENTIFIER('N','A','T','J');
+
+enum Kind {
+	KindRead1,
+	KindRead2,
+	KindRead32,
+	KindWrite1,
+	KindInfo,
+	KindLog,
+	KindTotal
+};
+
+static const char *KindNames[KindTotal] {
+	"read (1 byte)",
+	"read (2 bytes)",
+	"read (32 bytes)",
+	"write (1 byte)",
+	"getKeyInfo",
+	"log event"
+};
+
+int main(int argc, char *argv[]) {
+	size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 0) : 200000;
+	if (iterations == 0)
+		iterations = 1;
+
+	size_t failures = 0;
+
+	printf("%-6s %-16s %10s %8s %10s %14s %14s\n", "mode", "transaction", "count", "ns/tx", "windows/tx", "copied B/tx", "cleared B/tx");
+	for (int direct = 0; direct < 2; direct++) {
+		TestKeystore store;
+		TestEvents events;
+		SMCProtocolMMIO mmio(&store, &events);
+		events.mmio = &mmio;
+		MMIODriver host(mmio, direct);
+		SMC_DATA buf[SMC_MAX_DATA_SIZE] {};
+		SMC_DATA_SIZE size;
+		SMC_KEY_TYPE type;
+		SMC_KEY_ATTRIBUTES attr;
+
+		for (int kind = 0; kind < KindTotal; kind++) {
+			// Settle the state left by the previous kind.
+			host.readKey(KeyTC0P, 2, buf);
+			testCopiedBytes = testClearedBytes = MachInfo::kernelWriteWindows = 0;
+
+			auto start = getCurrentTimeNs();
+			for (size_t i = 0; i < iterations; i++) {
+				SMC_RESULT res = SmcSuccess;
+				switch (kind) {
+					case KindRead1:
+						res = host.readKey(KeyFNum, 1, buf);
+						break;
+					case KindRead2:
+						res = host.readKey(KeyTC0P, 2, buf);
+						break;
+					case KindRead32:
+						res = host.readKey(KeyOSK0, 32, buf);
+						break;
+					case KindWrite1:
+						buf[0] = static_cast<SMC_DATA>(i);
+						res = host.writeKey(KeyNATJ, buf, 1);
+						break;
+					case KindInfo:
+						res = host.getKeyInfo(KeyTC0P, size, type, attr);
+						break;
+					case KindLog: {
+						static const char message[] = "VirtualSMC: log message";
+						events.post(SmcEventLogMessage, message, i % 2 ? sizeof(message) : 8);
+						host.status(SMC_MMIO_READ_EVENT_STATUS);
+						break;
+					}
+				}
+				failures += res != SmcSuccess;
+			}
+			auto elapsed = getCurrentTimeNs() - start;
+
+			printf("%-6s %-16s %10zu %8.1f %10.2f %14.1f %14.1f\n", direct ? "direct" : "trap", KindNames[kind], iterations,
+				   static_cast<double>(elapsed) / iterations,
+				   static_cast<double>(MachInfo::kernelWriteWindows) / iterations,
+				   static_cast<double>(testCopiedBytes) / iterations,
+				   static_cast<double>(testClearedBytes) / iterations);
+		}
+	}
+
+	CHECK_EQ(failures, 0);
+	return testResult("bench_mmio");
+}
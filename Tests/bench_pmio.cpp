@@ -0,0 +1,104 @@
+//
+//  bench_pmio.cpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Transaction-level PMIO microbenchmark. Besides the time per transaction it reports
+//  the bytes erased and copied by the kext code per transaction, counted by the shims,
+//  to show the buffer maintenance work of every transaction kind.
+//
+//  Usage: bench_pmio [iterations]
+//
+
+#include <stdlib.h>
+
+#include "test_keystore.hpp"
+#include "test_pmio.hpp"
+#include "test_util.hpp"
+
+static constexpr SMC_KEY KeyTC0P = SMC_MAKE_IDENTIFIER('T','C','0','P');
+static constexpr SMC_KEY KeyOSK0 = SMC_MAKE_IDENTIFIER('O','S','K','0');
+static constexpr SMC_KEY KeyNATJ = SMC_MAKE_IDENTIFIER('N','A','T','J');
+static constexpr SMC_KEY KeyHBKP = SMC_MAKE_IDENTIFIER('H','B','K','P');
+static constexpr SMC_KEY KeyXXXX = SMC_MAKE_IDENTIFIER('X','X','X','X');
+
+enum Kind {
+	KindRead2,
+	KindRead32,
+	KindReadMissing,
+	KindWrite1,
+	KindWrite32,
+	KindInfo,
+	KindIndex,
+	KindTotal
+};
+
+static const char *KindNames[KindTotal] {
+	"read (2 bytes)",
+	"read (32 bytes)",
+	"read (missing)",
+	"write (1 byte)",
+	"write (32 bytes)",
+	"getKeyInfo",
+	"readNameByIndex"
+};
+
+int main(int argc, char *argv[]) {
+	size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 0) : 200000;
+	if (iterations == 0)
+		iterations = 1;
+
+	TestKeystore store;
+	SMCProtocolPMIO pmio(&store);
+	PMIODriver port(pmio);
+	SMC_DATA buf[SMC_MAX_DATA_SIZE] {};
+	SMC_DATA_SIZE size;
+	SMC_KEY_TYPE type;
+	SMC_KEY_ATTRIBUTES attr;
+	SMC_KEY key;
+	size_t failures = 0;
+
+	printf("%-18s %10s %8s %14s %14s\n", "transaction", "count", "ns/tx", "cleared B/tx", "copied B/tx");
+	for (int kind = 0; kind < KindTotal; kind++) {
+		testClearedBytes = testCopiedBytes = 0;
+		auto start = getCurrentTimeNs();
+		for (size_t i = 0; i < iterations; i++) {
+			SMC_RESULT res = SmcSuccess;
+			switch (kind) {
+				case KindRead2:
+					res = port.readKey(KeyTC0P, 2, buf);
+					break;
+				case KindRead32:
+					res = port.readKey(KeyOSK0, 32, buf);
+					break;
+				case KindReadMissing:
+					res = port.readKey(KeyXXXX, 2, buf) == SmcNotFound ? SmcSuccess : SmcError;
+					break;
+				case KindWrite1:
+					buf[0] = static_cast<SMC_DATA>(i);
+					res = port.writeKey(KeyNATJ, buf, 1);
+					break;
+				case KindWrite32:
+					buf[0] = static_cast<SMC_DATA>(i);
+					res = port.writeKey(KeyHBKP, buf, SMC_HBKP_SIZE);
+					break;
+				case KindInfo:
+					res = port.getKeyInfo(KeyTC0P, size, type, attr);
+					break;
+				case KindIndex:
+					res = port.getKeyFromIndex(static_cast<SMC_KEY_INDEX>(i % store.count()), key);
+					break;
+			}
+			failures += res != SmcSuccess;
+		}
+		auto elapsed = getCurrentTimeNs() - start;
+		printf("%-18s %10zu %8.1f %14.1f %14.1f\n", KindNames[kind], iterations,
+			   static_cast<double>(elapsed) / iterations,
+			   static_cast<double>(testClearedBytes) / iterations,
+			   static_cast<double>(testCopiedBytes) / iterations);
+	}
+
+	CHECK_EQ(failures, 0);
+	return testResult("bench_pmio");
+}
@@ -0,0 +1,107 @@
+//
+//  fuzz_mmio.cpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Fuzz target for SMCProtocolMMIO. The input is a sequence of host accesses to the device
+//  memory, each starting with an operation byte (see Op) followed by its arguments.
+//  Every input starts with a fresh device, keystore and window.
+//
+
+#include "test_keystore.hpp"
+#include "test_mmio.hpp"
+#include "test_util.hpp"
+
+enum Op : uint8_t {
+	OpStore,        // offset, value: trapped store to the first 0x80 bytes
+	OpCommand,      // command: trapped store to the command register
+	OpKeyStatus,    // trapped key status load
+	OpEventStatus,  // trapped event status load
+	OpPost,         // code, size: interrupt posted by a plugin
+	OpDirectWrite,  // offset (16-bit), value
+	OpDirectRead,   // offset (16-bit)
+	OpTotal
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	static const TestKeystore reference;
+	TestKeystore store;
+	TestEvents events;
+	SMCProtocolMMIO mmio(&store, &events);
+	events.mmio = &mmio;
+	MMIODriver host(mmio);
+
+	size_t i = 0;
+	auto arg = [&]() -> uint8_t {
+		return i < size ? data[i++] : 0;
+	};
+
+	// Every reply leaves nothing but its own data in the data area.
+	auto checkReply = [&]() {
+		auto published = host.window[SMC_MMIO_WRITE_DATA_SIZE];
+		FUZZ_CHECK(published <= SMC_MAX_DATA_SIZE);
+		for (size_t off = published; off < SMC_MAX_DATA_SIZE; off++)
+			FUZZ_CHECK(host.window[off] == 0);
+	};
+
+	while (i < size) {
+		switch (arg() % OpTotal) {
+			case OpStore: {
+				auto off = arg() % (SMC_MMIO_WRITE_COMMAND + 1);
+				host.store<uint8_t>(off, arg());
+				break;
+			}
+			case OpCommand:
+				host.store<SMC_COMMAND>(SMC_MMIO_WRITE_COMMAND, arg());
+				checkReply();
+				break;
+			case OpKeyStatus:
+				host.status(SMC_MMIO_READ_KEY_STATUS);
+				break;
+			case OpEventStatus:
+				host.status(SMC_MMIO_READ_EVENT_STATUS);
+				break;
+			case OpPost: {
+				static const char message[SMC_MAX_LOG_SIZE + 16] = "fuzz log message";
+				auto v = arg();
+				auto code = v & 1 ? SmcEventLogMessage : v & 2 ? SmcEventALSChange : SmcEventKeyDone;
+				events.post(code, message, arg() % sizeof(message));
+				break;
+			}
+			case OpDirectWrite: {
+				uint32_t off = arg();
+				off |= arg() << 8;
+				auto value = arg();
+				// Other offsets go to the original AppleSMC accessor.
+				if (!SMCProtocolMMIO::isDirectRegister(off))
+					break;
+				mmio.directWrite(host.base, off, value);
+				if (off == SMC_MMIO_WRITE_COMMAND)
+					checkReply();
+				break;
+			}
+			case OpDirectRead: {
+				uint32_t off = arg();
+				off |= arg() << 8;
+				if (SMCProtocolMMIO::isDirectRegister(off))
+					mmio.directRead(host.base, off);
+				break;
+			}
+		}
+	}
+
+	// Status page is never written besides the two status registers.
+	for (uint32_t off = SMC_MMIO_READ_EVENT_STATUS; off < SMC_MMIO_READ_EVENT_STATUS + PAGE_SIZE; off++) {
+		if (off != SMC_MMIO_READ_EVENT_STATUS && off != SMC_MMIO_READ_KEY_STATUS)
+			FUZZ_CHECK(host.window[off] == 0);
+	}
+
+	// Read-only values must survive any device memory traffic.
+	for (size_t k = 0; k < store.count(); k++) {
+		if (!(store.at(k).attr & SMC_KEY_ATTRIBUTE_WRITE))
+			FUZZ_CHECK(memcmp(store.at(k).data, reference.at(k).data, store.at(k).size) == 0);
+	}
+
+	return 0;
+}
@@ -0,0 +1,89 @@
+//
+//  fuzz_pmio.cpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Fuzz target for SMCProtocolPMIO. The input is a sequence of two byte port accesses:
+//  operation (see Op) and value. Every input starts with a fresh device and keystore.
+//
+
+#include "test_keystore.hpp"
+#include "test_util.hpp"
+#include "kern_pmio.hpp"
+
+enum Op : uint8_t {
+	OpCommand,
+	OpWrite,
+	OpRead,
+	OpStatus,
+	OpResult,
+	OpInterrupt,
+	OpTotal
+};
+
+static bool sameValues(const TestKeystore &a, const TestKeystore &b) {
+	for (size_t i = 0; i < a.count(); i++) {
+		if (memcmp(a.at(i).data, b.at(i).data, a.at(i).size) != 0)
+			return false;
+	}
+	return true;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	static const TestKeystore reference;
+	TestKeystore store;
+	SMCProtocolPMIO pmio(&store);
+
+	static constexpr SMC_STATUS KnownStatus = SMC_STATUS_READY | SMC_STATUS_BUSY | SMC_STATUS_GOT_COMMAND | SMC_STATUS_AWAITING_DATA;
+
+	// First error reported by a data write, later data writes of the transaction must keep it.
+	SMC_RESULT writeError = SmcSuccess;
+
+	for (size_t i = 0; i + 1 < size; i += 2) {
+		uint8_t v = data[i + 1];
+		switch (data[i] % OpTotal) {
+			case OpCommand:
+				pmio.writeCommand(v);
+				writeError = SmcSuccess;
+				break;
+			case OpWrite: {
+				auto before = pmio.readResult();
+				pmio.writeData(v);
+				auto after = pmio.readResult();
+				if (writeError != SmcSuccess)
+					FUZZ_CHECK(after == writeError);
+				else if (after != before)
+					writeError = after;
+				break;
+			}
+			case OpRead:
+				pmio.readData();
+				writeError = SmcSuccess;
+				break;
+			case OpStatus:
+				FUZZ_CHECK((pmio.readStatus() & ~KnownStatus) == 0);
+				break;
+			case OpResult:
+				pmio.readResult();
+				break;
+			case OpInterrupt: {
+				static const char message[] = "fuzz log message";
+				auto code = v & 1 ? SmcEventLogMessage : SmcEventALSChange;
+				pmio.setInterrupt(code, message, v % sizeof(message));
+				break;
+			}
+		}
+	}
+
+	// Read-only values must survive any port traffic.
+	for (size_t i = 0; i < store.count(); i++) {
+		if (!(store.at(i).attr & SMC_KEY_ATTRIBUTE_WRITE))
+			FUZZ_CHECK(memcmp(store.at(i).data, reference.at(i).data, store.at(i).size) == 0);
+	}
+
+	// Every keystore write originates from a complete write transaction.
+	FUZZ_CHECK(store.writes > 0 || sameValues(store, reference));
+
+	return 0;
+}
@@ -0,0 +1,161 @@
+//
+//  intr_queue.cpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Stress test of SMCInterruptQueue with several producers and a single consumer,
+//  posting the way VirtualSMC::postInterrupt does and consuming the way AppleSMC does:
+//  one event read per caused interrupt. Every caused interrupt must find a queued code,
+//  no code may be lost, data must never be torn, and the last delivery of every code
+//  must carry its latest data.
+//
+//  Usage: intr_queue [posts per producer]
+//
+
+#include <atomic>
+#include <thread>
+
+#include "kern_intrs.hpp"
+#include "test_util.hpp"
+
+static constexpr size_t Producers {4};
+
+/**
+ *  Post an interrupt like VirtualSMC::postInterrupt without policies
+ *
+ *  @return true if an interrupt needs to be caused
+ */
+static bool post(SMCInterruptQueue &queue, SMC_EVENT_CODE code, const uint8_t *data, uint32_t size) {
+	queue.store(code, data, size);
+	if (!queue.setPending(code))
+		return false;
+	auto &si = queue.at(code);
+	si.postTime = si.queueTime = getCurrentTimeNs();
+	return queue.push(code);
+}
+
+/**
+ *  Event data is the code followed by a counting sequence, torn updates break it
+ */
+static bool validData(SMC_EVENT_CODE code, const uint8_t *data, uint32_t size) {
+	if (size < 2 || size > SMC_MAX_LOG_SIZE || data[0] != code)
+		return false;
+	for (uint32_t i = 2; i < size; i++) {
+		if (data[i] != static_cast<uint8_t>(data[1] + i - 1))
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	size_t posts = argc > 1 ? strtoul(argv[1], nullptr, 0) : 200000;
+
+	SMCInterruptQueue queue;
+	CHECK(queue.init());
+
+	std::atomic<size_t> causes {0};
+	std::atomic<bool> done {false};
+	std::atomic<size_t> posted[SMCInterruptQueue::Size] {};
+
+	size_t delivered[SMCInterruptQueue::Size] {};
+	uint8_t last[SMCInterruptQueue::Size][SMC_MAX_LOG_SIZE] {};
+	uint32_t lastSize[SMCInterruptQueue::Size] {};
+	size_t emptyPops = 0, tornReads = 0, badTimes = 0;
+
+	std::thread consumer([&]() {
+		uint8_t data[SMC_MAX_LOG_SIZE];
+		while (true) {
+			size_t pending = causes.load(std::memory_order_acquire);
+			if (pending == 0) {
+				if (done.load(std::memory_order_acquire) && causes.load(std::memory_order_acquire) == 0)
+					break;
+				std::this_thread::yield();
+				continue;
+			}
+			causes.fetch_sub(1, std::memory_order_acq_rel);
+
+			uint64_t postTime, queueTime;
+			auto code = queue.pop(postTime, queueTime);
+			if (code == 0) {
+				emptyPops++;
+				continue;
+			}
+
+			auto size = queue.load(code, data);
+			if (!validData(code, data, size))
+				tornReads++;
+			if (postTime == 0 || queueTime < postTime)
+				badTimes++;
+			memcpy(last[code], data, size);
+			lastSize[code] = size;
+			delivered[code]++;
+
+			if (queue.complete())
+				causes.fetch_add(1, std::memory_order_acq_rel);
+		}
+	});
+
+	std::thread producers[Producers];
+	for (size_t p = 0; p < Producers; p++) {
+		producers[p] = std::thread([&, p]() {
+			TestRandom rng(p + 1);
+			uint8_t data[SMC_MAX_LOG_SIZE];
+			for (size_t i = 0; i < posts; i++) {
+				// Mostly a few hot codes to force coalescing, sometimes any code.
+				auto r = rng.next();
+				auto code = static_cast<SMC_EVENT_CODE>(r % 8 == 0 ? 1 + (r >> 8) % (SMCInterruptQueue::Size - 1) : 1 + (r >> 8) % 8);
+				auto size = static_cast<uint32_t>(2 + (r >> 16) % (SMC_MAX_LOG_SIZE - 1));
+				data[0] = code;
+				for (uint32_t j = 1; j < size; j++)
+					data[j] = static_cast<uint8_t>(i + j);
+				posted[code].fetch_add(1, std::memory_order_relaxed);
+				if (post(queue, code, data, size))
+					causes.fetch_add(1, std::memory_order_acq_rel);
+				// Let the consumer run on machines with few cores.
+				if (i % 16 == 0)
+					std::this_thread::yield();
+			}
+		});
+	}
+
+	for (auto &producer : producers)
+		producer.join();
+	done.store(true, std::memory_order_release);
+	consumer.join();
+
+	CHECK_EQ(emptyPops, 0);
+	CHECK_EQ(tornReads, 0);
+	CHECK_EQ(badTimes, 0);
+
+	// Everything is consumed, and nothing stays pending.
+	uint64_t postTime, queueTime;
+	CHECK_EQ(queue.pop(postTime, queueTime), 0);
+
+	size_t totalPosted = 0, totalDelivered = 0, codes = 0;
+	uint8_t data[SMC_MAX_LOG_SIZE];
+	for (size_t code = 1; code < SMCInterruptQueue::Size; code++) {
+		auto num = posted[code].load();
+		totalPosted += num;
+		totalDelivered += delivered[code];
+		if (num == 0) {
+			CHECK_EQ(delivered[code], 0);
+			continue;
+		}
+		codes++;
+		CHECK(delivered[code] > 0);
+		CHECK(delivered[code] <= num);
+		// A pending code must not be lost, so the last delivery carries the last stored data.
+		auto size = queue.load(static_cast<SMC_EVENT_CODE>(code), data);
+		CHECK_EQ(lastSize[code], size);
+		CHECK(memcmp(last[code], data, size) == 0);
+		// The pending bit is clear, a new post queues the code again.
+		CHECK(queue.setPending(static_cast<SMC_EVENT_CODE>(code)));
+	}
+
+	printf("%zu producers, %zu posts, %zu codes, %zu delivered (%.1f%% coalesced)\n", Producers, totalPosted, codes, totalDelivered,
+		   totalPosted > 0 ? 100.0 * (totalPosted - totalDelivered) / totalPosted : 0.0);
+
+	queue.deinit();
+	return testResult("intr_queue");
+}
@@ -0,0 +1,149 @@
+//
+//  mmio_direct.cpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Checks the -vsmcdirect accessor dispatch: which AppleSMC accessor offsets are served
+//  as mmio registers and which (pmio ports) go to the original accessor, and that direct
+//  calls produce the same transactions and device memory as trapped accesses.
+//
+//  Usage: mmio_direct
+//
+
+#include <Headers/kern_mach.hpp>
+
+#include "test_keystore.hpp"
+#include "test_mmio.hpp"
+#include "test_util.hpp"
+
+static constexpr SMC_KEY KeyTC0P = SMC_MAKE_IDENTIFIER('T','C','0','P');
+static constexpr SMC_KEY KeyOSK0 = SMC_MAKE_IDENTIFIER('O','S','K','0');
+static constexpr SMC_KEY KeyNATJ = SMC_MAKE_IDENTIFIER('N','A','T','J');
+static constexpr SMC_KEY KeyXXXX = SMC_MAKE_IDENTIFIER('X','X','X','X');
+
+/**
+ *  Accessor offsets must split into mmio registers and everything else
+ */
+static void testDispatch() {
+	// Legacy i/o ports, AppleSMC passes these when it talks over pmio.
+	for (uint32_t port = SMC_PORT_BASE; port < SMC_PORT_BASE + SMC_PORT_LENGTH; port++)
+		CHECK(!SMCProtocolMMIO::isDirectRegister(port));
+
+	const uint32_t registers[] {
+		SMC_MMIO_DATA_VARIABLE, SMC_MMIO_DATA_VARIABLE + SMC_MAX_DATA_SIZE - 1,
+		SMC_MMIO_WRITE_KEY, SMC_MMIO_WRITE_DATA_SIZE, SMC_MMIO_WRITE_KEY_ATTRIBUTES, SMC_MMIO_WRITE_COMMAND,
+		SMC_MMIO_READ_KEY_TYPE, SMC_MMIO_READ_DATA_SIZE, SMC_MMIO_READ_KEY_ATTRIBUTES, SMC_MMIO_READ_RESULT,
+		SMC_MMIO_READ_LOG, SMC_MMIO_READ_LOG + SMC_MAX_LOG_SIZE - 1,
+		SMC_MMIO_READ_EVENT_STATUS, SMC_MMIO_READ_UNKNOWN1, SMC_MMIO_READ_KEY_STATUS
+	};
+	for (auto off : registers)
+		CHECK(SMCProtocolMMIO::isDirectRegister(off));
+
+	const uint32_t others[] {
+		SMC_MMIO_READ_LOG + SMC_MAX_LOG_SIZE, 0x1000, SMC_MMIO_READ_EVENT_STATUS - 1,
+		SMC_MMIO_READ_KEY_STATUS + 1, SMC_MMIO_LENGTH - 1, SMC_MMIO_LENGTH, UINT32_MAX
+	};
+	for (auto off : others)
+		CHECK(!SMCProtocolMMIO::isDirectRegister(off));
+}
+
+/**
+ *  Direct request writes are buffered until the command, which publishes the reply in one write window
+ */
+static void testRegisters() {
+	TestKeystore store;
+	TestEvents events;
+	SMCProtocolMMIO mmio(&store, &events);
+	events.mmio = &mmio;
+	MMIODriver host(mmio, true);
+
+	MachInfo::kernelWriteWindows = 0;
+	mmio.directWrite(host.base, SMC_MMIO_WRITE_KEY_ATTRIBUTES, 0x5A);
+	mmio.directWrite(host.base, SMC_MMIO_DATA_VARIABLE, 0xA5);
+	CHECK_EQ(host.window[SMC_MMIO_WRITE_KEY_ATTRIBUTES], 0);
+	CHECK_EQ(host.window[SMC_MMIO_DATA_VARIABLE], 0);
+	CHECK_EQ(MachInfo::kernelWriteWindows, 0);
+
+	// The non-zero attributes fail the command, its reply clears the registers.
+	const SMC_KEY key = KeyTC0P;
+	for (uint32_t i = 0; i < sizeof(key); i++)
+		mmio.directWrite(host.base, SMC_MMIO_WRITE_KEY + i, reinterpret_cast<const uint8_t *>(&key)[i]);
+	mmio.directWrite(host.base, SMC_MMIO_WRITE_COMMAND, SmcCmdReadValue);
+	CHECK_EQ(MachInfo::kernelWriteWindows, 1);
+	CHECK_EQ(host.window[SMC_MMIO_READ_RESULT], SmcBadCommand);
+	CHECK_EQ(host.window[SMC_MMIO_WRITE_KEY], 0);
+	CHECK_EQ(host.window[SMC_MMIO_WRITE_KEY_ATTRIBUTES], 0);
+	CHECK_EQ(host.window[SMC_MMIO_DATA_VARIABLE], 0);
+
+	// Full transactions open a single window as well.
+	SMC_DATA buf[SMC_MAX_DATA_SIZE];
+	CHECK_EQ(host.readKey(KeyOSK0, 32, buf), SmcSuccess);
+	buf[0] = 1;
+	CHECK_EQ(host.writeKey(KeyNATJ, buf, 1), SmcSuccess);
+	CHECK_EQ(store.find(KeyNATJ)->data[0], 1);
+	CHECK_EQ(MachInfo::kernelWriteWindows, 3);
+
+	// Status page stays untouched, its registers are produced on read.
+	mmio.directWrite(host.base, SMC_MMIO_READ_KEY_STATUS, 0xFF);
+	mmio.directWrite(host.base, SMC_MMIO_READ_UNKNOWN1, 0xFF);
+	CHECK_EQ(host.window[SMC_MMIO_READ_KEY_STATUS], 0);
+	CHECK_EQ(host.window[SMC_MMIO_READ_UNKNOWN1], 0);
+	CHECK_EQ(mmio.directRead(host.base, SMC_MMIO_READ_UNKNOWN1), 0);
+}
+
+/**
+ *  Run the same transactions in trap and direct mode and compare the results and replies
+ */
+static void testTransactions() {
+	TestKeystore stores[2];
+	TestEvents events[2];
+	SMCProtocolMMIO trapped(&stores[0], &events[0]);
+	SMCProtocolMMIO direct(&stores[1], &events[1]);
+	events[0].mmio = &trapped;
+	events[1].mmio = &direct;
+	MMIODriver hosts[2] {MMIODriver(trapped, false), MMIODriver(direct, true)};
+
+	auto compare = [&]() {
+		CHECK(memcmp(hosts[0].window, hosts[1].window, SMC_MMIO_READ_LOG + SMC_MAX_LOG_SIZE) == 0);
+	};
+
+	SMC_DATA buf[2][SMC_MAX_DATA_SIZE] {};
+	SMC_DATA_SIZE size[2];
+	SMC_KEY_TYPE type[2];
+	SMC_KEY_ATTRIBUTES attr[2];
+	SMC_KEY key[2];
+
+	for (size_t pass = 0; pass < 4; pass++) {
+		for (int m = 0; m < 2; m++) {
+			CHECK_EQ(hosts[m].readKey(KeyOSK0, 32, buf[m]), SmcSuccess);
+		}
+		CHECK(memcmp(buf[0], buf[1], 32) == 0);
+		compare();
+
+		for (int m = 0; m < 2; m++) {
+			buf[m][0] = static_cast<SMC_DATA>(pass);
+			CHECK_EQ(hosts[m].writeKey(KeyNATJ, buf[m], 1), SmcSuccess);
+		}
+		compare();
+
+		for (int m = 0; m < 2; m++) {
+			CHECK_EQ(hosts[m].readKey(KeyTC0P, 2, buf[m]), SmcSuccess);
+			CHECK_EQ(hosts[m].getKeyInfo(KeyTC0P, size[m], type[m], attr[m]), SmcSuccess);
+			CHECK_EQ(hosts[m].getKeyFromIndex(static_cast<SMC_KEY_INDEX>(pass), key[m]), SmcSuccess);
+			CHECK_EQ(hosts[m].readKey(KeyXXXX, 2, buf[m]), SmcNotFound);
+		}
+		CHECK_EQ(size[0], size[1]);
+		CHECK_EQ(type[0], type[1]);
+		CHECK_EQ(attr[0], attr[1]);
+		CHECK_EQ(key[0], key[1]);
+		compare();
+	}
+}
+
+int main() {
+	testDispatch();
+	testRegisters();
+	testTransactions();
+	return testResult("mmio_direct");
+}
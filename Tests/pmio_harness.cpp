@@ -0,0 +1,317 @@
+//
+//  pmio_harness.cpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Drives complete SMCProtocolPMIO transactions through the port handlers,
+//  compares them against expected port traces, checks event port delivery,
+//  and reports transactions per second.
+//
+//  Usage: pmio_harness [iterations]
+//
+
+#include <stdlib.h>
+
+#include "test_keystore.hpp"
+#include "test_pmio.hpp"
+#include "test_util.hpp"
+
+using Step = PMIODriver::Step;
+
+static constexpr SMC_KEY KeyTC0P = SMC_MAKE_IDENTIFIER('T','C','0','P');
+static constexpr SMC_KEY KeyF0Ac = SMC_MAKE_IDENTIFIER('F','0','A','c');
+static constexpr SMC_KEY KeyNATJ = SMC_MAKE_IDENTIFIER('N','A','T','J');
+static constexpr SMC_KEY KeyHBKP = SMC_MAKE_IDENTIFIER('H','B','K','P');
+static constexpr SMC_KEY KeyCLKT = SMC_MAKE_IDENTIFIER('C','L','K','T');
+static constexpr SMC_KEY KeyOSK0 = SMC_MAKE_IDENTIFIER('O','S','K','0');
+static constexpr SMC_KEY KeyXXXX = SMC_MAKE_IDENTIFIER('X','X','X','X');
+
+// Port status values seen by AppleSMC
+static constexpr uint8_t Cmd  = SMC_STATUS_READY | SMC_STATUS_BUSY | SMC_STATUS_GOT_COMMAND;
+static constexpr uint8_t Busy = SMC_STATUS_READY | SMC_STATUS_BUSY;
+static constexpr uint8_t Data = SMC_STATUS_READY | SMC_STATUS_BUSY | SMC_STATUS_AWAITING_DATA;
+static constexpr uint8_t Done = SMC_STATUS_READY;
+
+static const Step ReadTC0P[] {
+	{PMIODriver::OpCommand, SmcCmdReadValue, Cmd},
+	{PMIODriver::OpWrite, 'T', Busy}, {PMIODriver::OpWrite, 'C', Busy}, {PMIODriver::OpWrite, '0', Busy}, {PMIODriver::OpWrite, 'P', Busy},
+	{PMIODriver::OpWrite, 2, Data},
+	{PMIODriver::OpRead, 0x2e, Data}, {PMIODriver::OpRead, 0x80, Done},
+	{PMIODriver::OpResult, SmcSuccess, 0}
+};
+
+static const Step ReadMissing[] {
+	{PMIODriver::OpCommand, SmcCmdReadValue, Cmd},
+	{PMIODriver::OpWrite, 'X', Busy}, {PMIODriver::OpWrite, 'X', Busy}, {PMIODriver::OpWrite, 'X', Busy}, {PMIODriver::OpWrite, 'X', Busy},
+	{PMIODriver::OpWrite, 2, Data},
+	{PMIODriver::OpRead, 0, Data}, {PMIODriver::OpRead, 0, Done},
+	{PMIODriver::OpResult, SmcNotFound, 0}
+};
+
+static const Step ReadWrongSize[] {
+	{PMIODriver::OpCommand, SmcCmdReadValue, Cmd},
+	{PMIODriver::OpWrite, 'T', Busy}, {PMIODriver::OpWrite, 'C', Busy}, {PMIODriver::OpWrite, '0', Busy}, {PMIODriver::OpWrite, 'P', Busy},
+	{PMIODriver::OpWrite, 4, Data},
+	{PMIODriver::OpRead, 0, Data}, {PMIODriver::OpRead, 0, Data}, {PMIODriver::OpRead, 0, Data}, {PMIODriver::OpRead, 0, Done},
+	{PMIODriver::OpResult, SmcKeySizeMismatch, 0}
+};
+
+static const Step WriteNATJ[] {
+	{PMIODriver::OpCommand, SmcCmdWriteValue, Cmd},
+	{PMIODriver::OpWrite, 'N', Busy}, {PMIODriver::OpWrite, 'A', Busy}, {PMIODriver::OpWrite, 'T', Busy}, {PMIODriver::OpWrite, 'J', Busy},
+	{PMIODriver::OpWrite, 1, Busy},
+	{PMIODriver::OpWrite, 1, Done},
+	{PMIODriver::OpResult, SmcSuccess, 0}
+};
+
+static const Step WriteReadOnly[] {
+	{PMIODriver::OpCommand, SmcCmdWriteValue, Cmd},
+	{PMIODriver::OpWrite, 'T', Busy}, {PMIODriver::OpWrite, 'C', Busy}, {PMIODriver::OpWrite, '0', Busy}, {PMIODriver::OpWrite, 'P', Busy},
+	{PMIODriver::OpWrite, 2, Busy},
+	{PMIODriver::OpWrite, 0x30, Busy}, {PMIODriver::OpWrite, 0x00, Done},
+	{PMIODriver::OpResult, SmcNotWritable, 0}
+};
+
+static const Step WriteOversize[] {
+	{PMIODriver::OpCommand, SmcCmdWriteValue, Cmd},
+	{PMIODriver::OpWrite, 'H', Busy}, {PMIODriver::OpWrite, 'B', Busy}, {PMIODriver::OpWrite, 'K', Busy}, {PMIODriver::OpWrite, 'P', Busy},
+	{PMIODriver::OpWrite, SMC_MAX_DATA_SIZE + 1, Done},
+	{PMIODriver::OpWrite, 0x01, Done}, {PMIODriver::OpWrite, 0x02, Done},
+	{PMIODriver::OpResult, SmcKeySizeMismatch, 0}
+};
+
+static const Step InfoTC0P[] {
+	{PMIODriver::OpCommand, SmcCmdGetKeyInfo, Cmd},
+	{PMIODriver::OpWrite, 'T', Busy}, {PMIODriver::OpWrite, 'C', Busy}, {PMIODriver::OpWrite, '0', Busy}, {PMIODriver::OpWrite, 'P', Data},
+	{PMIODriver::OpRead, 2, Data},
+	{PMIODriver::OpRead, 's', Data}, {PMIODriver::OpRead, 'p', Data}, {PMIODriver::OpRead, '7', Data}, {PMIODriver::OpRead, '8', Data},
+	{PMIODriver::OpRead, SMC_KEY_ATTRIBUTE_READ, Done},
+	{PMIODriver::OpResult, SmcSuccess, 0}
+};
+
+static const Step IndexZero[] {
+	{PMIODriver::OpCommand, SmcCmdGetKeyFromIndex, Cmd},
+	{PMIODriver::OpWrite, 0, Busy}, {PMIODriver::OpWrite, 0, Busy}, {PMIODriver::OpWrite, 0, Busy}, {PMIODriver::OpWrite, 0, Data},
+	{PMIODriver::OpRead, '#', Data}, {PMIODriver::OpRead, 'K', Data}, {PMIODriver::OpRead, 'E', Data}, {PMIODriver::OpRead, 'Y', Done},
+	{PMIODriver::OpResult, SmcSuccess, 0}
+};
+
+static void checkConformance() {
+	TestKeystore store;
+	SMCProtocolPMIO pmio(&store);
+	PMIODriver port(pmio);
+	SMC_DATA buf[SMC_MAX_DATA_SIZE];
+
+	port.startTrace();
+	port.readKey(KeyTC0P, 2, buf);
+	CHECK(port.matchTrace(ReadTC0P, arrsize(ReadTC0P)));
+
+	port.startTrace();
+	port.readKey(KeyXXXX, 2, buf);
+	CHECK(port.matchTrace(ReadMissing, arrsize(ReadMissing)));
+
+	port.startTrace();
+	port.readKey(KeyTC0P, 4, buf);
+	CHECK(port.matchTrace(ReadWrongSize, arrsize(ReadWrongSize)));
+
+	const SMC_DATA one[] {1};
+	port.startTrace();
+	port.writeKey(KeyNATJ, one, sizeof(one));
+	CHECK(port.matchTrace(WriteNATJ, arrsize(WriteNATJ)));
+	CHECK_EQ(store.find(KeyNATJ)->data[0], 1);
+
+	const SMC_DATA temp[] {0x30, 0x00};
+	port.startTrace();
+	port.writeKey(KeyTC0P, temp, sizeof(temp));
+	CHECK(port.matchTrace(WriteReadOnly, arrsize(WriteReadOnly)));
+	CHECK_EQ(store.find(KeyTC0P)->data[0], 0x2e);
+
+	// The size error must not be replaced by the errors for the value bytes that follow.
+	const SMC_DATA tail[] {0x01, 0x02};
+	port.startTrace();
+	port.command(SmcCmdWriteValue);
+	port.writeBytes(&KeyHBKP, sizeof(KeyHBKP));
+	port.write(SMC_MAX_DATA_SIZE + 1);
+	port.writeBytes(tail, sizeof(tail));
+	port.result();
+	CHECK(port.matchTrace(WriteOversize, arrsize(WriteOversize)));
+
+	port.startTrace();
+	SMC_DATA_SIZE size;
+	SMC_KEY_TYPE type;
+	SMC_KEY_ATTRIBUTES attr;
+	port.getKeyInfo(KeyTC0P, size, type, attr);
+	CHECK(port.matchTrace(InfoTC0P, arrsize(InfoTC0P)));
+
+	port.startTrace();
+	SMC_KEY key;
+	port.getKeyFromIndex(0, key);
+	CHECK(port.matchTrace(IndexZero, arrsize(IndexZero)));
+
+	// Walk the whole keystore as AppleSMC does on startup, and read every readable key back.
+	for (size_t i = 0; i < store.count(); i++) {
+		CHECK_EQ(port.getKeyFromIndex(static_cast<SMC_KEY_INDEX>(i), key), SmcSuccess);
+		CHECK_EQ(key, store.at(i).name);
+		CHECK_EQ(port.getKeyInfo(key, size, type, attr), SmcSuccess);
+		CHECK_EQ(size, store.at(i).size);
+		CHECK_EQ(type, store.at(i).type);
+		CHECK_EQ(attr, store.at(i).attr);
+		if (attr & SMC_KEY_ATTRIBUTE_READ) {
+			CHECK_EQ(port.readKey(key, size, buf), SmcSuccess);
+			CHECK(memcmp(buf, store.find(key)->data, size) == 0);
+		}
+	}
+	CHECK_EQ(port.getKeyFromIndex(static_cast<SMC_KEY_INDEX>(store.count()), key), SmcKeyIndexRangeError);
+
+	// Short writes must not pass the bytes left by the previous transactions to the keystore.
+	CHECK_EQ(port.readKey(KeyOSK0, 32, buf), SmcSuccess);
+	const SMC_DATA clkt[] {0x11};
+	CHECK_EQ(port.writeKey(KeyCLKT, clkt, sizeof(clkt)), SmcSuccess);
+	static const SMC_DATA clktValue[] {0x11, 0, 0, 0};
+	CHECK(memcmp(store.find(KeyCLKT)->data, clktValue, sizeof(clktValue)) == 0);
+
+	// Largest writable value round trip.
+	SMC_DATA hbkp[SMC_HBKP_SIZE];
+	for (size_t i = 0; i < sizeof(hbkp); i++)
+		hbkp[i] = static_cast<SMC_DATA>(i * 7 + 1);
+	CHECK_EQ(port.writeKey(KeyHBKP, hbkp, sizeof(hbkp)), SmcSuccess);
+	CHECK_EQ(port.readKey(KeyHBKP, sizeof(hbkp), buf), SmcSuccess);
+	CHECK(memcmp(buf, hbkp, sizeof(hbkp)) == 0);
+}
+
+/**
+ *  Posted events are read from the event port in posting order, a code posted again while pending
+ *  is delivered once with its latest data, and events do not disturb a transaction in progress.
+ */
+static void checkEvents() {
+	TestKeystore store;
+	PMIOEvents events;
+	CHECK(events.init());
+	SMCProtocolPMIO pmio(&store, &events);
+	events.pmio = &pmio;
+	PMIODriver port(pmio);
+	SMC_DATA buf[SMC_MAX_DATA_SIZE];
+
+	CHECK_EQ(port.event(), 0);
+
+	const uint8_t first[] {1}, second[] {2};
+	events.post(SmcEventPLimitChange, first, sizeof(first));
+	events.postInterrupt(SmcEventALSChange);
+	events.post(SmcEventPLimitChange, second, sizeof(second));
+	events.postInterrupt(SmcEventPowerStateNotify);
+	CHECK_EQ(events.interrupts, 1);
+
+	// Every read signals the next queued code until none are left.
+	CHECK_EQ(port.event(), SmcEventPLimitChange);
+	CHECK_EQ(events.lastSize, 1);
+	CHECK_EQ(events.lastData[0], 2);
+	CHECK_EQ(events.interrupts, 2);
+	CHECK_EQ(port.event(), SmcEventALSChange);
+	CHECK_EQ(events.interrupts, 3);
+	CHECK_EQ(port.event(), SmcEventPowerStateNotify);
+	CHECK_EQ(events.interrupts, 3);
+	CHECK_EQ(port.event(), 0);
+
+	// Consumed codes are queued again.
+	events.postInterrupt(SmcEventPLimitChange);
+	CHECK_EQ(events.interrupts, 4);
+
+	// A read in progress keeps its status and completes with the value.
+	port.command(SmcCmdReadValue);
+	port.writeBytes(&KeyTC0P, sizeof(KeyTC0P));
+	CHECK_EQ(pmio.readStatus(), Busy);
+	events.postInterrupt(SmcEventALSChange);
+	CHECK_EQ(port.event(), SmcEventPLimitChange);
+	CHECK_EQ(pmio.readStatus(), Busy);
+	port.write(2);
+	CHECK_EQ(pmio.readStatus(), Data);
+	CHECK_EQ(port.event(), SmcEventALSChange);
+	CHECK_EQ(pmio.readStatus(), Data);
+	buf[0] = port.read();
+	buf[1] = port.read();
+	CHECK_EQ(pmio.readStatus(), Done);
+	CHECK_EQ(port.result(), SmcSuccess);
+	CHECK(memcmp(buf, store.find(KeyTC0P)->data, 2) == 0);
+	CHECK_EQ(events.interrupts, 5);
+	CHECK_EQ(port.event(), 0);
+
+	events.deinit();
+}
+
+/**
+ *  Transaction kinds measured for throughput
+ */
+enum Kind {
+	KindRead,
+	KindWrite,
+	KindInfo,
+	KindIndex,
+	KindMixed,
+	KindTotal
+};
+
+static const char *KindNames[KindTotal] {
+	"read (2 bytes)",
+	"write (1 byte)",
+	"getKeyInfo",
+	"readNameByIndex",
+	"mixed monitoring"
+};
+
+static void measure(size_t iterations) {
+	TestKeystore store;
+	SMCProtocolPMIO pmio(&store);
+	PMIODriver port(pmio);
+	SMC_DATA buf[SMC_MAX_DATA_SIZE];
+	SMC_DATA_SIZE size;
+	SMC_KEY_TYPE type;
+	SMC_KEY_ATTRIBUTES attr;
+	SMC_KEY key;
+	size_t failures = 0;
+
+	printf("%-20s %12s %10s %14s\n", "transaction", "count", "ns/tx", "tx/s");
+	for (int kind = 0; kind < KindTotal; kind++) {
+		auto start = getCurrentTimeNs();
+		for (size_t i = 0; i < iterations; i++) {
+			SMC_RESULT res = SmcSuccess;
+			switch (kind) {
+				case KindRead:
+					res = port.readKey(KeyTC0P, 2, buf);
+					break;
+				case KindWrite:
+					buf[0] = static_cast<SMC_DATA>(i);
+					res = port.writeKey(KeyNATJ, buf, 1);
+					break;
+				case KindInfo:
+					res = port.getKeyInfo(KeyF0Ac, size, type, attr);
+					break;
+				case KindIndex:
+					res = port.getKeyFromIndex(static_cast<SMC_KEY_INDEX>(i % store.count()), key);
+					break;
+				case KindMixed:
+					// A typical monitoring daemon pass: a few temperature and fan reads per key info query.
+					if (i % 8 == 0)
+						res = port.getKeyInfo(KeyTC0P, size, type, attr);
+					else
+						res = port.readKey(i % 2 ? KeyTC0P : KeyF0Ac, 2, buf);
+					break;
+			}
+			failures += res != SmcSuccess;
+		}
+		auto elapsed = getCurrentTimeNs() - start;
+		double perTx = static_cast<double>(elapsed) / iterations;
+		printf("%-20s %12zu %10.1f %14.0f\n", KindNames[kind], iterations, perTx, 1e9 / perTx);
+	}
+
+	CHECK_EQ(failures, 0);
+}
+
+int main(int argc, char *argv[]) {
+	size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 0) : 200000;
+	checkConformance();
+	checkEvents();
+	if (iterations > 0)
+		measure(iterations);
+	return testResult("pmio_harness");
+}
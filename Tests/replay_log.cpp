@@ -0,0 +1,326 @@
+//
+//  replay_log.cpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Replays a TransactionLog (packed 16-byte SMCTransactionRecorder::Transaction records,
+//  as stored in the ioreg property after DumpTransactionLog) through SMCProtocolPMIO or
+//  SMCProtocolMMIO, following the protocol of every record, against TestKeystore. Keys
+//  missing from TestKeystore are added with the sizes seen in the log. The replay is
+//  recorded again with SMCTransactionRecorder and compared with the input, and the
+//  latency of every command type is reported.
+//
+//  Without a log file a session of startup and monitoring transactions is recorded
+//  first and replayed, which round trips the records through kern_record.cpp.
+//
+//  Usage: replay_log [-passes=N] [-save=FILE] [log file]
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "kern_pmio.hpp"
+#include "kern_record.hpp"
+#include "test_keystore.hpp"
+#include "test_mmio.hpp"
+#include "test_pmio.hpp"
+#include "test_util.hpp"
+
+using Transaction = SMCTransactionRecorder::Transaction;
+
+/**
+ *  Protocol instances with their drivers
+ */
+struct Device {
+	TestKeystore store;
+	TestEvents events;
+	SMCProtocolPMIO pmio {&store};
+	SMCProtocolMMIO mmio {&store, &events};
+	PMIODriver pmioHost {pmio};
+	MMIODriver mmioHost {mmio};
+	SMCTransactionRecorder recorder;
+
+	explicit Device(uint32_t capacity) {
+		events.mmio = &mmio;
+		recorder.init(capacity);
+		pmio.setRecorder(&recorder);
+		mmio.setRecorder(&recorder);
+	}
+
+	~Device() {
+		recorder.deinit();
+	}
+};
+
+/**
+ *  Replay a single transaction
+ *
+ *  @param dev  device
+ *  @param tx   recorded transaction
+ */
+static void replay(Device &dev, const Transaction &tx) {
+	SMC_DATA buf[SMC_MAX_DATA_SIZE] {};
+	SMC_DATA_SIZE size;
+	SMC_KEY_TYPE type;
+	SMC_KEY_ATTRIBUTES attr;
+	SMC_KEY key;
+
+	// Index transactions record the resulting key, find its index in our keystore.
+	SMC_KEY_INDEX index = static_cast<SMC_KEY_INDEX>(dev.store.count());
+	if (tx.command == SmcCmdGetKeyFromIndex) {
+		for (size_t i = 0; i < dev.store.count(); i++) {
+			if (dev.store.at(i).name == tx.key) {
+				index = static_cast<SMC_KEY_INDEX>(i);
+				break;
+			}
+		}
+	}
+
+	if (tx.protocol == SMCTransactionRecorder::ProtocolPMIO) {
+		auto &host = dev.pmioHost;
+		switch (tx.command) {
+			case SmcCmdReadValue:
+				host.readKey(tx.key, tx.size, buf);
+				break;
+			case SmcCmdWriteValue:
+				host.writeKey(tx.key, buf, tx.size);
+				break;
+			case SmcCmdGetKeyInfo:
+				host.getKeyInfo(tx.key, size, type, attr);
+				break;
+			case SmcCmdGetKeyFromIndex:
+				host.getKeyFromIndex(index, key);
+				break;
+			default:
+				host.command(tx.command);
+				host.write(0);
+				host.result();
+				break;
+		}
+	} else {
+		auto &host = dev.mmioHost;
+		switch (tx.command) {
+			case SmcCmdReadValue:
+				host.readKey(tx.key, tx.size, buf);
+				break;
+			case SmcCmdWriteValue:
+				host.writeKey(tx.key, buf, tx.size);
+				break;
+			case SmcCmdGetKeyInfo:
+				host.getKeyInfo(tx.key, size, type, attr);
+				break;
+			case SmcCmdGetKeyFromIndex:
+				host.getKeyFromIndex(index, key);
+				break;
+			default:
+				host.transact(tx.command, &tx.key, sizeof(tx.key), tx.size);
+				break;
+		}
+	}
+}
+
+/**
+ *  Add keys the log refers to and the keystore lacks
+ *
+ *  @param store  keystore
+ *  @param log    transactions
+ *  @param num    transaction count
+ */
+static void addMissingKeys(TestKeystore &store, const Transaction *log, size_t num) {
+	for (size_t i = 0; i < num; i++) {
+		auto &tx = log[i];
+		if (tx.result != SmcSuccess || tx.key == 0 || store.find(tx.key))
+			continue;
+		// Only value transactions tell the size, keys seen otherwise get a 4-byte value.
+		SMC_DATA_SIZE size = 4;
+		SMC_KEY_ATTRIBUTES attr = SMC_KEY_ATTRIBUTE_READ;
+		for (size_t j = i; j < num; j++) {
+			if (log[j].key != tx.key || log[j].result != SmcSuccess)
+				continue;
+			if (log[j].command == SmcCmdReadValue || log[j].command == SmcCmdWriteValue)
+				size = log[j].size;
+			if (log[j].command == SmcCmdWriteValue)
+				attr |= SMC_KEY_ATTRIBUTE_WRITE;
+		}
+		if (!store.add(tx.key, SmcKeyTypeCh8s, size, attr))
+			SYSLOG("replay", "cannot add key %08X", tx.key);
+	}
+}
+
+/**
+ *  Record a session resembling AppleSMC startup and monitoring through both protocols
+ *
+ *  @return recorded log (must be released)
+ */
+static OSData *recordSession() {
+	static constexpr SMC_KEY KeyTC0P = SMC_MAKE_IDENTIFIER('T','C','0','P');
+	static constexpr SMC_KEY KeyF0Ac = SMC_MAKE_IDENTIFIER('F','0','A','c');
+	static constexpr SMC_KEY KeyNATJ = SMC_MAKE_IDENTIFIER('N','A','T','J');
+	static constexpr SMC_KEY KeyHBKP = SMC_MAKE_IDENTIFIER('H','B','K','P');
+	static constexpr SMC_KEY KeyXXXX = SMC_MAKE_IDENTIFIER('X','X','X','X');
+
+	Device dev(SMCTransactionRecorder::MaxTransactions);
+	SMC_DATA buf[SMC_MAX_DATA_SIZE] {};
+	SMC_DATA_SIZE size;
+	SMC_KEY_TYPE type;
+	SMC_KEY_ATTRIBUTES attr;
+	SMC_KEY key;
+
+	for (int mmio = 0; mmio < 2; mmio++) {
+		auto walk = [&](auto &host) {
+			for (size_t i = 0; i <= dev.store.count(); i++) {
+				if (host.getKeyFromIndex(static_cast<SMC_KEY_INDEX>(i), key) != SmcSuccess)
+					continue;
+				host.getKeyInfo(key, size, type, attr);
+				if (attr & SMC_KEY_ATTRIBUTE_READ)
+					host.readKey(key, size, buf);
+			}
+			host.writeKey(KeyHBKP, buf, SMC_HBKP_SIZE);
+			for (int pass = 0; pass < 16; pass++) {
+				host.readKey(KeyTC0P, 2, buf);
+				host.readKey(KeyF0Ac, 2, buf);
+				buf[0] = static_cast<SMC_DATA>(pass);
+				host.writeKey(KeyNATJ, buf, 1);
+			}
+			host.readKey(KeyXXXX, 2, buf);
+			host.writeKey(KeyTC0P, buf, 2);
+			host.getKeyInfo(KeyXXXX, size, type, attr);
+		};
+		if (mmio)
+			walk(dev.mmioHost);
+		else
+			walk(dev.pmioHost);
+	}
+
+	return dev.recorder.createLog();
+}
+
+static const char *commandName(SMC_COMMAND cmd) {
+	switch (cmd) {
+		case SmcCmdReadValue:
+			return "read";
+		case SmcCmdWriteValue:
+			return "write";
+		case SmcCmdGetKeyInfo:
+			return "getKeyInfo";
+		case SmcCmdGetKeyFromIndex:
+			return "getKeyFromIndex";
+		default:
+			return "other";
+	}
+}
+
+int main(int argc, char *argv[]) {
+	size_t passes = 100;
+	const char *path = nullptr;
+	const char *savePath = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "-passes=", 8))
+			passes = strtoul(argv[i] + 8, nullptr, 0);
+		else if (!strncmp(argv[i], "-save=", 6))
+			savePath = argv[i] + 6;
+		else
+			path = argv[i];
+	}
+
+	// Obtain the log, either from a file or from a freshly recorded session.
+	Transaction *log = nullptr;
+	size_t num = 0;
+	if (path) {
+		auto f = fopen(path, "rb");
+		if (!f) {
+			fprintf(stderr, "cannot open %s\n", path);
+			return 1;
+		}
+		fseek(f, 0, SEEK_END);
+		auto len = static_cast<size_t>(ftell(f));
+		fseek(f, 0, SEEK_SET);
+		if (len % sizeof(Transaction) != 0)
+			fprintf(stderr, "%s: ignoring %zu trailing bytes\n", path, len % sizeof(Transaction));
+		num = len / sizeof(Transaction);
+		log = static_cast<Transaction *>(malloc(num * sizeof(Transaction) + 1));
+		CHECK_EQ(fread(log, sizeof(Transaction), num, f), num);
+		fclose(f);
+	} else {
+		auto data = recordSession();
+		num = data->getLength() / sizeof(Transaction);
+		log = static_cast<Transaction *>(malloc(num * sizeof(Transaction) + 1));
+		memcpy(log, data->getBytesNoCopy(), num * sizeof(Transaction));
+		data->release();
+		CHECK(num > 0);
+	}
+
+	if (savePath) {
+		auto f = fopen(savePath, "wb");
+		if (f) {
+			fwrite(log, sizeof(Transaction), num, f);
+			fclose(f);
+		}
+	}
+
+	// Replay once with recording and compare everything but the timestamps.
+	size_t mismatches = 0;
+	{
+		Device dev(static_cast<uint32_t>(num));
+		addMissingKeys(dev.store, log, num);
+		for (size_t i = 0; i < num; i++)
+			replay(dev, log[i]);
+
+		auto data = dev.recorder.createLog();
+		auto out = static_cast<const Transaction *>(data->getBytesNoCopy());
+		size_t outNum = data->getLength() / sizeof(Transaction);
+		CHECK_EQ(outNum, num);
+		for (size_t i = 0; i < num && i < outNum; i++) {
+			auto &a = log[i];
+			auto &b = out[i];
+			if (a.key != b.key || a.command != b.command || a.size != b.size || a.result != b.result || a.protocol != b.protocol) {
+				if (mismatches++ < 8)
+					fprintf(stderr, "record %zu: %s %08X size %u result %02X protocol %u replayed as %s %08X size %u result %02X protocol %u\n", i,
+							commandName(a.command), a.key, a.size, a.result, a.protocol, commandName(b.command), b.key, b.size, b.result, b.protocol);
+			}
+		}
+		data->release();
+	}
+
+	// Measure latency per protocol and command type without recording.
+	struct Stat {
+		uint64_t count;
+		uint64_t total;
+	} stats[2][SmcCmdGetKeyInfo + 2] {};
+
+	Device dev(1);
+	dev.pmio.setRecorder(nullptr);
+	dev.mmio.setRecorder(nullptr);
+	addMissingKeys(dev.store, log, num);
+	for (size_t pass = 0; pass < passes; pass++) {
+		for (size_t i = 0; i < num; i++) {
+			auto start = getCurrentTimeNs();
+			replay(dev, log[i]);
+			auto elapsed = getCurrentTimeNs() - start;
+			auto cmd = log[i].command;
+			auto &stat = stats[log[i].protocol != SMCTransactionRecorder::ProtocolPMIO][cmd >= SmcCmdReadValue && cmd <= SmcCmdGetKeyInfo ? cmd - SmcCmdReadValue : SmcCmdGetKeyInfo - SmcCmdReadValue + 1];
+			stat.count++;
+			stat.total += elapsed;
+		}
+	}
+
+	printf("%zu transactions, %zu replayed differently\n", num, mismatches);
+	printf("%-6s %-16s %10s %10s\n", "proto", "command", "count", "ns/tx");
+	for (int proto = 0; proto < 2; proto++) {
+		for (int cmd = 0; cmd <= SmcCmdGetKeyInfo - SmcCmdReadValue + 1; cmd++) {
+			auto &stat = stats[proto][cmd];
+			if (stat.count > 0)
+				printf("%-6s %-16s %10llu %10.1f\n", proto ? "mmio" : "pmio", commandName(static_cast<SMC_COMMAND>(SmcCmdReadValue + cmd)),
+					   static_cast<unsigned long long>(stat.count), static_cast<double>(stat.total) / stat.count);
+		}
+	}
+
+	// Self-recorded sessions must replay identically.
+	if (!path)
+		CHECK_EQ(mismatches, 0);
+
+	free(log);
+	return testResult("replay_log");
+}
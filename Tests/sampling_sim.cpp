@@ -0,0 +1,137 @@
+//
+//  sampling_sim.cpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Simulates the sensor polling of a laptop with all the sensor plugins loaded on a simulated
+//  clock and reports the timer wakeups per second. Before: every plugin polls on its own timer
+//  or thread, so every deadline is a wakeup of its own. After: the same polls are registered
+//  with VirtualSMCTimerService as sampling tasks with jitter tolerance, so that due tasks
+//  are batched into shared wakeups. Poll phases are random, as plugins start at different times.
+//  Only the SMCProcessor counters and SMCLightSensor are sampling tasks in the tree, the other
+//  polls project the same migration.
+//
+//  Usage: sampling_sim [simulated seconds]
+//
+
+#include "kern_timer.hpp"
+#include "test_util.hpp"
+
+/**
+ *  Simulated time origin, the shim clock must stay non-zero
+ */
+static constexpr uint64_t StartNs {1000 * NSEC_PER_SEC};
+
+/**
+ *  Simulated CPU count
+ */
+static constexpr int32_t Cpus {8};
+
+/**
+ *  Polling source of a plugin
+ */
+struct Poll {
+	const char *name;    // Plugin and poll name
+	uint32_t periodMs;   // Polling period
+	uint32_t jitterMs;   // Tolerated deviation when using the service
+	uint32_t costUs;     // Expected poll duration
+	bool perCpu;         // One poll bound to every CPU
+};
+
+/**
+ *  Polls in the plugins, SMCBatteryManager at its quick poll interval, jitter is a tenth of the period
+ */
+static constexpr Poll polls[] {
+	{"SMCProcessor counters",  500,  50,  20, true},
+	{"SMCProcessor publish",   500,  50,  10, false},
+	{"SMCSuperIO",             500,  50, 200, false},
+	{"SMCBatteryManager",     1000, 100, 300, false},
+	{"SMCLightSensor",        1000, 100, 500, false},
+	{"SMCDellSensors",         100,  10,  50, false},
+};
+
+static OSObject owner;
+
+static void poll(void *) {}
+
+/**
+ *  Run the polls for the simulated duration
+ *
+ *  @param seconds   simulated duration
+ *  @param batching  use the jitter tolerance of the polls
+ *  @param wakeups   timer wakeups
+ *  @param polled    poll invocations
+ */
+static void simulate(uint64_t seconds, bool batching, uint64_t &wakeups, uint64_t &polled) {
+	VirtualSMCTimerService service;
+	testClockNs = StartNs;
+	CHECK(service.init(&owner));
+
+	// Register the polls at random phases in the order of their start times.
+	struct Start {
+		const Poll *poll;
+		int32_t cpu;
+		uint64_t phase;
+	};
+
+	Start starts[arrsize(polls) * Cpus] {};
+	size_t startNum = 0;
+	TestRandom rng(1);
+	for (auto &p : polls) {
+		for (int32_t cpu = 0; cpu < (p.perCpu ? Cpus : 1); cpu++)
+			starts[startNum++] = {&p, p.perCpu ? cpu : VirtualSMCAPI::AnyCpu, rng.below(p.periodMs * 1000) * NSEC_PER_USEC};
+	}
+
+	qsort(starts, startNum, sizeof(Start), [](const void *a, const void *b) {
+		auto pa = static_cast<const Start *>(a)->phase, pb = static_cast<const Start *>(b)->phase;
+		return pa < pb ? -1 : pa > pb;
+	});
+
+	for (size_t i = 0; i < startNum; i++) {
+		testClockNs = StartNs + starts[i].phase;
+		VirtualSMCAPI::SamplingTask task;
+		task.action = poll;
+		task.periodMs = starts[i].poll->periodMs;
+		task.jitterMs = batching ? starts[i].poll->jitterMs : 0;
+		task.costUs = starts[i].poll->costUs;
+		task.cpu = starts[i].cpu;
+		CHECK(service.add(task) != 0);
+	}
+
+	// Every poll has started within the first second, measure from then on.
+	testClockNs = StartNs + NSEC_PER_SEC;
+	auto baseWakeups = service.getWakeups();
+	auto baseInvocations = service.getInvocations();
+	uint64_t end = StartNs + (seconds + 1) * NSEC_PER_SEC;
+	while (testTimerSource->armed && testTimerSource->deadline < end) {
+		testClockNs = testTimerSource->deadline;
+		testTimerSource->expire();
+	}
+
+	wakeups = service.getWakeups() - baseWakeups;
+	polled = service.getInvocations() - baseInvocations;
+	service.deinit();
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t seconds = argc > 1 ? strtoull(argv[1], nullptr, 0) : 60;
+	if (seconds == 0)
+		seconds = 1;
+
+	uint64_t wakeups[2], polled[2];
+	simulate(seconds, false, wakeups[0], polled[0]);
+	simulate(seconds, true, wakeups[1], polled[1]);
+
+	printf("%u cpus, %zu polls, %llu s simulated\n", Cpus, arrsize(polls), static_cast<unsigned long long>(seconds));
+	printf("%-24s %12s %12s\n", "model", "wakeups/s", "polls/s");
+	const char *names[] {"separate timers", "sampling tasks"};
+	for (size_t i = 0; i < 2; i++)
+		printf("%-24s %12.1f %12.1f\n", names[i], static_cast<double>(wakeups[i]) / seconds, static_cast<double>(polled[i]) / seconds);
+
+	// Batching must save wakeups without losing polls, early polls may only shift a few across the end.
+	CHECK(wakeups[1] < wakeups[0]);
+	CHECK(polled[1] * 100 >= polled[0] * 99);
+
+	return testResult("sampling_sim");
+}
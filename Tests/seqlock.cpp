@@ -0,0 +1,180 @@
+//
+//  seqlock.cpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Deterministic checks of the sequence lock (kern_seqlock.hpp) behind SMCInterruptQueue data
+//  and throttled keystore reads. Interleavings are produced by running a write in the middle of a
+//  copy and a copy in the middle of a write, so torn copies are detected even on a single core,
+//  where the intr_queue stress test rarely interleaves them.
+//
+//  Usage: seqlock
+//
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "kern_intrs.hpp"
+#include "test_util.hpp"
+
+static constexpr size_t DataSize {32};
+
+/**
+ *  Protected data, every byte holds the same generation
+ */
+struct Protected {
+	_Atomic(uint32_t) seq {0};
+	uint8_t data[DataSize] {};
+};
+
+static void fill(uint8_t *data, uint8_t generation) {
+	memset(data, generation, DataSize);
+}
+
+static bool consistent(const uint8_t *data) {
+	for (size_t i = 1; i < DataSize; i++) {
+		if (data[i] != data[0])
+			return false;
+	}
+	return true;
+}
+
+/**
+ *  Plain updates and copies, the counter stays even between writes
+ */
+static void testSequential() {
+	Protected p;
+	uint8_t copy[DataSize];
+	for (uint8_t g = 1; g <= 3; g++) {
+		SeqLock::write(p.seq, [&p, g]() { fill(p.data, g); });
+		CHECK_EQ(atomic_load(&p.seq), g * 2);
+		CHECK(SeqLock::read(p.seq, [&p, &copy]() { memcpy(copy, p.data, DataSize); }, 1));
+		CHECK(consistent(copy));
+		CHECK_EQ(copy[0], g);
+	}
+}
+
+/**
+ *  A copy overlapping a write is discarded and made again
+ */
+static void testTornCopy() {
+	Protected p;
+	SeqLock::write(p.seq, [&p]() { fill(p.data, 1); });
+
+	uint8_t copy[DataSize];
+	uint8_t generation = 1;
+	size_t copies = 0;
+	auto reader = [&]() {
+		// The first copy is torn by a write finishing in its middle.
+		memcpy(copy, p.data, DataSize / 2);
+		if (copies++ == 0)
+			SeqLock::write(p.seq, [&p, &generation]() { fill(p.data, ++generation); });
+		memcpy(copy + DataSize / 2, p.data + DataSize / 2, DataSize / 2);
+	};
+
+	CHECK(SeqLock::read(p.seq, reader));
+	CHECK_EQ(copies, 2);
+	CHECK(consistent(copy));
+	CHECK_EQ(copy[0], 2);
+
+	// A bounded read reports the torn copy instead.
+	copies = 0;
+	CHECK(!SeqLock::read(p.seq, reader, 1));
+	CHECK_EQ(copies, 1);
+	CHECK(!consistent(copy));
+	CHECK_EQ(copy[0], 2);
+	CHECK_EQ(copy[DataSize - 1], 3);
+}
+
+/**
+ *  Data being written is never copied, bounded reads give up
+ */
+static void testCopyDuringWrite() {
+	Protected p;
+	uint8_t copy[DataSize] {};
+	size_t copies = 0;
+	bool read = true;
+	SeqLock::write(p.seq, [&]() {
+		fill(p.data, 1);
+		read = SeqLock::read(p.seq, [&]() { memcpy(copy, p.data, DataSize); copies++; }, 4);
+	});
+	CHECK(!read);
+	CHECK_EQ(copies, 0);
+	CHECK_EQ(atomic_load(&p.seq), 2);
+}
+
+/**
+ *  Writers wait for each other
+ */
+static void testWriters() {
+	Protected p;
+	std::atomic<bool> started {false};
+	std::atomic<bool> second {false};
+	std::thread other;
+	SeqLock::write(p.seq, [&]() {
+		other = std::thread([&]() {
+			started = true;
+			SeqLock::write(p.seq, [&]() { second = true; fill(p.data, 2); });
+		});
+		while (!started)
+			std::this_thread::yield();
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		CHECK(!second);
+		fill(p.data, 1);
+	});
+	other.join();
+	CHECK(second);
+	CHECK_EQ(p.data[0], 2);
+	CHECK_EQ(atomic_load(&p.seq), 4);
+}
+
+/**
+ *  Optional writes give up instead of waiting for another writer
+ */
+static void testTryWrite() {
+	Protected p;
+	CHECK(SeqLock::tryWrite(p.seq, [&p]() { fill(p.data, 1); }));
+	CHECK_EQ(atomic_load(&p.seq), 2);
+
+	bool nested = true;
+	SeqLock::write(p.seq, [&]() {
+		fill(p.data, 2);
+		nested = SeqLock::tryWrite(p.seq, [&p]() { fill(p.data, 3); });
+	});
+	CHECK(!nested);
+	CHECK_EQ(p.data[0], 2);
+	CHECK_EQ(atomic_load(&p.seq), 4);
+}
+
+/**
+ *  Interrupt queue data goes through the sequence lock
+ */
+static void testInterruptData() {
+	SMCInterruptQueue queue;
+	CHECK(queue.init());
+
+	uint8_t data[SMC_MAX_LOG_SIZE];
+	fill(data, 7);
+	queue.store(1, data, 5);
+	CHECK_EQ(atomic_load(&queue.at(1).seq), 2);
+	memset(data, 0, sizeof(data));
+	CHECK_EQ(queue.load(1, data), 5);
+	CHECK_EQ(data[0], 7);
+	CHECK_EQ(data[4], 7);
+	CHECK_EQ(data[5], 0);
+	CHECK_EQ(queue.load(2, data), 0);
+
+	queue.deinit();
+}
+
+int main() {
+	testSequential();
+	testTornCopy();
+	testCopyDuringWrite();
+	testWriters();
+	testTryWrite();
+	testInterruptData();
+	return testResult("seqlock");
+}
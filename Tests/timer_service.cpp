@@ -0,0 +1,327 @@
+//
+//  timer_service.cpp
+//  VirtualSMC Tests
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+//  Drives VirtualSMCTimerService with a simulated clock: the timer event source shim records
+//  the armed deadline, and the test moves the clock there and expires it. Checks that the
+//  earliest deadline including its leeway is armed, that nearby deadlines share a wakeup,
+//  that sampling tasks join early within the cost limit, that removal works with stale
+//  handles, that CPU affine tasks run bound, that they cannot add or remove timers, and that
+//  their worker threads exit when no longer needed.
+//
+//  Usage: timer_service
+//
+
+#include <chrono>
+#include <thread>
+
+#include "kern_timer.hpp"
+#include "test_util.hpp"
+
+extern "C" {
+#include <i386/pmCPU.h>
+}
+
+/**
+ *  Simulated time origin, the shim clock must stay non-zero
+ */
+static constexpr uint64_t StartNs {1000 * NSEC_PER_SEC};
+
+static OSObject owner;
+
+static void advanceTo(uint64_t ms) {
+	testClockNs = StartNs + ms * NSEC_PER_MSEC;
+}
+
+/**
+ *  @return armed timer deadline in milliseconds since start or UINT64_MAX
+ */
+static uint64_t armedAt() {
+	if (!testTimerSource->armed)
+		return UINT64_MAX;
+	return (testTimerSource->deadline - StartNs) / NSEC_PER_MSEC;
+}
+
+/**
+ *  Move the clock to the armed deadline and fire the timer
+ *
+ *  @return fire time in milliseconds since start
+ */
+static uint64_t expireArmed() {
+	auto at = armedAt();
+	CHECK(at != UINT64_MAX);
+	if (at == UINT64_MAX)
+		return at;
+	advanceTo(at);
+	CHECK(testTimerSource->expire());
+	return at;
+}
+
+static void countInvocation(void *context) {
+	(*static_cast<size_t *>(context))++;
+}
+
+static void initService(VirtualSMCTimerService &service) {
+	advanceTo(0);
+	CHECK(service.init(&owner));
+	CHECK_EQ(armedAt(), UINT64_MAX);
+}
+
+/**
+ *  Leeway lets a deadline wait for a later one, deadlines already passed fire in the same wakeup
+ */
+static void testCoalescing() {
+	VirtualSMCTimerService service;
+	initService(service);
+
+	size_t periodic = 0, oneShot = 0, late = 0;
+	CHECK(service.add(countInvocation, &periodic, 100, true, 20) != 0);
+	CHECK(service.add(countInvocation, &oneShot, 110, false, 0) != 0);
+	CHECK(service.add(countInvocation, &late, 300, false, 0) != 0);
+	CHECK_EQ(armedAt(), 110);
+
+	// The expired timer event source does not fire the timers early.
+	advanceTo(50);
+	CHECK(!testTimerSource->expire());
+	CHECK_EQ(service.getWakeups(), 0);
+
+	CHECK_EQ(expireArmed(), 110);
+	CHECK_EQ(periodic, 1);
+	CHECK_EQ(oneShot, 1);
+	CHECK_EQ(service.getWakeups(), 1);
+	CHECK_EQ(service.getInvocations(), 2);
+
+	// Periodic deadlines keep their phase, so the next one is 200 plus leeway.
+	CHECK_EQ(armedAt(), 220);
+	CHECK_EQ(expireArmed(), 220);
+	// The timer at 300 fires the periodic one due then as well.
+	CHECK_EQ(expireArmed(), 300);
+	CHECK_EQ(periodic, 3);
+	CHECK_EQ(late, 1);
+	CHECK_EQ(oneShot, 1);
+	CHECK_EQ(service.getWakeups(), 3);
+	CHECK_EQ(armedAt(), 420);
+
+	service.deinit();
+}
+
+/**
+ *  Sampling tasks close to the wakeup join it unless the batch becomes too expensive
+ */
+static void testSampling() {
+	VirtualSMCTimerService service;
+	initService(service);
+
+	size_t counts[3] {};
+	VirtualSMCAPI::SamplingTask task;
+	task.action = countInvocation;
+	task.jitterMs = 10;
+	task.costUs = 600;
+
+	task.context = &counts[0];
+	task.periodMs = 100;
+	CHECK(service.add(task) != 0);
+	task.context = &counts[1];
+	task.periodMs = 115;
+	CHECK(service.add(task) != 0);
+
+	// Invalid descriptions are refused.
+	task.jitterMs = task.periodMs;
+	CHECK_EQ(service.add(task), 0);
+	task.jitterMs = 10;
+	task.cpu = static_cast<int32_t>(CPUInfo::MaxCpus);
+	CHECK_EQ(service.add(task), 0);
+	task.cpu = VirtualSMCAPI::AnyCpu;
+
+	// 115 is within the jitter of the wakeup at 110, but 1200 us exceed the batch cost limit.
+	CHECK_EQ(armedAt(), 110);
+	CHECK_EQ(expireArmed(), 110);
+	CHECK_EQ(counts[0], 1);
+	CHECK_EQ(counts[1], 0);
+	CHECK_EQ(expireArmed(), 125);
+	CHECK_EQ(counts[1], 1);
+	CHECK_EQ(service.getEarlyInvocations(), 0);
+
+	// A cheap task is pulled in ahead of its deadline.
+	task.context = &counts[2];
+	task.periodMs = 95;
+	task.costUs = 100;
+	CHECK(service.add(task) != 0);
+	// First task due at 200, second at 230, third at 220: the third joins the wakeup at 210 early.
+	CHECK_EQ(armedAt(), 210);
+	CHECK_EQ(expireArmed(), 210);
+	CHECK_EQ(counts[0], 2);
+	CHECK_EQ(counts[1], 1);
+	CHECK_EQ(counts[2], 1);
+	CHECK_EQ(service.getEarlyInvocations(), 1);
+	CHECK_EQ(service.getEstimatedCost(), 600 * 3 + 100);
+
+	service.deinit();
+}
+
+/**
+ *  Removed timers never fire, and stale handles do not remove reused slots
+ */
+static void testRemove() {
+	VirtualSMCTimerService service;
+	initService(service);
+
+	size_t first = 0, second = 0;
+	auto handle = service.add(countInvocation, &first, 100, true, 0);
+	CHECK(handle != 0);
+	CHECK_EQ(armedAt(), 100);
+	service.remove(handle);
+	CHECK_EQ(armedAt(), UINT64_MAX);
+
+	// The slot is reused with another generation.
+	auto reused = service.add(countInvocation, &second, 50, false, 0);
+	CHECK(reused != 0);
+	CHECK(reused != handle);
+	service.remove(handle);
+	CHECK_EQ(armedAt(), 50);
+	CHECK_EQ(expireArmed(), 50);
+	CHECK_EQ(first, 0);
+	CHECK_EQ(second, 1);
+
+	// One-shot timers free their slot, removing them afterwards is harmless.
+	CHECK_EQ(armedAt(), UINT64_MAX);
+	service.remove(reused);
+	CHECK_EQ(armedAt(), UINT64_MAX);
+
+	size_t handles = 0;
+	for (size_t i = 0; i < VirtualSMCTimerService::MaxTimers; i++) {
+		if (service.add(countInvocation, &second, 1000, true, 0) != 0)
+			handles++;
+	}
+	CHECK_EQ(handles, VirtualSMCTimerService::MaxTimers);
+	CHECK_EQ(service.add(countInvocation, &second, 1000, true, 0), 0);
+
+	service.deinit();
+}
+
+/**
+ *  Wait for stopped CPU workers to return
+ *
+ *  @param count  expected amount of running workers
+ *
+ *  @return true if the amount is reached within a second
+ */
+static bool waitRunningThreads(size_t count) {
+	for (size_t i = 0; i < 1000 && testRunningThreads != count; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	return testRunningThreads == count;
+}
+
+/**
+ *  Actions of CPU affine tasks run on a worker bound to the CPU before the wakeup completes
+ */
+static void testCpuWorker() {
+	VirtualSMCTimerService service;
+	initService(service);
+
+	struct Sample {
+		size_t count;
+		int cpu;
+	};
+
+	Sample samples[2] {{0, -1}, {0, -1}};
+	VirtualSMCAPI::SamplingTask task;
+	task.action = [](void *context) {
+		auto sample = static_cast<Sample *>(context);
+		sample->count++;
+		sample->cpu = testBoundCpu;
+	};
+	task.periodMs = 100;
+	task.jitterMs = 5;
+	task.cpu = 2;
+	task.context = &samples[0];
+	auto handle = service.add(task);
+	CHECK(handle != 0);
+	task.cpu = 3;
+	task.context = &samples[1];
+	CHECK(service.add(task) != 0);
+	CHECK_EQ(testRunningThreads, 2);
+
+	for (size_t i = 0; i < 3; i++)
+		expireArmed();
+
+	for (auto &sample : samples)
+		CHECK_EQ(sample.count, 3);
+	CHECK_EQ(samples[0].cpu, 2);
+	CHECK_EQ(samples[1].cpu, 3);
+	CHECK_EQ(testBoundCpu, -1);
+	CHECK_EQ(service.getWakeups(), 3);
+
+	// The worker exits with the last task of its CPU, and the rest with the service.
+	service.remove(handle);
+	CHECK(waitRunningThreads(1));
+	expireArmed();
+	CHECK_EQ(samples[0].count, 3);
+	CHECK_EQ(samples[1].count, 4);
+	service.deinit();
+	CHECK(waitRunningThreads(0));
+
+	// Workers start again for new tasks.
+	initService(service);
+	CHECK(service.add(task) != 0);
+	CHECK_EQ(testRunningThreads, 1);
+	expireArmed();
+	CHECK_EQ(samples[1].count, 5);
+	service.deinit();
+	CHECK(waitRunningThreads(0));
+}
+
+/**
+ *  CPU affine actions run while the wakeup holds the work loop gate, so adding and removing timers fails
+ */
+static void testWorkerRegistration() {
+	VirtualSMCTimerService service;
+	initService(service);
+
+	struct Nested {
+		VirtualSMCTimerService *service;
+		uint32_t handle;
+		uint32_t added;
+		size_t count;
+	};
+
+	Nested nested {&service, 0, 1, 0};
+	VirtualSMCAPI::SamplingTask task;
+	task.action = [](void *context) {
+		auto nested = static_cast<Nested *>(context);
+		nested->added = nested->service->add(countInvocation, &nested->count, 10, false, 0);
+		nested->service->remove(nested->handle);
+		nested->count++;
+	};
+	task.periodMs = 100;
+	task.cpu = 1;
+	task.context = &nested;
+	nested.handle = service.add(task);
+	CHECK(nested.handle != 0);
+
+	CHECK_EQ(expireArmed(), 100);
+	CHECK_EQ(nested.count, 1);
+	CHECK_EQ(nested.added, 0);
+	CHECK_EQ(expireArmed(), 200);
+	CHECK_EQ(nested.count, 2);
+
+	// The same calls work from the work loop.
+	nested.added = service.add(countInvocation, &nested.count, 10, false, 0);
+	CHECK(nested.added != 0);
+	service.remove(nested.handle);
+	CHECK(waitRunningThreads(0));
+	CHECK_EQ(expireArmed(), 210);
+	CHECK_EQ(nested.count, 3);
+	service.deinit();
+}
+
+int main() {
+	testCoalescing();
+	testSampling();
+	testRemove();
+	testCpuWorker();
+	testWorkerRegistration();
+	return testResult("timer_service");
+}
@@ -0,0 +1,26 @@
+//
+//  kern_histogram.cpp
+//  VirtualSMC
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#include <libkern/c++/OSNumber.h>
+
+#include "kern_histogram.hpp"
+
+OSArray *Log2Histogram::createArray() {
+	auto array = OSArray::withCapacity(Size);
+	if (!array)
+		return nullptr;
+
+	for (size_t i = 0; i < Size; i++) {
+		auto num = OSNumber::withNumber(atomic_load_explicit(&buckets[i], memory_order_relaxed), 64);
+		if (num) {
+			array->setObject(num);
+			num->release();
+		}
+	}
+
+	return array;
+}
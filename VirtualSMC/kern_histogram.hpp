@@ -0,0 +1,61 @@
+//
+//  kern_histogram.hpp
+//  VirtualSMC
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_histogram_hpp
+#define kern_histogram_hpp
+
+#include <libkern/c++/OSArray.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ *  Latency histogram with log2 buckets, safe to update concurrently.
+ *  Bucket N counts latencies in [2^N, 2^(N+1)) nanoseconds, the last one includes everything above.
+ */
+class Log2Histogram {
+public:
+	/**
+	 *  Amount of buckets
+	 */
+	static constexpr size_t Size {32};
+
+	/**
+	 *  Account a latency
+	 *
+	 *  @param latency  latency in nanoseconds
+	 */
+	void account(uint64_t latency) {
+		size_t bucket = latency > 0 ? 63 - __builtin_clzll(latency) : 0;
+		if (bucket >= Size)
+			bucket = Size - 1;
+		atomic_fetch_add_explicit(&buckets[bucket], 1, memory_order_relaxed);
+	}
+
+	/**
+	 *  Clear all the buckets
+	 */
+	void reset() {
+		for (auto &bucket : buckets)
+			atomic_store_explicit(&bucket, 0, memory_order_relaxed);
+	}
+
+	/**
+	 *  Create registry representation with a number per bucket
+	 *
+	 *  @return histogram array or nullptr
+	 */
+	OSArray *createArray();
+
+private:
+	/**
+	 *  Bucket counters
+	 */
+	_Atomic(uint64_t) buckets[Size] {};
+};
+
+#endif /* kern_histogram_hpp */
@@ -9,9 +9,13 @@
 #define kern_intrs_hpp
 
 #include <Headers/kern_util.hpp>
+#include <IOKit/IOInterrupts.h>
+#include <stdatomic.h>
 
 #include <VirtualSMCSDK/AppleSmcBridge.hpp>
 
+#include "kern_seqlock.hpp"
+
 struct RegisteredInterrupt {
 	/**
 	 *  Interrupt source (vector)
@@ -41,9 +45,19 @@ struct RegisteredInterrupt {
 
 struct StoredInterrupt {
 	/**
-	 *  SMC event code
+	 *  Data sequence counter, odd while the data is being updated
+	 */
+	_Atomic(uint32_t) seq {0};
+
+	/**
+	 *  Time the event became pending in nanoseconds (set by the pending bit owner)
 	 */
-	SMC_EVENT_CODE code {};
+	uint64_t postTime {};
+
+	/**
+	 *  Time the event was queued for delivery in nanoseconds (set by the pending bit owner)
+	 */
+	uint64_t queueTime {};
 
 	/**
 	 *  SMC interrupt data size
@@ -56,4 +70,184 @@ struct StoredInterrupt {
 	uint8_t data[SMC_MAX_LOG_SIZE] {};
 };
 
+/**
+ *  Pending interrupt queue holding the latest data of every event code.
+ *  Any number of producers may post concurrently, but there must be exactly one consumer
+ *  at a time. Each code is queued at most once while its pending bit is set, so the ring
+ *  never overflows. Producers must not be preempted between claiming a ring slot and
+ *  publishing it or while updating the data, as the consumer spins on both.
+ */
+class SMCInterruptQueue {
+public:
+	/**
+	 *  Ring size, one slot for every event code
+	 */
+	static constexpr size_t Size {256};
+	static_assert(Size > UINT8_MAX && (Size & (Size - 1)) == 0,
+				  "Interrupt ring must fit every event code and be a power of two");
+
+	/**
+	 *  Allocate the data table, interrupts may be posted during hibernation, where we cannot allocate.
+	 *
+	 *  @return true on success
+	 */
+	bool init() {
+		stored = Buffer::create<StoredInterrupt>(Size);
+		if (!stored)
+			return false;
+		lilu_os_memset(stored, 0, sizeof(StoredInterrupt) * Size);
+		return true;
+	}
+
+	/**
+	 *  Release the data table
+	 */
+	void deinit() {
+		if (stored) {
+			Buffer::deleter(stored);
+			stored = nullptr;
+		}
+	}
+
+	/**
+	 *  Obtain stored data of an event code, the timestamps belong to the pending bit owner
+	 *
+	 *  @param code  event code
+	 *
+	 *  @return stored interrupt
+	 */
+	StoredInterrupt &at(SMC_EVENT_CODE code) {
+		return stored[code];
+	}
+
+	/**
+	 *  Replace the latest data of an event code, concurrent updates of the same code are serialised.
+	 *  Call with interrupts disabled, an interrupted update would block updates from the interrupt.
+	 *
+	 *  @param code  event code
+	 *  @param data  event data
+	 *  @param size  event data size, up to SMC_MAX_LOG_SIZE
+	 */
+	void store(SMC_EVENT_CODE code, const void *data, uint32_t size) {
+		auto &si = stored[code];
+		SeqLock::write(si.seq, [&si, data, size]() {
+			si.size = size;
+			if (size > 0)
+				lilu_os_memcpy(si.data, data, size);
+		});
+	}
+
+	/**
+	 *  Copy the latest data of an event code
+	 *
+	 *  @param code  event code
+	 *  @param data  buffer of SMC_MAX_LOG_SIZE bytes
+	 *
+	 *  @return data size
+	 */
+	uint32_t load(SMC_EVENT_CODE code, void *data) {
+		auto &si = stored[code];
+		uint32_t size = 0;
+		SeqLock::read(si.seq, [&si, data, &size]() {
+			size = si.size;
+			if (size > 0)
+				lilu_os_memcpy(data, si.data, size);
+		});
+		return size;
+	}
+
+	/**
+	 *  Mark an event code pending
+	 *
+	 *  @param code  event code
+	 *
+	 *  @return true if the code was not pending, the caller then owns the pending bit and must push the code
+	 */
+	bool setPending(SMC_EVENT_CODE code) {
+		uint64_t bit = 1ULL << (code % 64);
+		return !(atomic_fetch_or_explicit(&pending[code / 64], bit, memory_order_acq_rel) & bit);
+	}
+
+	/**
+	 *  Queue an event code, must only be called by the owner of its pending bit
+	 *
+	 *  @param code  event code
+	 *
+	 *  @return true if the queue was empty, and an interrupt needs to be caused
+	 */
+	bool push(SMC_EVENT_CODE code) {
+		auto index = atomic_fetch_add_explicit(&tail, 1, memory_order_relaxed);
+		atomic_store_explicit(&ring[index & (Size - 1)], code, memory_order_release);
+		return atomic_fetch_add_explicit(&queued, 1, memory_order_acq_rel) == 0;
+	}
+
+	/**
+	 *  Take the oldest queued event code and clear its pending bit, must only be called by the consumer.
+	 *  Posts arriving after this point queue the code again, call complete once the data is read.
+	 *
+	 *  @param postTime   first post time of the code
+	 *  @param queueTime  ring insertion time of the code
+	 *
+	 *  @return event code or 0 when nothing is queued
+	 */
+	SMC_EVENT_CODE pop(uint64_t &postTime, uint64_t &queueTime) {
+		if (atomic_load_explicit(&tail, memory_order_acquire) == head)
+			return 0;
+
+		// The slot is claimed, wait for the producer to publish the code (it cannot be preempted meanwhile).
+		auto &slot = ring[head & (Size - 1)];
+		SMC_EVENT_CODE code;
+		while ((code = atomic_load_explicit(&slot, memory_order_acquire)) == 0)
+			;
+		atomic_store_explicit(&slot, 0, memory_order_relaxed);
+		head++;
+
+		// Timestamps belong to the pending bit owner, obtain them before clearing it.
+		postTime = stored[code].postTime;
+		queueTime = stored[code].queueTime;
+		atomic_fetch_and_explicit(&pending[code / 64], ~(1ULL << (code % 64)), memory_order_acq_rel);
+		return code;
+	}
+
+	/**
+	 *  Finish the delivery of a popped event code, must only be called by the consumer
+	 *
+	 *  @return true if more codes are queued, and another interrupt needs to be caused
+	 */
+	bool complete() {
+		return atomic_fetch_sub_explicit(&queued, 1, memory_order_acq_rel) > 1;
+	}
+
+private:
+	/**
+	 *  Latest interrupt data indexed by event code, allocated by init
+	 */
+	StoredInterrupt *stored {nullptr};
+
+	/**
+	 *  Bitmap of event codes currently queued for delivery (or held back by the caller)
+	 */
+	_Atomic(uint64_t) pending[Size / 64] {};
+
+	/**
+	 *  Event code ring, 0 marks an empty slot
+	 */
+	_Atomic(SMC_EVENT_CODE) ring[Size] {};
+
+	/**
+	 *  Next ring slot to be claimed by push
+	 */
+	_Atomic(size_t) tail {0};
+
+	/**
+	 *  Next ring slot to be consumed by pop
+	 */
+	size_t head {0};
+
+	/**
+	 *  Amount of queued event codes, may temporarily go negative when a code is consumed before being accounted
+	 */
+	_Atomic(int32_t) queued {0};
+};
+
 #endif /* kern_intrs_hpp */
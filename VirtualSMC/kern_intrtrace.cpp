@@ -0,0 +1,114 @@
+//
+//  kern_intrtrace.cpp
+//  VirtualSMC
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#include <libkern/c++/OSArray.h>
+#include <libkern/c++/OSData.h>
+#include <libkern/c++/OSNumber.h>
+
+#include "kern_intrtrace.hpp"
+
+static_assert(sizeof(SMCInterruptTracer::Trace) == 24, "Unexpected trace entry size");
+
+void SMCInterruptTracer::recordDelivery(SMC_EVENT_CODE code, uint64_t post, uint64_t queue, uint64_t consume) {
+	// The interrupt is caused either at queueing or by the previous delivery, whatever happened later.
+	uint64_t cause = atomic_load_explicit(&lastCause, memory_order_relaxed);
+	if (cause < queue)
+		cause = queue;
+	if (cause > consume)
+		cause = consume;
+
+	auto entry = &histograms[MaxTrackedCodes];
+	for (size_t i = 0; i < MaxTrackedCodes; i++) {
+		uint32_t entryCode = atomic_load_explicit(&histograms[i].code, memory_order_relaxed);
+		// Claim a free entry, if another caller claims it first, its code is compared instead.
+		if (entryCode == 0 && atomic_compare_exchange_strong_explicit(&histograms[i].code, &entryCode, code, memory_order_relaxed, memory_order_relaxed))
+			entryCode = code;
+		if (entryCode == code) {
+			entry = &histograms[i];
+			break;
+		}
+	}
+
+	entry->postToConsume.account(consume - post);
+	entry->causeToConsume.account(consume - cause);
+
+	auto saturate = [](uint64_t delay) {
+		return static_cast<uint32_t>(delay > UINT32_MAX ? UINT32_MAX : delay);
+	};
+
+	// Every caller gets its own slot, an entry still being written may be exported (best effort).
+	auto index = atomic_fetch_add_explicit(&traced, 1, memory_order_relaxed);
+	auto &trace = traces[index % TraceSize];
+	trace.postTime = post;
+	trace.queueDelay = saturate(queue - post);
+	trace.causeDelay = saturate(cause - post);
+	trace.consumeDelay = saturate(consume - post);
+	trace.code = code;
+}
+
+OSDictionary *SMCInterruptTracer::createStatistics() {
+	auto dict = OSDictionary::withCapacity(3);
+	auto latency = OSDictionary::withCapacity(MaxTrackedCodes + 1);
+	if (!dict || !latency) {
+		OSSafeReleaseNULL(dict);
+		OSSafeReleaseNULL(latency);
+		return nullptr;
+	}
+
+	for (size_t i = 0; i <= MaxTrackedCodes; i++) {
+		auto &entry = histograms[i];
+		auto code = atomic_load_explicit(&entry.code, memory_order_relaxed);
+		if (i < MaxTrackedCodes && code == 0)
+			break;
+
+		auto codeDict = OSDictionary::withCapacity(2);
+		if (!codeDict)
+			continue;
+
+		auto histogram = entry.postToConsume.createArray();
+		if (histogram) {
+			codeDict->setObject("PostToConsumeLog2Ns", histogram);
+			histogram->release();
+		}
+
+		histogram = entry.causeToConsume.createArray();
+		if (histogram) {
+			codeDict->setObject("CauseToConsumeLog2Ns", histogram);
+			histogram->release();
+		}
+
+		char name[8];
+		if (i < MaxTrackedCodes)
+			snprintf(name, sizeof(name), "0x%02X", code);
+		else
+			strlcpy(name, "Other", sizeof(name));
+		latency->setObject(name, codeDict);
+		codeDict->release();
+	}
+
+	dict->setObject("Latency", latency);
+	latency->release();
+
+	// Export the trace ring in chronological order.
+	auto total = atomic_load_explicit(&traced, memory_order_acquire);
+	auto count = total < TraceSize ? total : TraceSize;
+	auto trace = OSData::withCapacity(static_cast<uint32_t>(count * sizeof(Trace)));
+	if (trace) {
+		for (uint64_t i = total - count; i < total; i++)
+			trace->appendBytes(&traces[i % TraceSize], sizeof(Trace));
+		dict->setObject("Trace", trace);
+		trace->release();
+	}
+
+	auto num = OSNumber::withNumber(total, 64);
+	if (num) {
+		dict->setObject("Traced", num);
+		num->release();
+	}
+
+	return dict;
+}
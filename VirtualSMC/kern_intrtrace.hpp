@@ -0,0 +1,100 @@
+//
+//  kern_intrtrace.hpp
+//  VirtualSMC
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_intrtrace_hpp
+#define kern_intrtrace_hpp
+
+#include <Headers/kern_util.hpp>
+#include <libkern/c++/OSDictionary.h>
+#include <VirtualSMCSDK/AppleSmcBridge.hpp>
+#include <stdatomic.h>
+
+#include "kern_histogram.hpp"
+
+class SMCInterruptTracer {
+public:
+	/**
+	 *  Traced interrupt delivery as exported to the registry
+	 *  All delays are relative to the post time and saturate at UINT32_MAX.
+	 */
+	struct PACKED Trace {
+		uint64_t postTime;      // First post time in nanoseconds
+		uint32_t queueDelay;    // Ring insertion delay (non-zero when deferred by policy)
+		uint32_t causeDelay;    // Interrupt cause delay
+		uint32_t consumeDelay;  // Consumption delay by the protocol
+		SMC_EVENT_CODE code;    // Event code
+		uint8_t reserved[3];
+	};
+
+	/**
+	 *  Amount of distinct event codes with own latency histograms, the rest is accounted as other
+	 */
+	static constexpr size_t MaxTrackedCodes {16};
+
+	/**
+	 *  Amount of recent deliveries kept in the trace ring
+	 */
+	static constexpr size_t TraceSize {64};
+
+	/**
+	 *  Record interrupt cause time
+	 *
+	 *  @param now  current time in nanoseconds
+	 */
+	void recordCause(uint64_t now) {
+		atomic_store_explicit(&lastCause, now, memory_order_relaxed);
+	}
+
+	/**
+	 *  Record interrupt delivery, safe to call concurrently
+	 *
+	 *  @param code     event code
+	 *  @param post     post time in nanoseconds
+	 *  @param queue    ring insertion time in nanoseconds
+	 *  @param consume  consumption time in nanoseconds
+	 */
+	void recordDelivery(SMC_EVENT_CODE code, uint64_t post, uint64_t queue, uint64_t consume);
+
+	/**
+	 *  Create latency statistics dictionary with per-code histograms and the trace ring
+	 *
+	 *  @return statistics dictionary or nullptr
+	 */
+	OSDictionary *createStatistics();
+
+private:
+	/**
+	 *  Latency histograms of a single event code
+	 */
+	struct CodeHistograms {
+		_Atomic(uint32_t) code;         // Event code, 0 for unused entries
+		Log2Histogram postToConsume;    // Full delivery latency
+		Log2Histogram causeToConsume;   // Interrupt handler path latency
+	};
+
+	/**
+	 *  Tracked event code histograms, the last one accounts all the codes not fitting the table
+	 */
+	CodeHistograms histograms[MaxTrackedCodes + 1] {};
+
+	/**
+	 *  Recent deliveries, slots are claimed through traced and read as is (best effort)
+	 */
+	Trace traces[TraceSize] {};
+
+	/**
+	 *  Total amount of traced deliveries
+	 */
+	_Atomic(uint64_t) traced {0};
+
+	/**
+	 *  Last interrupt cause time in nanoseconds
+	 */
+	_Atomic(uint64_t) lastCause {0};
+};
+
+#endif /* kern_intrtrace_hpp */
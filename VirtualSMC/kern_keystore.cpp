@@ -6,6 +6,7 @@
 //
 
 #include <libkern/OSByteOrder.h>
+#include <libkern/c++/OSNumber.h>
 #include <stdatomic.h>
 #include <Headers/kern_devinfo.hpp>
 #include <Headers/kern_iokit.hpp>
@@ -14,14 +15,18 @@
 
 #include "kern_keys.hpp"
 #include "kern_keystore.hpp"
+#include "kern_seqlock.hpp"
+#include "kern_timer.hpp"
 
-bool VirtualSMCKeystore::init(const OSDictionary *mainprops, const OSDictionary *userprops, const SMCInfo &info, const char *board, int model, bool whbkp) {
+extern "C" {
+#include <i386/pmCPU.h>
+}
+
+bool VirtualSMCKeystore::init(const OSDictionary *mainprops, const OSDictionary *userprops, const SMCInfo &info, const char *board, int model, bool whbkp, VirtualSMCTimerService *timers) {
 	deviceInfo = info;
+	timerService = timers;
 	deviceInfo.generatorSeed();
 
-	for (size_t i = 0; i < arrsize(pluginData); i++)
-		atomic_init(&pluginData[i], nullptr);
-
 	// Hibernation support
 	if (!addKey(KeyHBKP, VirtualSMCValueHBKP::withDump(whbkp)))
 		return false;
@@ -50,6 +55,23 @@ bool VirtualSMCKeystore::init(const OSDictionary *mainprops, const OSDictionary
 	int tmp;
 	if (lilu_get_boot_args("-vsmcrpt", &tmp, sizeof(tmp)))
 		reportMissingKeys = true;
+	if (lilu_get_boot_args("-vsmcstat", &tmp, sizeof(tmp)))
+		readStatistics = true;
+
+	freezeLock = IOLockAlloc();
+	updateLock = IOLockAlloc();
+	if (!freezeLock || !updateLock) {
+		DBGLOG("kstore", "unable to allocate freeze locks");
+		return false;
+	}
+
+	uint32_t monitoringIntervalMs = MonitoringIntervalDefault;
+	lilu_get_boot_args("vsmcmonint", &monitoringIntervalMs, sizeof(monitoringIntervalMs));
+	monitoringInterval = monitoringIntervalMs * static_cast<uint64_t>(NSEC_PER_MSEC);
+
+	lilu_get_boot_args("vsmcfrzq", &freezeQuorum, sizeof(freezeQuorum));
+	lilu_get_boot_args("vsmcfrzt", &freezeTimeout, sizeof(freezeTimeout));
+	DBGLOG("kstore", "freeze quorum %u, timeout %u", freezeQuorum, freezeTimeout);
 
 	if (!lilu_get_boot_args("vsmcslvl", &serLevel, sizeof(serLevel)) || serLevel > SerializeLevel::Confidential) {
 		DBGLOG("kstore", "no serialiser lvl argument, using normal");
@@ -128,6 +150,12 @@ bool VirtualSMCKeystore::VirtualSMCKeystore::merge(const OSArray *arr) {
 			DBGLOG("kstore", "invalid value contents at %u", i);
 			continue;
 		}
+
+		if (!kv.value->validSize()) {
+			SYSLOG("kstore", "invalid size for key [%08X] type at %u", kv.key, i);
+			delete kv.value;
+			continue;
+		}
 		
 		auto hiddenObj = OSDynamicCast(OSBoolean, kvDict->getObject("hidden"));
 		bool hidden = hiddenObj && hiddenObj->isTrue();
@@ -156,11 +184,23 @@ void VirtualSMCKeystore::handlePowerOn() {
 IOReturn VirtualSMCKeystore::loadPlugin(VirtualSMCAPI::Plugin *plugin) {
 	DBGLOG("kstore", "loading %s (%lu), api: %lu", plugin->product, plugin->version, plugin->apiver);
 
-	if (plugin->apiver != VirtualSMCAPI::Version) {
+	if (plugin->apiver < VirtualSMCAPI::VersionMin || plugin->apiver > VirtualSMCAPI::Version) {
 		SYSLOG("kstore", "failed to load plugin %s (%lu), api %lu vs %lu", plugin->product, plugin->version, plugin->apiver, VirtualSMCAPI::Version);
 		return kIOReturnInvalid;
 	}
 
+	const VirtualSMCAPI::KeyRange *ranges {nullptr};
+	size_t rangeNum = getRanges(plugin, &ranges);
+	for (size_t i = 0; i < rangeNum; i++) {
+		bool valid = VirtualSMCKeyValue::compare(ranges[i].first, ranges[i].last) <= 0;
+		for (size_t j = 0; valid && j < i; j++)
+			valid = VirtualSMCKeyValue::compare(ranges[i].first, ranges[j].last) > 0 || VirtualSMCKeyValue::compare(ranges[j].first, ranges[i].last) > 0;
+		if (!valid) {
+			SYSLOG("kstore", "failed to load plugin %s with invalid or overlapping range [%08X, %08X]", plugin->product, ranges[i].first, ranges[i].last);
+			return kIOReturnBadArgument;
+		}
+	}
+
 	IOReturn code = kIOReturnSuccess;
 	VirtualSMCAPI::KeyStorage ovrData[2];
 	VirtualSMCAPI::KeyStorage *pData[2] {&plugin->data, &plugin->dataHidden};
@@ -170,6 +210,19 @@ IOReturn VirtualSMCKeystore::loadPlugin(VirtualSMCAPI::Plugin *plugin) {
 		auto &currSData = *sData[i];
 		size_t j = 0;
 		while (j < currPData.size()) {
+			auto pVal = atomic_load_explicit(&currPData[j].value, memory_order_relaxed);
+			if (!pVal || !pVal->validSize()) {
+				SYSLOG("kstore", "dropping invalid key [%08X] from %s", currPData[j].key, plugin->product);
+				currPData.erase(j);
+				continue;
+			}
+
+			if (rangeNum > 0 && !ownsKey(plugin, currPData[j].key)) {
+				SYSLOG("kstore", "dropping undeclared key [%08X] from %s", currPData[j].key, plugin->product);
+				currPData.erase(j);
+				continue;
+			}
+
 			VirtualSMCKeyValue *tVal = nullptr;
 			if (getByName(currSData, currPData[j].key, tVal) == SmcSuccess) {
 				if (ovrData[i].push_back<2>(currPData[j])) {
@@ -186,14 +239,15 @@ IOReturn VirtualSMCKeystore::loadPlugin(VirtualSMCAPI::Plugin *plugin) {
 	}
 
 	if (code == kIOReturnSuccess) {
-		code = kIOReturnNoSpace;
-		for (size_t i = 0; i < VirtualSMCAPI::PluginMax; i++) {
-			VirtualSMCAPI::Plugin * nullData = nullptr;
-			if (atomic_compare_exchange_strong_explicit(&pluginData[i], &nullData, plugin, memory_order_relaxed, memory_order_relaxed)) {
-				code = kIOReturnSuccess;
-				break;
-			}
+		IOLockLock(freezeLock);
+		auto owner = findRangeConflict(plugin);
+		if (owner) {
+			SYSLOG("kstore", "failed to load plugin %s with keys conflicting with %s", plugin->product, owner->product);
+			code = kIOReturnExclusiveAccess;
+		} else if (!registerPlugin(plugin)) {
+			code = kIOReturnNoMemory;
 		}
+		IOLockUnlock(freezeLock);
 
 		if (code == kIOReturnSuccess) {
 			for (size_t i = 0; code == kIOReturnSuccess && i < arrsize(ovrData); i++) {
@@ -224,19 +278,629 @@ IOReturn VirtualSMCKeystore::loadPlugin(VirtualSMCAPI::Plugin *plugin) {
 		}
 	}
 
+	IOLockLock(freezeLock);
+	if (code == kIOReturnSuccess)
+		loadedPlugins++;
+	// A late plugin (even a partially failed one) changes the key set, so republish.
+	if (atomic_load_explicit(&frozenKeys, memory_order_relaxed) ||
+		(code == kIOReturnSuccess && freezeQuorum > 0 && loadedPlugins >= freezeQuorum)) {
+		DBGLOG("kstore", "freezing keystore after %s with %u plugins", plugin->product, loadedPlugins);
+		rebuildFrozen();
+	}
+	// Readers may still be reading the overridden values.
+	for (auto &entry : ovrData) {
+		for (size_t i = 0; i < entry.size(); i++) {
+			retireValue(atomic_load_explicit(&entry[i].backup, memory_order_relaxed));
+			atomic_store_explicit(&entry[i].backup, nullptr, memory_order_relaxed);
+		}
+	}
+	IOLockUnlock(freezeLock);
+
 	for (auto &entry : ovrData)
 		entry.deinit();
 
+	scheduleReclaim();
+
+	return code;
+}
+
+IOReturn VirtualSMCKeystore::updatePlugin(VirtualSMCAPI::Plugin *plugin, VirtualSMCAPI::KeyStorage &data, VirtualSMCAPI::KeyStorage &dataHidden, const SMC_KEY *removed, size_t removedNum) {
+	DBGLOG("kstore", "updating %s with %lu + %lu keys, %lu removed", plugin->product, data.size(), dataHidden.size(), removedNum);
+
+	if (plugin->apiver < 2) {
+		SYSLOG("kstore", "plugin %s api %lu does not support key updates", plugin->product, plugin->apiver);
+		data.deinit();
+		dataHidden.deinit();
+		return kIOReturnUnsupported;
+	}
+
+	IOLockLock(updateLock);
+	IOLockLock(freezeLock);
+
+	size_t count;
+	auto plugins = getPlugins(count);
+	bool loaded = false;
+	for (size_t i = 0; !loaded && i < count; i++)
+		loaded = plugins[i] == plugin;
+	if (!loaded) {
+		IOLockUnlock(freezeLock);
+		IOLockUnlock(updateLock);
+		SYSLOG("kstore", "plugin %s is not loaded", plugin->product);
+		data.deinit();
+		dataHidden.deinit();
+		return kIOReturnNotFound;
+	}
+
+	// Plugin storages may only be modified when no reader can walk them, i.e. with a published snapshot.
+	// Before freezing, or with freezing disabled, a temporary snapshot is published for the update only.
+	bool temporary = !atomic_load_explicit(&frozenKeys, memory_order_relaxed);
+	if (temporary)
+		rebuildFrozen();
+
+	// Readers that started before the snapshot was published may still walk the storages.
+	// Wait for them with freezeLock released, updateLock keeps the snapshot published meanwhile.
+	if (gracePeriodCompleted < storageGracePeriod) {
+		auto gracePeriod = storageGracePeriod;
+		IOLockUnlock(freezeLock);
+		waitGracePeriod(gracePeriod);
+		IOLockLock(freezeLock);
+	}
+
+	IOReturn code = kIOReturnSuccess;
+	auto frozen = atomic_load_explicit(&frozenKeys, memory_order_relaxed);
+	if (!frozen)
+		code = kIOReturnNoMemory;
+
+	VirtualSMCAPI::KeyStorage *aData[2] {&data, &dataHidden};
+	VirtualSMCAPI::KeyStorage *pData[2] {&plugin->data, &plugin->dataHidden};
+
+	auto isRemoved = [removed, removedNum](SMC_KEY key) {
+		for (size_t i = 0; i < removedNum; i++)
+			if (removed[i] == key)
+				return true;
+		return false;
+	};
+
+	// Validate everything first, so that a failed update leaves the key set intact.
+	bool ranged = getRanges(plugin, nullptr) > 0;
+	for (size_t i = 0; code == kIOReturnSuccess && i < removedNum; i++) {
+		VirtualSMCKeyValue *kv {nullptr};
+		if (getByName(plugin->data, removed[i], kv) != SmcSuccess && getByName(plugin->dataHidden, removed[i], kv) != SmcSuccess) {
+			SYSLOG("kstore", "%s cannot remove foreign key [%08X]", plugin->product, removed[i]);
+			code = kIOReturnBadArgument;
+		}
+	}
+
+	for (size_t i = 0; code == kIOReturnSuccess && i < arrsize(aData); i++) {
+		auto &currAData = *aData[i];
+		for (size_t j = 0; j < currAData.size(); j++) {
+			VirtualSMCKeyValue *kv {nullptr};
+			auto key = currAData[j].key;
+			auto val = atomic_load_explicit(&currAData[j].value, memory_order_relaxed);
+			auto owner = ranged ? nullptr : getRangeOwner(key);
+			if (!val || !val->validSize() || (ranged && !ownsKey(plugin, key))) {
+				SYSLOG("kstore", "%s added invalid or undeclared key [%08X]", plugin->product, key);
+				code = kIOReturnBadArgument;
+			} else if (owner) {
+				SYSLOG("kstore", "%s added key [%08X] owned by %s", plugin->product, key, owner->product);
+				code = kIOReturnExclusiveAccess;
+			} else if ((j > 0 && VirtualSMCKeyValue::compare(currAData[j - 1].key, key) >= 0) ||
+					   (i > 0 && getByName(data, key, kv) == SmcSuccess)) {
+				SYSLOG("kstore", "%s added unsorted or duplicate key [%08X]", plugin->product, key);
+				code = kIOReturnBadArgument;
+			} else if (findFrozen(frozen, key) && !isRemoved(key)) {
+				SYSLOG("kstore", "%s added existing key [%08X]", plugin->product, key);
+				code = kIOReturnExclusiveAccess;
+			}
+			if (code != kIOReturnSuccess)
+				break;
+		}
+	}
+
+	// Removed values stay alive until the new snapshot is published and the readers are done with the old one.
+	VirtualSMCAPI::KeyStorage removedValues;
+	for (size_t i = 0; code == kIOReturnSuccess && i < removedNum; i++) {
+		for (auto currPData : pData) {
+			VirtualSMCKeyValue *kv {nullptr};
+			if (getByName(*currPData, removed[i], kv) == SmcSuccess) {
+				if (!removedValues.push_back<4>(*kv)) {
+					code = kIOReturnNoMemory;
+					break;
+				}
+				atomic_store_explicit(&kv->value, nullptr, memory_order_relaxed);
+				currPData->erase(static_cast<size_t>(kv - currPData->data()));
+				break;
+			}
+		}
+	}
+
+	for (size_t i = 0; code == kIOReturnSuccess && i < arrsize(aData); i++) {
+		auto &currAData = *aData[i];
+		auto &currPData = *pData[i];
+		for (size_t j = 0; j < currAData.size(); j++) {
+			if (!currPData.push_back<4>(currAData[j])) {
+				code = kIOReturnNoMemory;
+				break;
+			}
+			atomic_store_explicit(&currAData[j].value, nullptr, memory_order_relaxed);
+		}
+		qsort(const_cast<VirtualSMCKeyValue *>(currPData.data()), currPData.size(), sizeof(VirtualSMCKeyValue), VirtualSMCKeyValue::compare);
+	}
+
+	// Even a partial update changes the key set, so republish or return to the updated storages.
+	if (frozen && temporary)
+		unpublishFrozen();
+	else if (frozen)
+		rebuildFrozen();
+
+	// Removed values may still be read through the previous snapshot.
+	for (size_t i = 0; i < removedValues.size(); i++) {
+		retireValue(atomic_load_explicit(&removedValues[i].value, memory_order_relaxed));
+		retireValue(atomic_load_explicit(&removedValues[i].backup, memory_order_relaxed));
+		atomic_store_explicit(&removedValues[i].value, nullptr, memory_order_relaxed);
+		atomic_store_explicit(&removedValues[i].backup, nullptr, memory_order_relaxed);
+	}
+
+	IOLockUnlock(freezeLock);
+	IOLockUnlock(updateLock);
+
+	removedValues.deinit();
+	data.deinit();
+	dataHidden.deinit();
+
+	scheduleReclaim();
+
+	if (code != kIOReturnSuccess)
+		SYSLOG("kstore", "failed to update %s keys %X", plugin->product, code);
+
 	return code;
 }
 
+size_t VirtualSMCKeystore::getRanges(const VirtualSMCAPI::Plugin *plugin, const VirtualSMCAPI::KeyRange **ranges) {
+	// Older plugins do not have the fields at all.
+	if (plugin->apiver < 2 || !plugin->ranges)
+		return 0;
+	if (ranges)
+		*ranges = plugin->ranges;
+	return plugin->rangeNum;
+}
+
+bool VirtualSMCKeystore::ownsKey(const VirtualSMCAPI::Plugin *plugin, SMC_KEY key) {
+	const VirtualSMCAPI::KeyRange *ranges {nullptr};
+	size_t rangeNum = getRanges(plugin, &ranges);
+	for (size_t i = 0; i < rangeNum; i++) {
+		if (VirtualSMCKeyValue::compare(ranges[i].first, key) <= 0 && VirtualSMCKeyValue::compare(key, ranges[i].last) <= 0)
+			return true;
+	}
+
+	return false;
+}
+
+VirtualSMCAPI::Plugin *VirtualSMCKeystore::getRangeOwner(SMC_KEY key) {
+	auto table = atomic_load_explicit(&rangeTable, memory_order_acquire);
+	if (!table)
+		return nullptr;
+
+	// Find the last range starting at or before the key, ranges do not overlap.
+	size_t start = 0, end = table->ownerCount;
+	while (start < end) {
+		size_t curr = (start + end) / 2;
+		if (VirtualSMCKeyValue::compare(table->owners[curr].range.first, key) <= 0)
+			start = curr + 1;
+		else
+			end = curr;
+	}
+
+	if (start > 0 && VirtualSMCKeyValue::compare(key, table->owners[start - 1].range.last) <= 0)
+		return table->owners[start - 1].plugin;
+	return nullptr;
+}
+
+bool VirtualSMCKeystore::hasKeyInRange(VirtualSMCAPI::KeyStorage &storage, const VirtualSMCAPI::KeyRange &range) {
+	// Find the first key at or after the range start.
+	size_t start = 0, end = storage.size();
+	while (start < end) {
+		size_t curr = (start + end) / 2;
+		if (VirtualSMCKeyValue::compare(storage[curr].key, range.first) < 0)
+			start = curr + 1;
+		else
+			end = curr;
+	}
+
+	return start < storage.size() && VirtualSMCKeyValue::compare(storage[start].key, range.last) <= 0;
+}
+
+VirtualSMCAPI::Plugin *VirtualSMCKeystore::findRangeConflict(VirtualSMCAPI::Plugin *plugin) {
+	size_t count;
+	auto plugins = getPlugins(count);
+	const VirtualSMCAPI::KeyRange *ranges {nullptr};
+	size_t rangeNum = getRanges(plugin, &ranges);
+
+	if (rangeNum == 0) {
+		// Keys within declared ranges would never be looked up in this plugin.
+		VirtualSMCAPI::KeyStorage *pData[2] {&plugin->data, &plugin->dataHidden};
+		for (auto storage : pData) {
+			for (size_t i = 0; i < storage->size(); i++) {
+				auto owner = getRangeOwner((*storage)[i].key);
+				if (owner)
+					return owner;
+			}
+		}
+		return nullptr;
+	}
+
+	auto table = atomic_load_explicit(&rangeTable, memory_order_relaxed);
+	for (size_t i = 0; i < rangeNum; i++) {
+		// The last range starting at or before the new range end is the only candidate for an overlap.
+		for (size_t j = table ? table->ownerCount : 0; j > 0; j--) {
+			auto &owner = table->owners[j - 1];
+			if (VirtualSMCKeyValue::compare(owner.range.first, ranges[i].last) <= 0) {
+				if (VirtualSMCKeyValue::compare(ranges[i].first, owner.range.last) <= 0)
+					return owner.plugin;
+				break;
+			}
+		}
+
+		for (size_t j = 0; j < count; j++) {
+			if (getRanges(plugins[j], nullptr) == 0 &&
+				(hasKeyInRange(plugins[j]->data, ranges[i]) || hasKeyInRange(plugins[j]->dataHidden, ranges[i])))
+				return plugins[j];
+		}
+	}
+
+	return nullptr;
+}
+
+VirtualSMCKeystore::RangeTable *VirtualSMCKeystore::createRangeTable(RangeTable *curr, VirtualSMCAPI::Plugin *plugin) {
+	const VirtualSMCAPI::KeyRange *ranges {nullptr};
+	size_t rangeNum = getRanges(plugin, &ranges);
+	size_t currNum = curr ? curr->ownerCount : 0;
+
+	auto table = new RangeTable;
+	if (table)
+		table->owners = Buffer::create<RangeOwner>(currNum + rangeNum);
+	if (!table || !table->owners) {
+		SYSLOG("kstore", "failed to allocate range table for %lu ranges", currNum + rangeNum);
+		delete table;
+		return nullptr;
+	}
+
+	if (currNum > 0)
+		lilu_os_memcpy(table->owners, curr->owners, currNum * sizeof(table->owners[0]));
+	for (size_t i = 0; i < rangeNum; i++)
+		table->owners[currNum + i] = {ranges[i], plugin};
+	table->ownerCount = currNum + rangeNum;
+
+	qsort(table->owners, table->ownerCount, sizeof(table->owners[0]), [](const void *a, const void *b) {
+		return VirtualSMCKeyValue::compare(static_cast<const RangeOwner *>(a)->range.first, static_cast<const RangeOwner *>(b)->range.first);
+	});
+
+	return table;
+}
+
+void VirtualSMCKeystore::deleteRangeTable(RangeTable *table) {
+	if (table) {
+		Buffer::deleter(table->owners);
+		delete table;
+	}
+}
+
+bool VirtualSMCKeystore::registerPlugin(VirtualSMCAPI::Plugin *plugin) {
+	// Build the range table first, so that nothing is published on failure.
+	RangeTable *table {nullptr};
+	if (getRanges(plugin, nullptr) > 0) {
+		table = createRangeTable(atomic_load_explicit(&rangeTable, memory_order_relaxed), plugin);
+		if (!table)
+			return false;
+	}
+
+	size_t count;
+	auto plugins = getPlugins(count);
+
+	if (count < pluginCapacity) {
+		plugins[count] = plugin;
+		atomic_store_explicit(&pluginCount, count + 1, memory_order_release);
+	} else {
+		auto capacity = pluginCapacity > 0 ? pluginCapacity * 2 : PluginListInitial;
+		auto grown = Buffer::create<VirtualSMCAPI::Plugin *>(capacity);
+		if (!grown) {
+			SYSLOG("kstore", "failed to grow plugin list to %lu", capacity);
+			deleteRangeTable(table);
+			return false;
+		}
+
+		if (count > 0)
+			lilu_os_memcpy(grown, plugins, count * sizeof(grown[0]));
+		grown[count] = plugin;
+
+		// Readers load the count first, so the list must be published before it.
+		atomic_store_explicit(&pluginList, grown, memory_order_release);
+		atomic_store_explicit(&pluginCount, count + 1, memory_order_release);
+		pluginCapacity = capacity;
+
+		if (plugins) {
+			retire(plugins, [](void *object) {
+				Buffer::deleter(static_cast<VirtualSMCAPI::Plugin **>(object));
+			});
+		}
+	}
+
+	if (table) {
+		auto curr = atomic_load_explicit(&rangeTable, memory_order_relaxed);
+		atomic_store_explicit(&rangeTable, table, memory_order_release);
+		if (curr) {
+			retire(curr, [](void *object) {
+				deleteRangeTable(static_cast<RangeTable *>(object));
+			});
+		}
+	}
+
+	return true;
+}
+
+uint32_t VirtualSMCKeystore::enterReader() {
+	// Any slot is correct, the current CPU one just avoids sharing the cache line.
+	auto &slot = readerSlots[cpu_number() % ReaderSlots];
+	while (true) {
+		auto epoch = atomic_load_explicit(&readerEpoch, memory_order_relaxed);
+		atomic_fetch_add(&slot.entered[epoch & 1], 1);
+		// Writer might have started a grace period after we loaded the epoch, retry in the new one.
+		if (atomic_load(&readerEpoch) == epoch)
+			return epoch;
+		atomic_fetch_add_explicit(&slot.left[epoch & 1], 1, memory_order_release);
+	}
+}
+
+void VirtualSMCKeystore::leaveReader(uint32_t epoch) {
+	atomic_fetch_add_explicit(&readerSlots[cpu_number() % ReaderSlots].left[epoch & 1], 1, memory_order_release);
+}
+
+bool VirtualSMCKeystore::readersDone(uint32_t parity) {
+	// Every counted leave has its enter visible, so equal sums mean no reader was inside.
+	uint64_t left = 0, entered = 0;
+	for (auto &slot : readerSlots)
+		left += atomic_load_explicit(&slot.left[parity], memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	for (auto &slot : readerSlots)
+		entered += atomic_load(&slot.entered[parity]);
+	return left == entered;
+}
+
+uint32_t VirtualSMCKeystore::requestGracePeriod() {
+	// A grace period already in progress may have missed the readers that entered just now.
+	auto gracePeriod = atomic_load_explicit(&readerEpoch, memory_order_relaxed) + 1;
+	if (gracePeriodRequested < gracePeriod)
+		gracePeriodRequested = gracePeriod;
+	return gracePeriod;
+}
+
+void VirtualSMCKeystore::retire(void *object, void (*deleter)(void *object)) {
+	Retired entry {object, deleter, requestGracePeriod()};
+	if (!retired.push_back<4>(entry))
+		SYSLOG("kstore", "failed to retire %p, leaking it", object);
+}
+
+void VirtualSMCKeystore::retireValue(VirtualSMCValue *value) {
+	if (value) {
+		retire(value, [](void *object) {
+			VirtualSMCValue::deleter(static_cast<VirtualSMCValue *>(object));
+		});
+	}
+}
+
+bool VirtualSMCKeystore::reclaim() {
+	auto epoch = atomic_load_explicit(&readerEpoch, memory_order_relaxed);
+	// Readers that entered before the grace period started are counted in the previous epoch.
+	if (gracePeriodCompleted != epoch && readersDone((epoch - 1) & 1))
+		gracePeriodCompleted = epoch;
+	if (gracePeriodCompleted == epoch && gracePeriodRequested != epoch) {
+		epoch = atomic_fetch_add(&readerEpoch, 1) + 1;
+		if (readersDone((epoch - 1) & 1))
+			gracePeriodCompleted = epoch;
+	}
+
+	size_t i = 0;
+	while (i < retired.size()) {
+		if (retired[i].gracePeriod <= gracePeriodCompleted) {
+			retired[i].deleter(retired[i].object);
+			retired.erase(i);
+		} else {
+			i++;
+		}
+	}
+
+	return gracePeriodCompleted != gracePeriodRequested;
+}
+
+void VirtualSMCKeystore::scheduleReclaim() {
+	IOLockLock(freezeLock);
+	bool schedule = !reclaimScheduled && reclaim();
+	if (schedule)
+		reclaimScheduled = true;
+	auto gracePeriod = gracePeriodRequested;
+	IOLockUnlock(freezeLock);
+
+	// Timer actions take freezeLock within the timer service gate, so the timer is added without it.
+	if (schedule && (!timerService || !timerService->add(reclaimAction, this, ReclaimIntervalMs, false, ReclaimLeewayMs))) {
+		DBGLOG("kstore", "no reclaim timer, waiting for grace period %u", gracePeriod);
+		IOLockLock(freezeLock);
+		reclaimScheduled = false;
+		IOLockUnlock(freezeLock);
+		waitGracePeriod(gracePeriod);
+	}
+}
+
+void VirtualSMCKeystore::reclaimAction(void *context) {
+	auto keystore = static_cast<VirtualSMCKeystore *>(context);
+	IOLockLock(keystore->freezeLock);
+	keystore->reclaimScheduled = false;
+	IOLockUnlock(keystore->freezeLock);
+	keystore->scheduleReclaim();
+}
+
+void VirtualSMCKeystore::waitGracePeriod(uint32_t gracePeriod) {
+	while (true) {
+		IOLockLock(freezeLock);
+		reclaim();
+		bool done = gracePeriodCompleted >= gracePeriod;
+		IOLockUnlock(freezeLock);
+		if (done)
+			break;
+		IOSleep(1);
+	}
+}
+
+void VirtualSMCKeystore::deleteFrozen(FrozenKeys *frozen) {
+	if (frozen) {
+		Buffer::deleter(frozen->keys);
+		Buffer::deleter(frozen->index);
+		if (frozen->caches)
+			Buffer::deleter(frozen->caches);
+		delete frozen;
+	}
+}
+
+void VirtualSMCKeystore::freeze() {
+	IOLockLock(freezeLock);
+	if (!atomic_load_explicit(&frozenKeys, memory_order_relaxed)) {
+		DBGLOG("kstore", "freezing keystore with %u plugins", loadedPlugins);
+		rebuildFrozen();
+	}
+	IOLockUnlock(freezeLock);
+	scheduleReclaim();
+}
+
+void VirtualSMCKeystore::rebuildFrozen() {
+	size_t count;
+	auto plugins = getPlugins(count);
+	size_t keyCount = dataStorage.size() + dataHiddenStorage.size();
+	size_t indexCount = dataStorage.size();
+	for (size_t i = 0; i < count; i++) {
+		keyCount += plugins[i]->data.size() + plugins[i]->dataHidden.size();
+		indexCount += plugins[i]->data.size();
+	}
+
+	auto curr = atomic_load_explicit(&frozenKeys, memory_order_relaxed);
+	auto frozen = new FrozenKeys;
+	if (frozen) {
+		frozen->keys = Buffer::create<FrozenKey>(keyCount);
+		frozen->index = Buffer::create<SMC_KEY>(indexCount);
+	}
+
+	if (!frozen || !frozen->keys || !frozen->index) {
+		SYSLOG("kstore", "failed to allocate frozen keystore for %lu keys", keyCount);
+		if (frozen) {
+			if (frozen->keys) Buffer::deleter(frozen->keys);
+			if (frozen->index) Buffer::deleter(frozen->index);
+			delete frozen;
+		}
+		// Fall back to regular lookups, the current snapshot may still be in use.
+		unpublishFrozen();
+		return;
+	}
+
+	auto append = [frozen](VirtualSMCAPI::KeyStorage &storage, bool indexed) {
+		for (size_t i = 0; i < storage.size(); i++) {
+			auto value = atomic_load_explicit(&storage[i].value, memory_order_relaxed);
+			if (value) {
+				auto &entry = frozen->keys[frozen->keyCount++];
+				entry.key = storage[i].key;
+				entry.keyClass = classifyKey(entry.key);
+				entry.value = value;
+				entry.cache = nullptr;
+			}
+			if (indexed)
+				frozen->index[frozen->indexCount++] = storage[i].key;
+		}
+	};
+
+	// Append in lookup priority order, which matches getByName and getByIndex.
+	append(dataStorage, true);
+	for (size_t i = 0; i < count; i++)
+		append(plugins[i]->data, true);
+	append(dataHiddenStorage, false);
+	for (size_t i = 0; i < count; i++)
+		append(plugins[i]->dataHidden, false);
+
+	// Stable insertion sort, every storage is sorted already, so this mostly merges.
+	for (size_t i = 1; i < frozen->keyCount; i++) {
+		auto entry = frozen->keys[i];
+		size_t j = i;
+		while (j > 0 && VirtualSMCKeyValue::compare(frozen->keys[j - 1].key, entry.key) > 0) {
+			frozen->keys[j] = frozen->keys[j - 1];
+			j--;
+		}
+		frozen->keys[j] = entry;
+	}
+
+	// Drop duplicates keeping the first (highest priority) entry.
+	size_t unique = 0;
+	for (size_t i = 0; i < frozen->keyCount; i++) {
+		if (unique == 0 || frozen->keys[unique - 1].key != frozen->keys[i].key)
+			frozen->keys[unique++] = frozen->keys[i];
+	}
+	frozen->keyCount = unique;
+
+	// Throttled keys are served from their last contents, which is kept next to the snapshot.
+	if (monitoringInterval > 0) {
+		size_t cacheCount = 0;
+		for (size_t i = 0; i < frozen->keyCount; i++) {
+			if (frozen->keys[i].keyClass == KeyClassMonitoring)
+				cacheCount++;
+		}
+		frozen->caches = cacheCount > 0 ? Buffer::create<ReadCache>(cacheCount) : nullptr;
+		if (frozen->caches) {
+			size_t cache = 0;
+			for (size_t i = 0; i < frozen->keyCount; i++) {
+				if (frozen->keys[i].keyClass == KeyClassMonitoring) {
+					atomic_init(&frozen->caches[cache].seq, 0);
+					atomic_init(&frozen->caches[cache].lastRead, 0);
+					frozen->keys[i].cache = &frozen->caches[cache++];
+				}
+			}
+		} else if (cacheCount > 0) {
+			SYSLOG("kstore", "failed to allocate %lu read caches, not throttling", cacheCount);
+		}
+	}
+
+	atomic_store_explicit(&frozenKeys, frozen, memory_order_seq_cst);
+
+	DBGLOG("kstore", "published frozen keystore with %lu keys (%lu public)", frozen->keyCount, frozen->indexCount);
+
+	// Readers that started earlier may still use the previous snapshot, or the storages when there was none.
+	if (curr) {
+		retire(curr, [](void *object) {
+			deleteFrozen(static_cast<FrozenKeys *>(object));
+		});
+	} else {
+		storageGracePeriod = requestGracePeriod();
+	}
+}
+
+void VirtualSMCKeystore::unpublishFrozen() {
+	auto curr = atomic_load_explicit(&frozenKeys, memory_order_relaxed);
+	if (curr) {
+		atomic_store_explicit(&frozenKeys, nullptr, memory_order_seq_cst);
+		retire(curr, [](void *object) {
+			deleteFrozen(static_cast<FrozenKeys *>(object));
+		});
+	}
+}
+
 uint32_t VirtualSMCKeystore::getPublicKeyAmount() {
-	auto sz = dataStorage.size();
-	for (size_t i = 0; i < VirtualSMCAPI::PluginMax; i++) {
-		auto p = atomic_load_explicit(&pluginData[i], memory_order_relaxed);
-		if (!p) break;
-		sz += p->data.size();
+	auto epoch = enterReader();
+	auto frozen = atomic_load_explicit(&frozenKeys, memory_order_acquire);
+	size_t sz;
+	if (frozen) {
+		sz = frozen->indexCount;
+	} else {
+		size_t count;
+		auto plugins = getPlugins(count);
+		sz = dataStorage.size();
+		for (size_t i = 0; i < count; i++)
+			sz += plugins[i]->data.size();
 	}
+	leaveReader(epoch);
 	return static_cast<uint32_t>(sz);
 }
 
@@ -620,7 +1284,7 @@ bool VirtualSMCKeystore::mergePredefined(const char *board, int model) {
 
 	SMC_DATA mspr[2] {0x00, 0x01};
 	if (!addKey(KeyMSPR, VirtualSMCValueVariable::withData(
-		mspr, sizeof(uint16_t), SmcKeyTypeUint8, SMC_KEY_ATTRIBUTE_READ|SMC_KEY_ATTRIBUTE_CONST)))
+		mspr, sizeof(uint16_t), SmcKeyTypeUint16, SMC_KEY_ATTRIBUTE_READ|SMC_KEY_ATTRIBUTE_CONST)))
 		return false;
 
 	if (!addKey(KeyDUSR, VirtualSMCValueDUSR::create()))
@@ -656,12 +1320,21 @@ SMC_RESULT VirtualSMCKeystore::getByName(SMC_KEY name, VirtualSMCKeyValue *&val,
 	SMC_RESULT r = getByName(hidden ? dataHiddenStorage : dataStorage, name, val);
 
 	if (r != SmcSuccess) {
-		for (size_t i = 0; i < VirtualSMCAPI::PluginMax; i++) {
-			auto p = atomic_load_explicit(&pluginData[i], memory_order_relaxed);
-			if (!p) break;
-			r = getByName(hidden ? p->dataHidden : p->data, name, val);
-			if (r == SmcSuccess)
-				break;
+		// Keys within declared ranges may only be owned by the declaring plugin.
+		auto owner = getRangeOwner(name);
+		if (owner) {
+			r = getByName(hidden ? owner->dataHidden : owner->data, name, val);
+		} else {
+			size_t count;
+			auto plugins = getPlugins(count);
+			for (size_t i = 0; i < count; i++) {
+				auto p = plugins[i];
+				if (getRanges(p, nullptr) > 0)
+					continue;
+				r = getByName(hidden ? p->dataHidden : p->data, name, val);
+				if (r == SmcSuccess)
+					break;
+			}
 		}
 	}
 
@@ -695,16 +1368,62 @@ SMC_RESULT VirtualSMCKeystore::getByName(VirtualSMCAPI::KeyStorage &storage, SMC
 	return SmcNotFound;
 }
 
+SMC_RESULT VirtualSMCKeystore::getValueByName(SMC_KEY name, VirtualSMCValue *&value, FrozenKey **frozenKey) {
+	auto frozen = atomic_load_explicit(&frozenKeys, memory_order_acquire);
+	if (!frozen) {
+		VirtualSMCKeyValue *kv {nullptr};
+		auto res = getByName(name, kv, false);
+		if (res != SmcSuccess)
+			res = getByName(name, kv, true);
+		if (res == SmcSuccess)
+			value = atomic_load_explicit(&kv->value, memory_order_relaxed);
+		return res;
+	}
+
+	SMC_RESULT r = SmcNotFound;
+	auto entry = findFrozen(frozen, name);
+	if (entry) {
+		value = entry->value;
+		if (frozenKey)
+			*frozenKey = entry;
+		r = SmcSuccess;
+	}
+
+	if (valueKPST)
+		static_cast<VirtualSMCValueKPST *>(valueKPST)->setUnlocked(false);
+
+	return r;
+}
+
+VirtualSMCKeystore::FrozenKey *VirtualSMCKeystore::findFrozen(FrozenKeys *frozen, SMC_KEY name) {
+	ssize_t start = 0;
+	ssize_t end = frozen->keyCount - 1;
+	while (start <= end) {
+		ssize_t curr = (start + end) / 2;
+		auto cmp = VirtualSMCKeyValue::compare(frozen->keys[curr].key, name);
+
+		if (cmp == 0)
+			return &frozen->keys[curr];
+		else if (cmp > 0)
+			end = curr - 1;
+		else
+			start = curr + 1;
+	}
+
+	return nullptr;
+}
+
 SMC_RESULT VirtualSMCKeystore::getByIndex(SMC_KEY_INDEX idx, VirtualSMCKeyValue *&val) {
 	if (idx < dataStorage.size()) {
 		val = &dataStorage[idx];
 		return SmcSuccess;
 	}
 
+	size_t count;
+	auto plugins = getPlugins(count);
 	auto nidx = idx - dataStorage.size();
-	for (size_t i = 0; i < VirtualSMCAPI::PluginMax; i++) {
-		auto p = atomic_load_explicit(&pluginData[i], memory_order_relaxed);
-		if (!p) break;
+	for (size_t i = 0; i < count; i++) {
+		auto p = plugins[i];
 		if (nidx < p->data.size()) {
 			val = &p->data[nidx];
 			return SmcSuccess;
@@ -719,7 +1438,10 @@ SMC_RESULT VirtualSMCKeystore::getByIndex(SMC_KEY_INDEX idx, VirtualSMCKeyValue
 bool VirtualSMCKeystore::addKey(SMC_KEY key, VirtualSMCValue *val, bool hidden) {
 	if (val) {
 		auto &d = hidden ? dataHiddenStorage : dataStorage;
-		if (d.push_back<4>(VirtualSMCKeyValue::create(key, val))) {
+		if (!val->validSize()) {
+			SYSLOG("kstore", "invalid size for key [%08X] (%d) type", key, hidden);
+			delete val;
+		} else if (d.push_back<4>(VirtualSMCKeyValue::create(key, val))) {
 			DBGLOG("kstore", "inserted key [%08X] (%d)", key, hidden);
 			return true;
 		} else {
@@ -733,68 +1455,177 @@ bool VirtualSMCKeystore::addKey(SMC_KEY key, VirtualSMCValue *val, bool hidden)
 	return false;
 }
 
-SMC_RESULT VirtualSMCKeystore::readValueByName(SMC_KEY key, const VirtualSMCValue *&value) {
-	VirtualSMCKeyValue *kv {nullptr};
-	auto res = getByName(key, kv, false);
-	if (res != SmcSuccess)
-		res = getByName(key, kv, true);
+SMC_RESULT VirtualSMCKeystore::readValueByName(SMC_KEY key, SMC_DATA *data, SMC_DATA_SIZE &size) {
+	auto epoch = enterReader();
+	VirtualSMCValue *currval {nullptr};
+	FrozenKey *frozen {nullptr};
+	auto res = getValueByName(key, currval, &frozen);
 
 	if (res == SmcSuccess) {
-		// Any valid value for the time being.
-		auto currval = atomic_load_explicit(&kv->value, memory_order_relaxed);
-
 		// Check if readable
-		if (!(currval->attr & SMC_KEY_ATTRIBUTE_READ))
+		if (!(currval->attr & SMC_KEY_ATTRIBUTE_READ)) {
+			leaveReader(epoch);
 			return SmcNotReadable;
+		}
 		
 		// Check if privately readable
 		if (currval->attr & SMC_KEY_ATTRIBUTE_PRIVATE_READ &&
 			(!static_cast<VirtualSMCValueKPST *>(valueKPST)->unlocked() ||
-			 OSSwapInt32(*reinterpret_cast<uint32_t *>(valueEPCI->data) & 0xFF00) == 0xF000))
-		return SmcNotReadable;
-		
-		// Update internal buffers
-		res = currval->readAccess();
-		if (res == SmcSuccess)
-			value = currval;
+			 OSSwapInt32(*reinterpret_cast<uint32_t *>(valueEPCI->data) & 0xFF00) == 0xF000)) {
+			leaveReader(epoch);
+			return SmcNotReadable;
+		}
+
+		auto cache = frozen ? frozen->cache : nullptr;
+		uint64_t start = (readStatistics || cache) ? getCurrentTimeNs() : 0;
+
+		// Serve frequent monitoring reads from the last contents to keep plugin locks free for other keys.
+		bool throttled = false;
+		if (cache) {
+			auto lastRead = atomic_load_explicit(&cache->lastRead, memory_order_acquire);
+			if (lastRead != 0 && start - lastRead < monitoringInterval) {
+				size = currval->size;
+				throttled = SeqLock::read(cache->seq, [cache, data, size]() {
+					lilu_os_memcpy(data, cache->data, size);
+				}, 1);
+			}
+		}
+
+		if (!throttled) {
+			// Update internal buffers
+			res = currval->readAccess();
+			// Copy within the read section, the value may be removed right after it is left.
+			if (res == SmcSuccess) {
+				auto src = currval->get(size);
+				lilu_os_memcpy(data, src, size);
+				// Another reader refreshing the contents right now stores the same ones.
+				if (cache && SeqLock::tryWrite(cache->seq, [cache, data, size]() { lilu_os_memcpy(cache->data, data, size); }))
+					atomic_store_explicit(&cache->lastRead, start, memory_order_release);
+			}
+		}
+
+		if (readStatistics)
+			updateStatistics(frozen ? frozen->keyClass : classifyKey(key), getCurrentTimeNs() - start, throttled);
 	} else {
 		SYSLOG_COND(reportMissingKeys || ADDPR(debugEnabled), "kstore", "key [%c%c%c%c] not found for reading",
 					reinterpret_cast<char *>(&key)[0], reinterpret_cast<char *>(&key)[1],
 					reinterpret_cast<char *>(&key)[2], reinterpret_cast<char *>(&key)[3]);
 	}
-	
+
+	leaveReader(epoch);
 	return res;
 }
 
+VirtualSMCKeystore::KeyClass VirtualSMCKeystore::classifyKey(SMC_KEY key) {
+	size_t lo = 0, hi = arrsize(KeyClasses);
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (KeyClasses[mid].range.last < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < arrsize(KeyClasses) && KeyClasses[lo].range.first <= key)
+		return KeyClasses[lo].keyClass;
+	return KeyClassCritical;
+}
+
+void VirtualSMCKeystore::updateStatistics(KeyClass cls, uint64_t latency, bool throttled) {
+	auto &stats = classStatistics[cls];
+	atomic_fetch_add_explicit(&stats.reads, 1, memory_order_relaxed);
+	if (throttled)
+		atomic_fetch_add_explicit(&stats.throttled, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&stats.totalLatency, latency, memory_order_relaxed);
+	auto maxLatency = atomic_load_explicit(&stats.maxLatency, memory_order_relaxed);
+	while (latency > maxLatency &&
+		   !atomic_compare_exchange_weak_explicit(&stats.maxLatency, &maxLatency, latency, memory_order_relaxed, memory_order_relaxed));
+}
+
+OSDictionary *VirtualSMCKeystore::createStatistics() {
+	static const char *classNames[KeyClassTotal] {
+		"Critical",
+		"FanControl",
+		"Monitoring"
+	};
+
+	auto dict = OSDictionary::withCapacity(KeyClassTotal);
+	if (!dict)
+		return nullptr;
+
+	for (size_t i = 0; readStatistics && i < KeyClassTotal; i++) {
+		auto &stats = classStatistics[i];
+		auto clsDict = OSDictionary::withCapacity(4);
+		if (!clsDict)
+			continue;
+
+		struct {
+			const char *name;
+			uint64_t value;
+		} counters[] {
+			{"Reads", atomic_load_explicit(&stats.reads, memory_order_relaxed)},
+			{"Throttled", atomic_load_explicit(&stats.throttled, memory_order_relaxed)},
+			{"TotalLatencyNs", atomic_load_explicit(&stats.totalLatency, memory_order_relaxed)},
+			{"MaxLatencyNs", atomic_load_explicit(&stats.maxLatency, memory_order_relaxed)}
+		};
+
+		for (auto &counter : counters) {
+			auto num = OSNumber::withNumber(counter.value, 64);
+			if (num) {
+				clsDict->setObject(counter.name, num);
+				num->release();
+			}
+		}
+
+		dict->setObject(classNames[i], clsDict);
+		clsDict->release();
+	}
+
+	return dict;
+}
+
 SMC_RESULT VirtualSMCKeystore::readNameByIndex(SMC_KEY_INDEX idx, SMC_KEY &key) {
-	VirtualSMCKeyValue *kv {nullptr};
-	auto res = getByIndex(idx, kv);
-	if (res == SmcSuccess)
-		key = kv->key;
-		
-	return res;
+	auto epoch = enterReader();
+	SMC_RESULT res;
+	auto frozen = atomic_load_explicit(&frozenKeys, memory_order_acquire);
+	if (frozen) {
+		if (idx < frozen->indexCount) {
+			key = frozen->index[idx];
+			res = SmcSuccess;
+		} else {
+			DBGLOG("kstore", "key at %u not found", idx);
+			res = SmcKeyIndexRangeError;
+		}
+	} else {
+		VirtualSMCKeyValue *kv {nullptr};
+		res = getByIndex(idx, kv);
+		if (res == SmcSuccess)
+			key = kv->key;
+	}
 
+	leaveReader(epoch);
+	return res;
 }
 
 SMC_RESULT VirtualSMCKeystore::writeValueByName(SMC_KEY key, const SMC_DATA *data) {
-	VirtualSMCKeyValue *kv {nullptr};
-	auto res = getByName(key, kv, false);
-	if (res != SmcSuccess)
-		res = getByName(key, kv, true);
+	auto epoch = enterReader();
+	VirtualSMCValue *currval {nullptr};
+	auto res = getValueByName(key, currval);
 	
 	if (res == SmcSuccess) {
-		// Any valid value for the time being.
-		auto currval = atomic_load_explicit(&kv->value, memory_order_relaxed);
-
 		// Check if writable
-		if (!(currval->attr & SMC_KEY_ATTRIBUTE_WRITE))
+		if (!(currval->attr & SMC_KEY_ATTRIBUTE_WRITE)) {
+			leaveReader(epoch);
 			return SmcNotWritable;
+		}
 		
 		// Check if privately writable
 		if (currval->attr & SMC_KEY_ATTRIBUTE_PRIVATE_WRITE &&
 			(!static_cast<VirtualSMCValueKPST *>(valueKPST)->unlocked() ||
-			 OSSwapInt32(*reinterpret_cast<uint32_t *>(valueEPCI->data) & 0xFF00) == 0xF000))
+			 OSSwapInt32(*reinterpret_cast<uint32_t *>(valueEPCI->data) & 0xFF00) == 0xF000)) {
+			leaveReader(epoch);
 			return SmcNotReadable;
+		}
 		
 		// Update internal buffers
 		res = currval->writeAccess();
@@ -807,18 +1638,16 @@ SMC_RESULT VirtualSMCKeystore::writeValueByName(SMC_KEY key, const SMC_DATA *dat
 					reinterpret_cast<char *>(&key)[2], reinterpret_cast<char *>(&key)[3]);
 	}
 	
+	leaveReader(epoch);
 	return res;
 }
 
 SMC_RESULT VirtualSMCKeystore::getInfoByName(SMC_KEY key, SMC_DATA_SIZE &size, SMC_KEY_TYPE &type, SMC_KEY_ATTRIBUTES &attr) {
-	VirtualSMCKeyValue *kv {nullptr};
-	auto res = getByName(key, kv, false);
-	if (res != SmcSuccess)
-		res = getByName(key, kv, true);
+	auto epoch = enterReader();
+	VirtualSMCValue *currval {nullptr};
+	auto res = getValueByName(key, currval);
 	
 	if (res == SmcSuccess) {
-		// Any valid value for the time being.
-		auto currval = atomic_load_explicit(&kv->value, memory_order_relaxed);;
 		size = currval->size;
 		type = currval->type;
 		attr = currval->attr & ~SMC_KEY_ATTRIBUTE_CONST;
@@ -834,5 +1663,6 @@ SMC_RESULT VirtualSMCKeystore::getInfoByName(SMC_KEY key, SMC_DATA_SIZE &size, S
 					reinterpret_cast<char *>(&key)[2], reinterpret_cast<char *>(&key)[3]);
 	}
 	
+	leaveReader(epoch);
 	return res;
 }
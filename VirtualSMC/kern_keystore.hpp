@@ -16,6 +16,7 @@
 #include <VirtualSMCSDK/kern_value.hpp>
 #include <VirtualSMCSDK/kern_keyvalue.hpp>
 
+#include <IOKit/IOLocks.h>
 #include <IOKit/IORegistryEntry.h>
 #include <libkern/c++/OSArray.h>
 #include <libkern/c++/OSData.h>
@@ -24,7 +25,11 @@
 #include <stdint.h>
 #include <stdatomic.h>
 
-class VirtualSMCKeystore {
+#include "kern_protocol.hpp"
+
+class VirtualSMCTimerService;
+
+class VirtualSMCKeystore : public SMCProtocolKeystore {
 	/**
 	 *  Key name definitions
 	 */
@@ -101,9 +106,477 @@ class VirtualSMCKeystore {
 	VirtualSMCAPI::KeyStorage dataStorage, dataHiddenStorage;
 
 	/**
-	 *  Registered plugin key arrays in the keystore
+	 *  Initial plugin list capacity, grown twice whenever exhausted
+	 */
+	static constexpr size_t PluginListInitial {8};
+
+	/**
+	 *  Registered plugins in load order, replaced on growth and freed after a grace period
+	 */
+	_Atomic(VirtualSMCAPI::Plugin **) pluginList {nullptr};
+
+	/**
+	 *  Number of registered plugins in pluginList, published after the entry is written
+	 */
+	_Atomic(size_t) pluginCount {0};
+
+	/**
+	 *  Allocated pluginList entries, freezeLock must be held
+	 */
+	size_t pluginCapacity {0};
+
+	/**
+	 *  Obtain registered plugins, must be called within a read section or with freezeLock held
+	 *
+	 *  @param count  number of registered plugins
+	 *
+	 *  @return plugin list
+	 */
+	VirtualSMCAPI::Plugin **getPlugins(size_t &count) {
+		count = atomic_load_explicit(&pluginCount, memory_order_acquire);
+		return atomic_load_explicit(&pluginList, memory_order_acquire);
+	}
+
+	/**
+	 *  Obtain declared plugin key ranges
+	 *
+	 *  @param plugin  plugin
+	 *  @param ranges  declared ranges, optional
+	 *
+	 *  @return number of declared ranges, 0 if the plugin may own any key outside of declared ranges
+	 */
+	static size_t getRanges(const VirtualSMCAPI::Plugin *plugin, const VirtualSMCAPI::KeyRange **ranges);
+
+	/**
+	 *  Check whether a plugin owns a key according to its declared ranges
+	 *
+	 *  @param plugin  plugin
+	 *  @param key     key name
+	 *
+	 *  @return true if the key is within the declared ranges, false for plugins declaring none
+	 */
+	static bool ownsKey(const VirtualSMCAPI::Plugin *plugin, SMC_KEY key);
+
+	/**
+	 *  Declared key range of a registered plugin
 	 */
-	_Atomic(VirtualSMCAPI::Plugin *) pluginData[VirtualSMCAPI::PluginMax] {};
+	struct RangeOwner {
+		VirtualSMCAPI::KeyRange range;
+		VirtualSMCAPI::Plugin *plugin;
+	};
+
+	/**
+	 *  Declared key ranges of all the registered plugins, never modified once published
+	 */
+	struct RangeTable {
+		/**
+		 *  Non-overlapping ranges sorted by their first key
+		 */
+		RangeOwner *owners {nullptr};
+
+		/**
+		 *  Number of entries in owners
+		 */
+		size_t ownerCount {0};
+	};
+
+	/**
+	 *  Currently published range table, replaced when a plugin with ranges is registered
+	 */
+	_Atomic(RangeTable *) rangeTable {nullptr};
+
+	/**
+	 *  Find the registered plugin declaring a range with the key, must be called within a read section or with freezeLock held
+	 *
+	 *  @param key  key name
+	 *
+	 *  @return owning plugin or nullptr if the key is in no declared range
+	 */
+	VirtualSMCAPI::Plugin *getRangeOwner(SMC_KEY key);
+
+	/**
+	 *  Find a registered plugin conflicting with the given one, freezeLock must be held
+	 *  Ranges must not overlap other ranges or contain keys of plugins declaring no ranges,
+	 *  and keys of plugins declaring no ranges must not be within other ranges.
+	 *
+	 *  @param plugin  plugin to check
+	 *
+	 *  @return conflicting plugin or nullptr
+	 */
+	VirtualSMCAPI::Plugin *findRangeConflict(VirtualSMCAPI::Plugin *plugin);
+
+	/**
+	 *  Check whether a sorted key storage has keys within a range
+	 *
+	 *  @param storage  sorted key storage
+	 *  @param range    key range
+	 *
+	 *  @return true if some key is within the range
+	 */
+	static bool hasKeyInRange(VirtualSMCAPI::KeyStorage &storage, const VirtualSMCAPI::KeyRange &range);
+
+	/**
+	 *  Build a range table with the ranges of another plugin added
+	 *
+	 *  @param curr    current range table, optional
+	 *  @param plugin  plugin with declared ranges
+	 *
+	 *  @return new range table or nullptr
+	 */
+	static RangeTable *createRangeTable(RangeTable *curr, VirtualSMCAPI::Plugin *plugin);
+
+	/**
+	 *  Free range table
+	 *
+	 *  @param table  range table no longer used by any reader
+	 */
+	static void deleteRangeTable(RangeTable *table);
+
+	/**
+	 *  Append a plugin to the list and publish its ranges, freezeLock must be held
+	 *
+	 *  @param plugin  plugin to register
+	 *
+	 *  @return true on success
+	 */
+	bool registerPlugin(VirtualSMCAPI::Plugin *plugin);
+
+	/**
+	 *  Key priority classes, lower values are more important
+	 */
+	enum KeyClass : uint8_t {
+		KeyClassCritical,
+		KeyClassFanControl,
+		KeyClassMonitoring,
+		KeyClassTotal
+	};
+
+	/**
+	 *  Key class table entry
+	 */
+	struct KeyClassRange {
+		VirtualSMCAPI::KeyRange range;
+		KeyClass keyClass;
+	};
+
+	/**
+	 *  Non-critical keys sorted by range, keys not listed here are critical.
+	 *  P keys are power readings except PZ, which are thermal zone throttle controls.
+	 */
+	static constexpr KeyClassRange KeyClasses[] {
+		{VirtualSMCAPI::makeKeyRange('F'), KeyClassFanControl},
+		{VirtualSMCAPI::makeKeyRange('I'), KeyClassMonitoring},
+		{{SMC_MAKE_IDENTIFIER('P', 0x00, 0x00, 0x00), SMC_MAKE_IDENTIFIER('P', 'Y', 0xFF, 0xFF)}, KeyClassMonitoring},
+		{VirtualSMCAPI::makeKeyRange('T'), KeyClassMonitoring},
+		{VirtualSMCAPI::makeKeyRange('V'), KeyClassMonitoring}
+	};
+
+	/**
+	 *  Default minimal interval between monitoring key hardware reads in milliseconds
+	 *  (configured by vsmcmonint boot-arg, 0 disables throttling).
+	 *  Throttled reads skip readAccess, which some plugins use to detect an active reader
+	 *  (e.g. SMCSuperIO rescheduling its polling), so throttling is opt-in.
+	 */
+	static constexpr uint32_t MonitoringIntervalDefault {0};
+
+	/**
+	 *  Per-class read statistics
+	 */
+	struct ClassStatistics {
+		_Atomic(uint64_t) reads;
+		_Atomic(uint64_t) throttled;
+		_Atomic(uint64_t) totalLatency;
+		_Atomic(uint64_t) maxLatency;
+	};
+
+	/**
+	 *  Read statistics for every key class
+	 */
+	ClassStatistics classStatistics[KeyClassTotal] {};
+
+	/**
+	 *  Collect per-class read statistics (configured by -vsmcstat flag), reads are not timed otherwise
+	 */
+	bool readStatistics {false};
+
+	/**
+	 *  Minimal interval between monitoring key hardware reads in nanoseconds
+	 */
+	uint64_t monitoringInterval {0};
+
+	/**
+	 *  Determine key priority class by its name
+	 *
+	 *  @param key  key name
+	 *
+	 *  @return key class
+	 */
+	static KeyClass classifyKey(SMC_KEY key);
+
+	/**
+	 *  Account a finished read in class statistics
+	 *
+	 *  @param cls        key class
+	 *  @param latency    read latency in nanoseconds
+	 *  @param throttled  read was served without hardware access
+	 */
+	void updateStatistics(KeyClass cls, uint64_t latency, bool throttled);
+
+	/**
+	 *  Last contents of a throttled monitoring key
+	 */
+	struct ReadCache {
+		_Atomic(uint32_t) seq;       // Sequence counter guarding data, see SeqLock
+		_Atomic(uint64_t) lastRead;  // Time of the read that filled data in nanoseconds, 0 if empty
+		SMC_DATA data[SMC_MAX_DATA_SIZE];
+	};
+
+	/**
+	 *  Frozen keystore entry
+	 */
+	struct FrozenKey {
+		SMC_KEY key;
+		KeyClass keyClass;
+		VirtualSMCValue *value;
+		ReadCache *cache;  // Set for monitoring keys when throttling is enabled
+	};
+
+	/**
+	 *  Frozen keystore snapshot, never modified once published
+	 */
+	struct FrozenKeys {
+		/**
+		 *  All unique keys sorted by name, public keys take precedence over hidden
+		 */
+		FrozenKey *keys {nullptr};
+
+		/**
+		 *  Number of entries in keys
+		 */
+		size_t keyCount {0};
+
+		/**
+		 *  Public key names in index order (see getByIndex)
+		 */
+		SMC_KEY *index {nullptr};
+
+		/**
+		 *  Number of entries in index
+		 */
+		size_t indexCount {0};
+
+		/**
+		 *  Read caches of throttled monitoring keys
+		 */
+		ReadCache *caches {nullptr};
+	};
+
+	/**
+	 *  Default freeze timeout in seconds (configured by vsmcfrzt boot-arg, 0 disables)
+	 */
+	static constexpr uint32_t FreezeTimeoutDefault {30};
+
+	/**
+	 *  Currently published frozen keystore snapshot if any
+	 */
+	_Atomic(FrozenKeys *) frozenKeys {nullptr};
+
+	/**
+	 *  Current reader epoch, the number of grace periods started
+	 */
+	_Atomic(uint32_t) readerEpoch {0};
+
+	/**
+	 *  Number of reader counter slots, CPUs beyond share them
+	 */
+	static constexpr size_t ReaderSlots {64};
+
+	/**
+	 *  Read sections entered and left on a CPU in even and odd epochs, padded to a cache line.
+	 *  The counters only grow, so a reader may leave on another CPU than it entered on,
+	 *  and only the sums over all the slots are meaningful.
+	 */
+	struct ReaderSlot {
+		_Atomic(uint64_t) entered[2];
+		_Atomic(uint64_t) left[2];
+		uint8_t padding[64 - 4 * sizeof(uint64_t)];
+	};
+
+	ReaderSlot readerSlots[ReaderSlots] {};
+
+	/**
+	 *  Enter lock-free read section, published snapshots and plugin values stay valid until it is left
+	 *
+	 *  @return reader epoch to pass to leaveReader
+	 */
+	uint32_t enterReader();
+
+	/**
+	 *  Leave lock-free read section
+	 *
+	 *  @param epoch  reader epoch returned by enterReader
+	 */
+	void leaveReader(uint32_t epoch);
+
+	/**
+	 *  Check whether all the read sections entered in an epoch parity are left
+	 *
+	 *  @param parity  epoch parity
+	 *
+	 *  @return true if there are no readers left
+	 */
+	bool readersDone(uint32_t parity);
+
+	/**
+	 *  Object retired by a writer, freed once no reader may use it
+	 */
+	struct Retired {
+		void *object;
+		void (*deleter)(void *object);
+		uint32_t gracePeriod;  // Grace period to complete before freeing
+	};
+
+	/**
+	 *  Retired objects waiting for their grace periods, freezeLock must be held
+	 */
+	evector<Retired &> retired;
+
+	/**
+	 *  Last completed grace period, freezeLock must be held
+	 */
+	uint32_t gracePeriodCompleted {0};
+
+	/**
+	 *  Last grace period requested by writers, freezeLock must be held
+	 */
+	uint32_t gracePeriodRequested {0};
+
+	/**
+	 *  Grace period after which no reader walks plugin storages, freezeLock must be held
+	 */
+	uint32_t storageGracePeriod {0};
+
+	/**
+	 *  Reclaim timer is pending, freezeLock must be held
+	 */
+	bool reclaimScheduled {false};
+
+	/**
+	 *  Reclaim timer interval, read sections are short, so a single wakeup is normally enough
+	 */
+	static constexpr uint32_t ReclaimIntervalMs {10};
+
+	/**
+	 *  Reclaim timer leeway for wakeup coalescing
+	 */
+	static constexpr uint32_t ReclaimLeewayMs {10};
+
+	/**
+	 *  Timer service running the reclaim timer, optional
+	 */
+	VirtualSMCTimerService *timerService {nullptr};
+
+	/**
+	 *  Request a grace period after all the read sections entered before the call, freezeLock must be held
+	 *
+	 *  @return grace period to wait for
+	 */
+	uint32_t requestGracePeriod();
+
+	/**
+	 *  Free an object after a grace period, freezeLock must be held
+	 *
+	 *  @param object   object no longer published to the readers
+	 *  @param deleter  object deleter
+	 */
+	void retire(void *object, void (*deleter)(void *object));
+
+	/**
+	 *  Free a value after a grace period, freezeLock must be held
+	 *
+	 *  @param value  value no longer published to the readers, optional
+	 */
+	void retireValue(VirtualSMCValue *value);
+
+	/**
+	 *  Advance grace periods and free the retired objects whose grace periods have completed, freezeLock must be held
+	 *  Never waits for the readers.
+	 *
+	 *  @return true if some grace period is still pending
+	 */
+	bool reclaim();
+
+	/**
+	 *  Reclaim now and arm the reclaim timer while grace periods are pending, freezeLock must not be held
+	 */
+	void scheduleReclaim();
+
+	/**
+	 *  Reclaim timer action
+	 *
+	 *  @param context  keystore
+	 */
+	static void reclaimAction(void *context);
+
+	/**
+	 *  Sleep until a grace period completes, freezeLock must not be held
+	 *
+	 *  @param gracePeriod  grace period returned by requestGracePeriod
+	 */
+	void waitGracePeriod(uint32_t gracePeriod);
+
+	/**
+	 *  Lookup a key in a frozen snapshot
+	 *
+	 *  @param frozen  frozen snapshot
+	 *  @param name    key name
+	 *
+	 *  @return snapshot entry or nullptr
+	 */
+	static FrozenKey *findFrozen(FrozenKeys *frozen, SMC_KEY name);
+
+	/**
+	 *  Free frozen snapshot
+	 *
+	 *  @param frozen  frozen snapshot no longer used by any reader
+	 */
+	static void deleteFrozen(FrozenKeys *frozen);
+
+	/**
+	 *  Freeze and plugin count access lock
+	 */
+	IOLock *freezeLock {nullptr};
+
+	/**
+	 *  Plugin key update lock, held while waiting for the readers of plugin storages without freezeLock
+	 */
+	IOLock *updateLock {nullptr};
+
+	/**
+	 *  Number of plugins after which the keystore is frozen (configured by vsmcfrzq boot-arg, 0 disables)
+	 */
+	uint32_t freezeQuorum {0};
+
+	/**
+	 *  Freeze timeout in seconds
+	 */
+	uint32_t freezeTimeout {FreezeTimeoutDefault};
+
+	/**
+	 *  Number of successfully loaded plugins
+	 */
+	uint32_t loadedPlugins {0};
+
+	/**
+	 *  Build and publish a new frozen snapshot, freezeLock must be held
+	 *  The previous snapshot is retired, see scheduleReclaim.
+	 */
+	void rebuildFrozen();
+
+	/**
+	 *  Return to regular lookups and retire the frozen snapshot, freezeLock must be held
+	 */
+	void unpublishFrozen();
 
 	/**
 	 *  Quick access pointers to access keys necessary used for r/w privilege management
@@ -179,6 +652,18 @@ class VirtualSMCKeystore {
 	 */
 	SMC_RESULT getByIndex(SMC_KEY_INDEX idx, VirtualSMCKeyValue *&val);
 
+	/**
+	 *  Get current value for a key in the keystore, public keys are looked up first.
+	 *  Uses the frozen snapshot when available.
+	 *
+	 *  @param name    key name
+	 *  @param value   resulting value
+	 *  @param frozen  resulting frozen entry if found in the snapshot, optional
+	 *
+	 *  @return SmcSuccess if the value was found
+	 */
+	SMC_RESULT getValueByName(SMC_KEY name, VirtualSMCValue *&value, FrozenKey **frozen=nullptr);
+
 	/**
 	 *  Add key to the keystore
 	 *
@@ -276,20 +761,22 @@ public:
 	 *  @param  board      current board-id if present, otherwise nullptr
 	 *  @param  model      computer model except any, see WIOKit::ComputerModel
 	 *  @param  whbkp      allow hbkp usage
+	 *  @param  timers     timer service for freeing retired snapshots, optional
 	 *
 	 *  @return true on success
 	 */
-	bool init(const OSDictionary *mainprops, const OSDictionary *userprops, const SMCInfo &info, const char *board, int model, bool whibkey);
+	bool init(const OSDictionary *mainprops, const OSDictionary *userprops, const SMCInfo &info, const char *board, int model, bool whibkey, VirtualSMCTimerService *timers);
 
 	/**
 	 *  Obtain key value from the keystore by its name
 	 *
 	 *  @param name    key name
-	 *  @param val     resulting value
+	 *  @param data    data buffer for the value (equal or bigger than SMC_MAX_DATA_SIZE)
+	 *  @param size    resulting value size
 	 *
 	 *  @return SmcSuccess if the value was found, was read-accessible, and the data was read
 	 */
-	SMC_RESULT readValueByName(SMC_KEY name, const VirtualSMCValue *&value);
+	SMC_RESULT readValueByName(SMC_KEY name, SMC_DATA *data, SMC_DATA_SIZE &size) override;
 
 	/**
 	 *  Obtain key value from the keystore by its index
@@ -299,7 +786,7 @@ public:
 	 *
 	 *  @return SmcSuccess if the value was found, was read-accessible, and the data was read
 	 */
-	SMC_RESULT readNameByIndex(SMC_KEY_INDEX idx, SMC_KEY &key);
+	SMC_RESULT readNameByIndex(SMC_KEY_INDEX idx, SMC_KEY &key) override;
 
 	/**
 	 *  Set key value in the keystore by its name
@@ -309,7 +796,7 @@ public:
 	 *
 	 *  @return SmcSuccess if the value was found, was write-accessible, and the data was written
 	 */
-	SMC_RESULT writeValueByName(SMC_KEY name, const SMC_DATA *data);
+	SMC_RESULT writeValueByName(SMC_KEY name, const SMC_DATA *data) override;
 
 	/**
 	 *  Obtain key information from the keystore by its name
@@ -321,7 +808,7 @@ public:
 	 *
 	 *  @return SmcSuccess if the value was found and size, type, and attr variables were updated
 	 */
-	SMC_RESULT getInfoByName(SMC_KEY name, SMC_DATA_SIZE &size, SMC_KEY_TYPE &type, SMC_KEY_ATTRIBUTES &attr);
+	SMC_RESULT getInfoByName(SMC_KEY name, SMC_DATA_SIZE &size, SMC_KEY_TYPE &type, SMC_KEY_ATTRIBUTES &attr) override;
 
 	/**
 	 *  Get total number of publicly available keys
@@ -349,6 +836,41 @@ public:
 	 */
 	IOReturn loadPlugin(VirtualSMCAPI::Plugin *plugin);
 
+	/**
+	 *  Add and remove loaded plugin keys, see VirtualSMCAPI::updateKeys
+	 *
+	 *  @param plugin      loaded plugin pointer
+	 *  @param data        sorted public keys to add, consumed
+	 *  @param dataHidden  sorted hidden keys to add, consumed
+	 *  @param removed     plugin keys to remove
+	 *  @param removedNum  number of keys to remove
+	 *
+	 *  @return kIOReturnSuccess on success
+	 */
+	IOReturn updatePlugin(VirtualSMCAPI::Plugin *plugin, VirtualSMCAPI::KeyStorage &data, VirtualSMCAPI::KeyStorage &dataHidden, const SMC_KEY *removed, size_t removedNum);
+
+	/**
+	 *  Compact all key storages into a read-only snapshot used for lookups.
+	 *  Plugins loaded afterwards cause the snapshot to be rebuilt.
+	 */
+	void freeze();
+
+	/**
+	 *  Obtain freeze timeout
+	 *
+	 *  @return timeout in seconds or 0 if disabled
+	 */
+	uint32_t getFreezeTimeout() {
+		return freezeTimeout;
+	}
+
+	/**
+	 *  Create per-class read statistics dictionary for the registry
+	 *
+	 *  @return dictionary (must be released) or nullptr
+	 */
+	OSDictionary *createStatistics();
+
 	/**
 	 *  Obtain device info
 	 *
@@ -7,9 +7,9 @@
 
 #include <Headers/kern_util.hpp>
 #include <Headers/kern_mach.hpp>
+#include <Headers/kern_patcher.hpp>
 #include <libkern/OSByteOrder.h>
 
-#include "kern_vsmc.hpp"
 #include "kern_mmio.hpp"
 
 const SMCInfo::Memory SMCProtocolMMIO::MemoryInfo[] {
@@ -24,6 +24,10 @@ static_assert(0x10000 == SMCProtocolMMIO::WindowAllocSize, "MMIO area has unexpe
 static_assert(0x01000 == PAGE_SIZE, "PAGE_SIZE has unexpected size");
 
 void SMCProtocolMMIO::submitData() {
+	// Only publish the new data and clear whatever remains from the previous transaction,
+	// dataBuffer is guaranteed to be zeroed past dataSize.
+	SMC_DATA_SIZE dirtySize = dataSize > publishedDataSize ? dataSize : publishedDataSize;
+
 	if (MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock) == KERN_SUCCESS) {
 		mmioWrite<SMC_KEY, SMC_MMIO_WRITE_KEY>(0);
 		
@@ -34,9 +38,11 @@ void SMCProtocolMMIO::submitData() {
 		static_assert(SMC_MMIO_WRITE_COMMAND == SMC_MMIO_READ_RESULT, "Write Command is uncleared");
 		
 		mmioWrite<SMC_DATA_SIZE, SMC_MMIO_WRITE_DATA_SIZE>(dataSize);
-		lilu_os_memcpy(mmioPtr<SMC_DATA, 0>(), dataBuffer, SMC_MAX_DATA_SIZE);
+		if (dirtySize > 0)
+			lilu_os_memcpy(mmioPtr<SMC_DATA, 0>(), dataBuffer, dirtySize);
 		
 		MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
+		publishedDataSize = dataSize;
 	}
 
 	if (dataSize != 0) {
@@ -45,7 +51,7 @@ void SMCProtocolMMIO::submitData() {
 	}
 	
 	currentStatus = SMC_STATUS_KEY_DONE;
-	VirtualSMC::postInterrupt(SmcEventKeyDone);
+	events->postInterrupt(SmcEventKeyDone);
 }
 
 void SMCProtocolMMIO::handleRead(mach_vm_address_t base, mach_vm_address_t addr) {
@@ -54,18 +60,71 @@ void SMCProtocolMMIO::handleRead(mach_vm_address_t base, mach_vm_address_t addr)
 
 	if (off == SMC_MMIO_READ_KEY_STATUS) {
 		mmioBase = base;
-		
-		mmioWrite<SMC_STATUS, SMC_MMIO_READ_KEY_STATUS>(currentStatus);
-		currentStatus = 0;
+		mmioWrite<SMC_STATUS, SMC_MMIO_READ_KEY_STATUS>(consumeStatus(off));
 	} else if (off == SMC_MMIO_READ_EVENT_STATUS) {
 		mmioBase = base;
-		
-		auto code = VirtualSMC::getInterrupt();
+		mmioWrite<SMC_STATUS, SMC_MMIO_READ_EVENT_STATUS>(consumeStatus(off));
+	}
+}
+
+SMC_STATUS SMCProtocolMMIO::consumeStatus(uint32_t off) {
+	SMC_STATUS status;
+	if (off == SMC_MMIO_READ_KEY_STATUS) {
+		status = currentStatus;
+		currentStatus = 0;
+	} else {
+		auto code = events->getInterrupt();
 		if (code == SmcEventKeyDone)
 			currentStatus = 0;
-		mmioWrite<SMC_STATUS, SMC_MMIO_READ_EVENT_STATUS>(currentEventStatus);
+		status = currentEventStatus;
 		currentEventStatus = 0;
 	}
+	return status;
+}
+
+uint8_t SMCProtocolMMIO::directRead(mach_vm_address_t base, uint32_t off) {
+	if (!isDirectRegister(off))
+		PANIC("mmio", "direct read from invalid offset %08X", off);
+
+	mmioBase = base;
+
+	if (off == SMC_MMIO_READ_KEY_STATUS || off == SMC_MMIO_READ_EVENT_STATUS)
+		return consumeStatus(off);
+
+	// Status area is kept unmapped for trapping, and it has nothing else to read.
+	if (off >= SMC_MMIO_READ_EVENT_STATUS)
+		return 0;
+
+	return *reinterpret_cast<uint8_t *>(base + off);
+}
+
+void SMCProtocolMMIO::directWrite(mach_vm_address_t base, uint32_t off, uint8_t value) {
+	if (!isDirectRegister(off))
+		PANIC("mmio", "direct write to invalid offset %08X", off);
+
+	// Status area is kept unmapped for trapping, writes to it are ignored.
+	if (off >= SMC_MMIO_READ_EVENT_STATUS) {
+		DBGLOG("mmio", "direct write to status register %08X", off);
+		return;
+	}
+
+	// Key, size, attributes and data only matter to the command, which publishes its reply in a single window.
+	if (off <= SMC_MMIO_WRITE_COMMAND) {
+		directRequest[off] = value;
+		if (off == SMC_MMIO_WRITE_COMMAND) {
+			mmioBase = base;
+			requestBase = reinterpret_cast<mach_vm_address_t>(directRequest);
+			processCommand();
+		}
+		return;
+	}
+
+	if (MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock) == KERN_SUCCESS) {
+		*reinterpret_cast<uint8_t *>(base + off) = value;
+		MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
+	}
+
+	handleWrite(base, base + off);
 }
 
 void SMCProtocolMMIO::handleWrite(mach_vm_address_t base, mach_vm_address_t addr) {
@@ -73,43 +132,64 @@ void SMCProtocolMMIO::handleWrite(mach_vm_address_t base, mach_vm_address_t addr
 	DBGLOG("mmio", "write access at %08X", off);
 	
 	if (off == SMC_MMIO_WRITE_COMMAND) {
-		mmioBase = base;
-		
-		auto cmd = mmioRead<SMC_COMMAND, SMC_MMIO_WRITE_COMMAND>();
-		switch (cmd) {
-			case SmcCmdReadValue:
-				readValue();
-				break;
-			case SmcCmdWriteValue:
-				writeValue();
-				break;
-			case SmcCmdGetKeyFromIndex:
-				getKeyFromIndex();
-				break;
-			case SmcCmdGetKeyInfo:
-				getKeyInfo();
-				break;
-			case SmcCmdReset:
-				reset();
-				break;
-			default:
-				SYSLOG("mmio", "io got unsupported cmd %02X", cmd);
-				currentResult = SmcBadCommand;
-		}
-		
-		submitData();
+		mmioBase = requestBase = base;
+		processCommand();
+	} else if (off < SMC_MAX_DATA_SIZE) {
+		// The host may write past the value size it declares, and the store width is unknown here.
+		// Clear the whole data area with the next reply.
+		publishedDataSize = SMC_MAX_DATA_SIZE;
+	} else if (off >= SMC_MMIO_READ_LOG && off < SMC_MMIO_READ_LOG + SMC_MAX_LOG_SIZE) {
+		publishedLogSize = SMC_MAX_LOG_SIZE;
+	}
+}
+
+void SMCProtocolMMIO::processCommand() {
+	auto cmd = mmioRead<SMC_COMMAND, SMC_MMIO_WRITE_COMMAND>();
+	switch (cmd) {
+		case SmcCmdReadValue:
+			readValue();
+			break;
+		case SmcCmdWriteValue:
+			writeValue();
+			break;
+		case SmcCmdGetKeyFromIndex:
+			getKeyFromIndex();
+			break;
+		case SmcCmdGetKeyInfo:
+			getKeyInfo();
+			break;
+		case SmcCmdReset:
+			reset();
+			break;
+		default:
+			SYSLOG("mmio", "io got unsupported cmd %02X", cmd);
+			currentResult = SmcBadCommand;
 	}
+
+	if (recorder) {
+		SMC_KEY key = mmioRead<SMC_KEY, SMC_MMIO_WRITE_KEY>();
+		SMC_DATA_SIZE size = dataSize;
+		if (cmd == SmcCmdGetKeyFromIndex)
+			key = currentResult == SmcSuccess ? *reinterpret_cast<SMC_KEY *>(dataBuffer) : 0;
+		else if (cmd == SmcCmdWriteValue)
+			size = mmioRead<SMC_DATA_SIZE, SMC_MMIO_WRITE_DATA_SIZE>();
+		recorder->record(SMCTransactionRecorder::ProtocolMMIO, cmd, key, size, currentResult);
+	}
+
+	submitData();
 }
 
 void SMCProtocolMMIO::setInterrupt(SMC_EVENT_CODE code, const void *data, size_t size) {
 	//TODO: Actually reverse AppleSMC::smcHandleInterruptEvent
 	if (code == SmcEventLogMessage) {
 		if (MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock) == KERN_SUCCESS) {
-			auto writtenSize = size > SMC_MAX_LOG_SIZE ? SMC_MAX_DATA_SIZE : size;
+			auto writtenSize = size > SMC_MAX_LOG_SIZE ? SMC_MAX_LOG_SIZE : size;
 			lilu_os_memcpy(mmioPtr<SMC_LOG, SMC_MMIO_READ_LOG>(), data, writtenSize);
-			if (writtenSize < SMC_MAX_LOG_SIZE)
-				bzero(mmioPtr<SMC_LOG, SMC_MMIO_READ_LOG>() + writtenSize, SMC_MAX_LOG_SIZE-writtenSize);
+			// Only clear the remainder of the previous message.
+			if (writtenSize < publishedLogSize)
+				bzero(mmioPtr<SMC_LOG, SMC_MMIO_READ_LOG>() + writtenSize, publishedLogSize-writtenSize);
 			MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
+			publishedLogSize = writtenSize;
 		}
 		currentEventStatus = SMC_STATUS_KEY_DONE;
 	} else if (code == SmcEventKeyDone) {
@@ -126,13 +206,9 @@ void SMCProtocolMMIO::readValue() {
 	auto attr = mmioRead<SMC_KEY_ATTRIBUTES, SMC_MMIO_WRITE_KEY_ATTRIBUTES>();
 	
 	if (attr == 0) {
-		const VirtualSMCValue *value {nullptr};
-		currentResult = VirtualSMC::getKeystore()->readValueByName(key, value);
-		if (currentResult == SmcSuccess) {
-			auto src = value->get(dataSize);
-			lilu_os_memcpy(dataBuffer, src, dataSize);
+		currentResult = keystore->readValueByName(key, dataBuffer, dataSize);
+		if (currentResult == SmcSuccess)
 			return;
-		}
 	} else {
 		DBGLOG("mmio", "read got non-zero attr %02X", attr);
 		currentResult = SmcBadCommand;
@@ -146,7 +222,7 @@ void SMCProtocolMMIO::writeValue() {
 	
 	if (attr == 0) {
 		if (size <= SMC_MAX_DATA_SIZE)
-			currentResult = VirtualSMC::getKeystore()->writeValueByName(key, mmioPtr<SMC_DATA, 0>());
+			currentResult = keystore->writeValueByName(key, requestPtr<SMC_DATA, 0>());
 		else
 			currentResult = SmcKeySizeMismatch;
 	} else {
@@ -161,7 +237,7 @@ void SMCProtocolMMIO::getKeyFromIndex() {
 	
 	if (attr == 0) {
 		SMC_KEY key;
-		currentResult = VirtualSMC::getKeystore()->readNameByIndex(OSSwapInt32(index), key);
+		currentResult = keystore->readNameByIndex(OSSwapInt32(index), key);
 		if (currentResult == SmcSuccess) {
 			dataSize = sizeof(SMC_KEY);
 			lilu_os_memcpy(dataBuffer, &key, dataSize);
@@ -179,13 +255,15 @@ void SMCProtocolMMIO::getKeyInfo() {
 	if (attr == 0) {
 		SMC_DATA_SIZE size;
 		SMC_KEY_TYPE type;
-		currentResult = VirtualSMC::getKeystore()->getInfoByName(key, size, type, attr);
+		currentResult = keystore->getInfoByName(key, size, type, attr);
 		if (currentResult == SmcSuccess) {
 			KeyInfo info {};
 			info.type = type;
 			info.size = size;
 			info.attr = attr;
-			lilu_os_memcpy(dataBuffer, &info, sizeof(info));
+			// Track the size, so that submitData clears it afterwards.
+			dataSize = sizeof(info);
+			lilu_os_memcpy(dataBuffer, &info, dataSize);
 		}
 	} else {
 		DBGLOG("mmio", "getkeyinfo got non-zero attr %02X", attr);
@@ -12,6 +12,9 @@
 #include <VirtualSMCSDK/AppleSmcBridge.hpp>
 #include <VirtualSMCSDK/kern_smcinfo.hpp>
 
+#include "kern_protocol.hpp"
+#include "kern_record.hpp"
+
 class SMCProtocolMMIO {
 	/**
 	 *  Key info
@@ -23,10 +26,31 @@ class SMCProtocolMMIO {
 		SMC_KEY_ATTRIBUTES attr {};
 	};
 
+	/**
+	 *  Keystore serving the requests
+	 */
+	SMCProtocolKeystore *keystore {nullptr};
+
+	/**
+	 *  Interrupt delivery for command completion
+	 */
+	SMCProtocolEvents *events {nullptr};
+
 	/**
 	 *  Mapped device memory base
 	 */
 	mach_vm_address_t mmioBase {};
+
+	/**
+	 *  Registers written by the host for the current command, device memory base or directRequest
+	 */
+	mach_vm_address_t requestBase {};
+
+	/**
+	 *  Host register writes in direct-call mode, laid out as the device memory up to the command register.
+	 *  Only the command consumes them, so they are never published, and its reply replaces them anyway.
+	 */
+	alignas(SMC_KEY) uint8_t directRequest[SMC_MMIO_WRITE_COMMAND + 1] {};
 	
 	/**
 	 *  Device response if any
@@ -45,15 +69,31 @@ class SMCProtocolMMIO {
 	
 	/**
 	 *  Device data buffer, contains prepared return data
-	 *  All the values seem to fit 32 bytes
+	 *  All the values seem to fit 32 bytes. Keys are read from its start.
 	 */
-	SMC_DATA dataBuffer[SMC_MAX_DATA_SIZE] {};
+	alignas(SMC_KEY) SMC_DATA dataBuffer[SMC_MAX_DATA_SIZE] {};
 	
 	/**
 	 *  Device data buffer size
 	 */
 	SMC_DATA_SIZE dataSize {};
 
+	/**
+	 *  Amount of device memory data area bytes that may be non-zero (published by us or written by the host)
+	 *  Starts with the full area, as its contents are unknown until the first submission.
+	 */
+	SMC_DATA_SIZE publishedDataSize {SMC_MAX_DATA_SIZE};
+
+	/**
+	 *  Amount of device memory log area bytes that may be non-zero (published by us or written by the host)
+	 */
+	size_t publishedLogSize {SMC_MAX_LOG_SIZE};
+
+	/**
+	 *  Transaction recorder if enabled
+	 */
+	SMCTransactionRecorder *recorder {nullptr};
+
 	/**
 	 *  Get typed pointer to the device memory area
 	 *
@@ -68,7 +108,20 @@ class SMCProtocolMMIO {
 	}
 
 	/**
-	 *  Read value from device memory area
+	 *  Get typed pointer to the registers written by the host for the current command
+	 *
+	 *  @param T  pointer type
+	 *  @param O  mmio offset
+	 *
+	 *  @return request register pointer of type T at offset O
+	 */
+	template <typename T, uint32_t O>
+	const T *requestPtr() {
+		return reinterpret_cast<const T *>(requestBase + O);
+	}
+
+	/**
+	 *  Read value written by the host for the current command
 	 *
 	 *  @param T  pointer type
 	 *  @param O  mmio offset
@@ -77,7 +130,7 @@ class SMCProtocolMMIO {
 	 */
 	template <typename T, uint32_t O>
 	T mmioRead() {
-		return *mmioPtr<T, O>();
+		return *requestPtr<T, O>();
 	}
 
 	/**
@@ -97,6 +150,20 @@ class SMCProtocolMMIO {
 	 */
 	void submitData();
 
+	/**
+	 *  Execute the command in the command register, record it and submit the reply
+	 */
+	void processCommand();
+
+	/**
+	 *  Obtain status register value and reset it as the hardware does on read
+	 *
+	 *  @param off  SMC_MMIO_READ_KEY_STATUS or SMC_MMIO_READ_EVENT_STATUS
+	 *
+	 *  @return status value
+	 */
+	SMC_STATUS consumeStatus(uint32_t off);
+
 	/**
 	 *  Handle SmcCmdReadValue command
 	 */
@@ -123,6 +190,14 @@ class SMCProtocolMMIO {
 	void reset();
 
 public:
+
+	/**
+	 *  Create protocol implementation bound to a keystore and an interrupt controller.
+	 *
+	 *  @param store   keystore to serve the requests from
+	 *  @param sink    interrupt delivery for command completion
+	 */
+	SMCProtocolMMIO(SMCProtocolKeystore *store, SMCProtocolEvents *sink) : keystore(store), events(sink) {}
 	
 	/**
 	 *  Protocol i/o area size
@@ -169,6 +244,40 @@ public:
 	 *  @param addr  actual read address in mmio virtual region
 	 */
 	void handleWrite(mach_vm_address_t base, mach_vm_address_t addr);
+
+	/**
+	 *  Check whether a direct-call accessor offset is an mmio register we serve.
+	 *  AppleSMC uses the same accessors with i/o ports (SMC_PORT_BASE and up) when
+	 *  it talks over pmio, these must go to the original accessor.
+	 *
+	 *  @param off  accessor offset
+	 *
+	 *  @return true for offsets in the data, key, command and log area or the status registers
+	 */
+	static constexpr bool isDirectRegister(uint32_t off) {
+		return off < SMC_MMIO_READ_LOG + SMC_MAX_LOG_SIZE ||
+			(off >= SMC_MMIO_READ_EVENT_STATUS && off <= SMC_MMIO_READ_KEY_STATUS);
+	}
+
+	/**
+	 *  Perform a register read without trapping (direct-call mode)
+	 *
+	 *  @param base  mmio virtual region base address
+	 *  @param off   register offset in mmio virtual region, must satisfy isDirectRegister
+	 *
+	 *  @return register value
+	 */
+	uint8_t directRead(mach_vm_address_t base, uint32_t off);
+
+	/**
+	 *  Perform a register write without trapping (direct-call mode)
+	 *  Request registers are buffered until the command register is written, and are never published.
+	 *
+	 *  @param base   mmio virtual region base address
+	 *  @param off    register offset in mmio virtual region, must satisfy isDirectRegister
+	 *  @param value  register value
+	 */
+	void directWrite(mach_vm_address_t base, uint32_t off, uint8_t value);
 	
 	/**
 	 *  Prepare for interrupt handling
@@ -178,6 +287,15 @@ public:
 	 *  @param dataSize event data size (optional)
 	 */
 	void setInterrupt(SMC_EVENT_CODE code, const void *data, size_t dataSize);
+
+	/**
+	 *  Enable transaction recording
+	 *
+	 *  @param rec  transaction recorder
+	 */
+	void setRecorder(SMCTransactionRecorder *rec) {
+		recorder = rec;
+	}
 };
 
 #endif /* kern_mmio_hpp */
@@ -7,7 +7,6 @@
 
 #include <Headers/kern_util.hpp>
 
-#include "kern_vsmc.hpp"
 #include "kern_pmio.hpp"
 
 const SMCInfo::Memory SMCProtocolPMIO::MemoryInfo[] {
@@ -27,41 +26,53 @@ void SMCProtocolPMIO::resetDevice() {
 }
 
 void SMCProtocolPMIO::resetBuffer() {
-	bzero(dataBuffer, dataSize);
+	// Contents are left as is, only the first dataSize bytes are ever exposed or consumed.
+	if (dataSize > dirtySize)
+		dirtySize = dataSize;
 	dataIndex = dataSize = 0;
 }
 
 void SMCProtocolPMIO::loadValueInBuffer() {
 	resetBuffer();
-	const VirtualSMCValue *value {nullptr};
-	currentResult = VirtualSMC::getKeystore()->readValueByName(currentKey, value);
+	currentResult = keystore->readValueByName(currentKey, dataBuffer, dataSize);
 	if (currentResult == SmcSuccess) {
-		auto src = value->get(dataSize);
 		if (dataSize == currentSize) {
-			lilu_os_memcpy(dataBuffer, src, dataSize);
+			recordTransaction(currentKey);
 			return;
 		}
+		if (dataSize > dirtySize)
+			dirtySize = dataSize;
 		currentResult = SmcKeySizeMismatch;
 	}
 	
-	dataSize = currentSize;
-	bzero(dataBuffer, dataSize > SMC_MAX_DATA_SIZE ? SMC_MAX_DATA_SIZE : dataSize);
+	// Requested size comes from the guest and must never exceed the buffer, as readData trusts dataSize.
+	dataSize = currentSize > SMC_MAX_DATA_SIZE ? SMC_MAX_DATA_SIZE : currentSize;
+	bzero(dataBuffer, dataSize);
+	recordTransaction(currentKey);
 }
 
 void SMCProtocolPMIO::loadKeyInBuffer() {
 	resetBuffer();
 	SMC_KEY key;
 	dataSize = sizeof(SMC_KEY);
-	currentResult = VirtualSMC::getKeystore()->readNameByIndex(currentKeyIndex, key);
+	currentResult = keystore->readNameByIndex(currentKeyIndex, key);
 	if (currentResult == SmcSuccess) {
 		lilu_os_memcpy(dataBuffer, &key, dataSize);
 	} else {
+		key = 0;
 		bzero(dataBuffer, dataSize);
 	}
+	recordTransaction(key);
 }
 
 void SMCProtocolPMIO::saveValueFromBuffer() {
-	currentResult = VirtualSMC::getKeystore()->writeValueByName(currentKey, dataBuffer);
+	// Keystore consumes the whole value, which may be longer than the data received.
+	// Erase the tail left by the previous transactions, so that their bytes are not written instead.
+	if (dataSize < dirtySize)
+		bzero(dataBuffer + dataSize, dirtySize - dataSize);
+	dirtySize = dataSize;
+	currentResult = keystore->writeValueByName(currentKey, dataBuffer);
+	recordTransaction(currentKey);
 	resetBuffer();
 }
 
@@ -71,7 +82,7 @@ void SMCProtocolPMIO::loadKeyInfoInBuffer() {
 	SMC_KEY_TYPE type;
 	SMC_KEY_ATTRIBUTES attr;
 	dataSize = sizeof(KeyInfo);
-	currentResult = VirtualSMC::getKeystore()->getInfoByName(currentKey, size, type, attr);
+	currentResult = keystore->getInfoByName(currentKey, size, type, attr);
 	if (currentResult == SmcSuccess) {
 		KeyInfo info {};
 		info.type = type;
@@ -81,17 +92,20 @@ void SMCProtocolPMIO::loadKeyInfoInBuffer() {
 	} else {
 		bzero(dataBuffer, dataSize);
 	}
+	recordTransaction(currentKey);
 }
 
 void SMCProtocolPMIO::writeData(uint8_t v) {
 	// Any i/o removes got command flag
 	currentStatus &= ~SMC_STATUS_GOT_COMMAND;
 	
-	// Ignore any further writing and hope for device reset by a cmd
+	// Ignore any further writing and hope for device reset by a cmd.
+	// Keep the first error of the transaction, e.g. SmcKeySizeMismatch for the value bytes following it.
 	if (dataSize >= SMC_MAX_DATA_SIZE) {
 		DBGTRACE("pmio", "writedata detected oob write %u to %u", dataSize, SMC_MAX_DATA_SIZE);
 		//FIXME: find correct result
-		currentResult = SmcSpuriousData;
+		if (currentResult == SmcSuccess)
+			currentResult = SmcSpuriousData;
 		return;
 	}
 	
@@ -99,7 +113,8 @@ void SMCProtocolPMIO::writeData(uint8_t v) {
 	if (currentStatus != (SMC_STATUS_READY | SMC_STATUS_BUSY)) {
 		DBGTRACE("pmio", "writedata invalid status %X", currentStatus);
 		//FIXME: find correct result
-		currentResult = SmcCommCollision;
+		if (currentResult == SmcSuccess)
+			currentResult = SmcCommCollision;
 		return;
 	}
 	
@@ -124,6 +139,12 @@ void SMCProtocolPMIO::writeData(uint8_t v) {
 				currentKey = reinterpret_cast<KeyValue *>(dataBuffer)->key;
 				currentSize = reinterpret_cast<KeyValue *>(dataBuffer)->size;
 				resetBuffer();
+				// Value would never fit the buffer, fail now instead of on the first extra byte.
+				if (currentSize > SMC_MAX_DATA_SIZE) {
+					DBGTRACE("pmio", "writedata value size %u over %u", currentSize, SMC_MAX_DATA_SIZE);
+					currentStatus = SMC_STATUS_READY;
+					currentResult = SmcKeySizeMismatch;
+				}
 			}
 			break;
 			
@@ -236,7 +257,14 @@ SMC_RESULT SMCProtocolPMIO::readResult() {
 	return currentResult;
 }
 
+SMC_EVENT_CODE SMCProtocolPMIO::readEvent() {
+	// The sink hands the consumed code back through setInterrupt.
+	return events ? events->getInterrupt() : 0;
+}
+
 void SMCProtocolPMIO::setInterrupt(SMC_EVENT_CODE code, const void *data, size_t dataSize) {
-	//TODO: properly implement PMIO interrupts
-	currentStatus = SMC_STATUS_READY;
+	// Events are delivered through the event port and must not disturb a transaction in progress.
+	// There is no log area in port i/o, so log messages only carry the event code.
+	if (code == SmcEventLogMessage && data && dataSize > 0)
+		DBGLOG("pmio", "log event %.*s", static_cast<int>(dataSize > SMC_MAX_LOG_SIZE ? SMC_MAX_LOG_SIZE : dataSize), static_cast<const char *>(data));
 }
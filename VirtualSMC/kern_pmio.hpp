@@ -11,7 +11,25 @@
 #include <VirtualSMCSDK/AppleSmcBridge.hpp>
 #include <VirtualSMCSDK/kern_smcinfo.hpp>
 
+#include "kern_protocol.hpp"
+#include "kern_record.hpp"
+
 class SMCProtocolPMIO {
+	/**
+	 *  Keystore serving the requests
+	 */
+	SMCProtocolKeystore *keystore {nullptr};
+
+	/**
+	 *  Interrupt delivery consumed through the event port
+	 */
+	SMCProtocolEvents *events {nullptr};
+
+	/**
+	 *  Transaction recorder if enabled
+	 */
+	SMCTransactionRecorder *recorder {nullptr};
+
 	/**
 	 *  Key info
 	 */
@@ -61,9 +79,9 @@ class SMCProtocolPMIO {
 	
 	/**
 	 *  Device data buffer, contains any i/o information (keys, values, etc.)
-	 *  All the values seem to fit 32 bytes
+	 *  All the values seem to fit 32 bytes. Keys and indices are read from its start.
 	 */
-	SMC_DATA dataBuffer[SMC_MAX_DATA_SIZE] {};
+	alignas(SMC_KEY) SMC_DATA dataBuffer[SMC_MAX_DATA_SIZE] {};
 	
 	/**
 	 *  Device data buffer position relevant for i/o
@@ -74,6 +92,11 @@ class SMCProtocolPMIO {
 	 *  Device data buffer size
 	 */
 	SMC_DATA_SIZE dataSize {};
+
+	/**
+	 *  Amount of device data buffer bytes that may be non-zero, past it the buffer is zeroed
+	 */
+	SMC_DATA_SIZE dirtySize {};
 	
 	/**
 	 *  Completely resets device state
@@ -81,7 +104,7 @@ class SMCProtocolPMIO {
 	void resetDevice();
 	
 	/**
-	 *  Resets device data buffer and erases it
+	 *  Resets device data buffer position and size without erasing it
 	 */
 	void resetBuffer();
 	
@@ -105,7 +128,35 @@ class SMCProtocolPMIO {
 	 */
 	void loadKeyInfoInBuffer();
 
+	/**
+	 *  Record current transaction if recording is enabled
+	 *
+	 *  @param key  processed key
+	 */
+	void recordTransaction(SMC_KEY key) {
+		if (recorder)
+			recorder->record(SMCTransactionRecorder::ProtocolPMIO, currentCommand, key, dataSize, currentResult);
+	}
+
 public:
+
+	/**
+	 *  Create protocol implementation bound to a keystore and optionally an interrupt controller.
+	 *  The protocol has no other dependencies and may be driven by any port i/o source.
+	 *
+	 *  @param store  keystore to serve the requests from
+	 *  @param sink   interrupt delivery read through the event port
+	 */
+	explicit SMCProtocolPMIO(SMCProtocolKeystore *store, SMCProtocolEvents *sink = nullptr) : keystore(store), events(sink) {}
+
+	/**
+	 *  Enable transaction recording
+	 *
+	 *  @param rec  transaction recorder
+	 */
+	void setRecorder(SMCTransactionRecorder *rec) {
+		recorder = rec;
+	}
 	
 	/**
 	 *  Protocol i/o area size
@@ -166,6 +217,13 @@ public:
 	 *  @return device response
 	 */
 	SMC_RESULT readResult();
+
+	/**
+	 *  Read operation on event port, consumes the next pending interrupt
+	 *
+	 *  @return event code or 0 if nothing is pending
+	 */
+	SMC_EVENT_CODE readEvent();
 	
 	/**
 	 *  Prepare for interrupt handling
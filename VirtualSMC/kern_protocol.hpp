@@ -0,0 +1,95 @@
+//
+//  kern_protocol.hpp
+//  VirtualSMC
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_protocol_hpp
+#define kern_protocol_hpp
+
+#include <VirtualSMCSDK/AppleSmcBridge.hpp>
+
+/**
+ *  Keystore operations the SMC protocols are served from.
+ *  This header must not depend on IOKit or Lilu, so that the protocol
+ *  implementations could be built against a userspace keystore (see Tests).
+ */
+class SMCProtocolKeystore {
+public:
+	/**
+	 *  Obtain key value by its name
+	 *
+	 *  @param name    key name
+	 *  @param data    data buffer for the value (equal or bigger than SMC_MAX_DATA_SIZE)
+	 *  @param size    resulting value size
+	 *
+	 *  @return SmcSuccess if the value was found, was read-accessible, and the data was read
+	 */
+	virtual SMC_RESULT readValueByName(SMC_KEY name, SMC_DATA *data, SMC_DATA_SIZE &size) = 0;
+
+	/**
+	 *  Obtain key name by its index
+	 *
+	 *  @param idx     index of an entry
+	 *  @param key     resulting key name
+	 *
+	 *  @return SmcSuccess if the key was found
+	 */
+	virtual SMC_RESULT readNameByIndex(SMC_KEY_INDEX idx, SMC_KEY &key) = 0;
+
+	/**
+	 *  Set key value by its name
+	 *
+	 *  @param name    key name
+	 *  @param data    data buffer with new content (equal or bigger than SMC_MAX_DATA_SIZE)
+	 *
+	 *  @return SmcSuccess if the value was found, was write-accessible, and the data was written
+	 */
+	virtual SMC_RESULT writeValueByName(SMC_KEY name, const SMC_DATA *data) = 0;
+
+	/**
+	 *  Obtain key information by its name
+	 *
+	 *  @param name    key name
+	 *  @param size    key value size
+	 *  @param type    key value type
+	 *  @param attr    key value attributes
+	 *
+	 *  @return SmcSuccess if the value was found and size, type, and attr variables were updated
+	 */
+	virtual SMC_RESULT getInfoByName(SMC_KEY name, SMC_DATA_SIZE &size, SMC_KEY_TYPE &type, SMC_KEY_ATTRIBUTES &attr) = 0;
+
+	/**
+	 *  Keystores are owned by their creators
+	 */
+	virtual ~SMCProtocolKeystore() = default;
+};
+
+/**
+ *  Interrupt delivery used by the protocols signalling events through interrupts.
+ *  MMIO consumes them through the event status register, PMIO through the event port.
+ */
+class SMCProtocolEvents {
+public:
+	/**
+	 *  Post an interrupt to the host
+	 *
+	 *  @param code  event code
+	 */
+	virtual void postInterrupt(SMC_EVENT_CODE code) = 0;
+
+	/**
+	 *  Consume the next posted interrupt
+	 *
+	 *  @return interrupt code or 0 if nothing is pending
+	 */
+	virtual SMC_EVENT_CODE getInterrupt() = 0;
+
+	/**
+	 *  Event sinks are owned by their creators
+	 */
+	virtual ~SMCProtocolEvents() = default;
+};
+
+#endif /* kern_protocol_hpp */
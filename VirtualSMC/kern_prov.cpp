@@ -11,6 +11,7 @@
 #include <Headers/kern_efi.hpp>
 #include <Headers/kern_crypto.hpp>
 #include <Headers/kern_nvram.hpp>
+#include <Headers/kern_time.hpp>
 #include <Headers/plugin_start.hpp>
 
 #include <IOKit/IOMapper.h>
@@ -49,6 +50,8 @@ mach_vm_address_t VirtualSMCProvider::monitorSmcStart, VirtualSMCProvider::monit
 mach_vm_address_t VirtualSMCProvider::orgKernelTrap;
 mach_vm_address_t VirtualSMCProvider::orgCallPlatformFunction;
 mach_vm_address_t VirtualSMCProvider::orgStopWatchdogTimer;
+mach_vm_address_t VirtualSMCProvider::orgReadData8;
+mach_vm_address_t VirtualSMCProvider::orgWriteData8;
 
 #endif
 
@@ -119,6 +122,8 @@ void VirtualSMCProvider::init() {
 		if (getKernelVersion() <= KernelVersion::Mavericks)
 			lilu_get_boot_args("smcdebug", &debugFlagMask, sizeof(debugFlagMask));
 
+		directCalls = checkKernelArgument("-vsmcdirect");
+
 		err = lilu.onKextLoad(&kextAppleSmc, 1, [](void *user, KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size) {
 			static_cast<VirtualSMCProvider *>(user)->onKextLoad(patcher, index, address, size);
 		}, this);
@@ -215,6 +220,20 @@ void VirtualSMCProvider::onKextLoad(KernelPatcher &kp, size_t index, mach_vm_add
 		monitorStart = memoryMaps[AppleSMCBufferMMIO]->getVirtualAddress();
 		monitorEnd = monitorStart + SMCProtocolMMIO::WindowSize;
 
+		// Mangled names guarantee the argument types, so a mismatching AppleSMC simply keeps using traps.
+		if (directCalls) {
+			KernelPatcher::RouteRequest requests[] {
+				{"__ZN8AppleSMC12smcReadData8Ej", directReadData8, orgReadData8},
+				{"__ZN8AppleSMC13smcWriteData8Ejh", directWriteData8, orgWriteData8}
+			};
+			if (kp.routeMultiple(index, requests, arrsize(requests))) {
+				DBGLOG("prov", "routed AppleSMC mmio accessors for direct calls");
+			} else {
+				SYSLOG("prov", "failed to route AppleSMC mmio accessors, falling back to traps");
+				kp.clearError();
+			}
+		}
+
 		VirtualSMC::postMmioReady();
 	}
 }
@@ -225,23 +244,15 @@ void VirtualSMCProvider::kernelTrap(T *state, uintptr_t *lo_spp) {
 		mach_vm_address_t faultAddr = state->ss_64.cr2;
 		// Note that this is false until monitorStart/monitorEnd are loaded, because they are zero-initialised.
 		if (faultAddr >= monitorStart && faultAddr < monitorEnd) {
+			auto entryTime = getCurrentTimeNs();
 			mach_vm_address_t retAddr = state->ss_64.isf.rip;
 			if (retAddr >= monitorSmcStart && retAddr < monitorSmcEnd) {
 				// Simple case, fault instruction is from AppleSMC
-				retAddr += Disassembler::quickInstructionSize(retAddr, 1);
+				retAddr += getInstructionSize(retAddr);
 			} else {
 				// More complex case, fault instruction is from memcpy or something similar, which we should never patch.
 				// We extract the AppleSMC address from the stack, which is the call address of a common function.
-				// A lot of those functions omit frame pointer for speed reasons, so we perform raw stack bruteforce.
-				retAddr = 0;
-				if (state->ss_64.isf.rsp > VM_MIN_KERNEL_AND_KEXT_ADDRESS && state->ss_64.isf.rsp < VM_MAX_KERNEL_ADDRESS) {
-					auto sp = reinterpret_cast<mach_vm_address_t *>(state->ss_64.isf.rsp);
-					for (size_t i = 0; i < 256 && !retAddr; i++) {
-						//DBGLOG("%lu %llx", i, retAddr);
-						if (sp[i] >= monitorSmcStart && sp[i] < monitorSmcEnd)
-							retAddr = sp[i];
-					}
-				}
+				retAddr = findReturnSite(state->ss_64.isf.rsp);
 
 				//SYSTRACE("prov @ retaddr=0x%llx monitorSmcStart=0x%llx monitorSmcEnd=0x%llx", retAddr, monitorSmcStart, monitorSmcEnd);
 
@@ -258,6 +269,7 @@ void VirtualSMCProvider::kernelTrap(T *state, uintptr_t *lo_spp) {
 			lilu_os_memcpy(info.org, reinterpret_cast<void *>(retAddr), sizeof(Trampoline));
 			info.retAddr = retAddr;
 			info.mmioAddr = faultAddr;
+			info.entryTime = entryTime;
 
 #if 0
 			DBGLOG("prov", "fault addr is %08X %08X ret addr is %08X %08X code %d",
@@ -312,6 +324,32 @@ void VirtualSMCProvider::kernelTrap(T *state, uintptr_t *lo_spp) {
 	FunctionCast(kernelTrap<T>, orgKernelTrap)(state, lo_spp);
 }
 
+size_t VirtualSMCProvider::getInstructionSize(mach_vm_address_t addr) {
+	auto &inst = instance->decodedInstructions[(addr ^ (addr >> 4)) & (InstructionCacheSize - 1)];
+	uint64_t tag = addr << DecodedAddressShift;
+	auto entry = atomic_load_explicit(&inst, memory_order_relaxed);
+	if ((entry & ~DecodedSizeMask) == tag)
+		return entry & DecodedSizeMask;
+
+	size_t size = Disassembler::quickInstructionSize(addr, 1);
+	atomic_store_explicit(&inst, tag | (size & DecodedSizeMask), memory_order_relaxed);
+	return size;
+}
+
+mach_vm_address_t VirtualSMCProvider::findReturnSite(mach_vm_address_t rsp) {
+	if (rsp <= VM_MIN_KERNEL_AND_KEXT_ADDRESS || rsp >= VM_MAX_KERNEL_ADDRESS)
+		return 0;
+
+	// A lot of those functions omit frame pointer for speed reasons, so we perform raw stack bruteforce.
+	auto sp = reinterpret_cast<mach_vm_address_t *>(rsp);
+	for (size_t i = 0; i < MaxReturnSiteDepth; i++) {
+		if (sp[i] >= monitorSmcStart && sp[i] < monitorSmcEnd)
+			return sp[i];
+	}
+
+	return 0;
+}
+
 IOReturn VirtualSMCProvider::filterCallPlatformFunction(void *that, const OSSymbol *functionName, bool waitForFunction,
 														void *param1, void *param2, void *param3, void *param4) {
 	// Always check for invalid args
@@ -339,6 +377,19 @@ IOReturn VirtualSMCProvider::filterStopWatchdogTimer(void *that) {
 	return kIOReturnSuccess;
 }
 
+uint8_t VirtualSMCProvider::directReadData8(void *that, uint32_t offset) {
+	if (SMCProtocolMMIO::isDirectRegister(offset))
+		return VirtualSMC::handleDirectRead(monitorStart, offset);
+	return FunctionCast(directReadData8, orgReadData8)(that, offset);
+}
+
+void VirtualSMCProvider::directWriteData8(void *that, uint32_t offset, uint8_t value) {
+	if (SMCProtocolMMIO::isDirectRegister(offset))
+		VirtualSMC::handleDirectWrite(monitorStart, offset, value);
+	else
+		FunctionCast(directWriteData8, orgWriteData8)(that, offset, value);
+}
+
 mach_vm_address_t VirtualSMCProvider::ioProcessResult(FaultInfo trinfo) {
 	const uint8_t pageIndex = trinfo & FaultIndexMask;
 	if (pageIndex < SMCProtocolMMIO::WindowNPages) {
@@ -363,6 +414,14 @@ mach_vm_address_t VirtualSMCProvider::ioProcessResult(FaultInfo trinfo) {
 				//DBGLOG("prov", "prot downgrade ro page %u done", pageIndex);
 			}
 			
+			auto off = info.mmioAddr - monitorStart;
+			TrapRegister reg;
+			if (faultType == FaultTypeWrite)
+				reg = off == SMC_MMIO_WRITE_COMMAND ? TrapRegisterCommand : TrapRegisterWrite;
+			else
+				reg = (off == SMC_MMIO_READ_KEY_STATUS || off == SMC_MMIO_READ_EVENT_STATUS) ? TrapRegisterStatus : TrapRegisterRead;
+			instance->updateTrapStatistics(reg, getCurrentTimeNs() - info.entryTime);
+
 			//DBGLOG("prov", "returning to 0x%08X", static_cast<uint32_t>(info.ret_addr));
 			return info.retAddr;
 		} else {
@@ -375,3 +434,67 @@ mach_vm_address_t VirtualSMCProvider::ioProcessResult(FaultInfo trinfo) {
 }
 
 #endif
+
+void VirtualSMCProvider::updateTrapStatistics(TrapRegister reg, uint64_t latency) {
+	auto &stats = trapStatistics[reg];
+	atomic_fetch_add_explicit(&stats.traps, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&stats.totalLatency, latency, memory_order_relaxed);
+	stats.histogram.account(latency);
+}
+
+OSDictionary *VirtualSMCProvider::createTrapStatistics() {
+	static const char *registerNames[TrapRegisterTotal] {
+		"Read",
+		"Write",
+		"Command",
+		"Status"
+	};
+
+	if (!instance)
+		return nullptr;
+
+	auto dict = OSDictionary::withCapacity(TrapRegisterTotal);
+	if (!dict)
+		return nullptr;
+
+	for (size_t i = 0; i < TrapRegisterTotal; i++) {
+		auto &stats = instance->trapStatistics[i];
+		auto regDict = OSDictionary::withCapacity(3);
+		if (!regDict)
+			continue;
+
+		auto num = OSNumber::withNumber(atomic_load_explicit(&stats.traps, memory_order_relaxed), 64);
+		if (num) {
+			regDict->setObject("Traps", num);
+			num->release();
+		}
+
+		num = OSNumber::withNumber(atomic_load_explicit(&stats.totalLatency, memory_order_relaxed), 64);
+		if (num) {
+			regDict->setObject("TotalLatencyNs", num);
+			num->release();
+		}
+
+		auto histogram = stats.histogram.createArray();
+		if (histogram) {
+			regDict->setObject("LatencyHistogramLog2Ns", histogram);
+			histogram->release();
+		}
+
+		dict->setObject(registerNames[i], regDict);
+		regDict->release();
+	}
+
+	return dict;
+}
+
+void VirtualSMCProvider::resetTrapStatistics() {
+	if (!instance)
+		return;
+
+	for (auto &stats : instance->trapStatistics) {
+		atomic_store_explicit(&stats.traps, 0, memory_order_relaxed);
+		atomic_store_explicit(&stats.totalLatency, 0, memory_order_relaxed);
+		stats.histogram.reset();
+	}
+}
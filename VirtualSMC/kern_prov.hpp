@@ -12,7 +12,9 @@
 #include <IOKit/IOService.h>
 #include <IOKit/IOBufferMemoryDescriptor.h>
 #include <Private/thread_status.h>
+#include <stdatomic.h>
 
+#include "kern_histogram.hpp"
 #include "kern_pmio.hpp"
 #include "kern_mmio.hpp"
 
@@ -28,6 +30,17 @@ public:
 		AppleSMCBufferTotal
 	};
 
+	/**
+	 *  MMIO register groups accounted in trap statistics
+	 */
+	enum TrapRegister {
+		TrapRegisterRead,
+		TrapRegisterWrite,
+		TrapRegisterCommand,
+		TrapRegisterStatus,
+		TrapRegisterTotal
+	};
+
 	/**
 	 *  Obtain a single initialised provider instance
 	 */
@@ -66,6 +79,18 @@ public:
 	static bool getFirmwareBackendStatus() {
 		return instance && instance->firmwareStatus;
 	}
+
+	/**
+	 *  Create MMIO trap statistics dictionary with per-register counters and latency histograms
+	 *
+	 *  @return statistics dictionary or nullptr
+	 */
+	static OSDictionary *createTrapStatistics();
+
+	/**
+	 *  Reset MMIO trap statistics
+	 */
+	static void resetTrapStatistics();
 	
 private:
 
@@ -98,6 +123,28 @@ private:
 	 *  Firmware support availability and validity status
 	 */
 	bool firmwareStatus {false};
+
+	/**
+	 *  MMIO trap statistics of a single register group
+	 */
+	struct TrapStatistics {
+		_Atomic(uint64_t) traps;
+		_Atomic(uint64_t) totalLatency;
+		Log2Histogram histogram;
+	};
+
+	/**
+	 *  MMIO trap statistics by register group
+	 */
+	TrapStatistics trapStatistics[TrapRegisterTotal] {};
+
+	/**
+	 *  Account a serviced MMIO trap
+	 *
+	 *  @param reg      register group
+	 *  @param latency  time from trap entry to resumed execution in nanoseconds
+	 */
+	void updateTrapStatistics(TrapRegister reg, uint64_t latency);
 	
 #if defined(__x86_64__)
 
@@ -124,6 +171,43 @@ private:
 	 */
 	uint32_t debugFlagMask {0};
 
+	/**
+	 *  Route AppleSMC mmio accessors directly to the protocol implementation (-vsmcdirect)
+	 *  Page fault trapping stays active for any access not going through the routed accessors.
+	 */
+	bool directCalls {false};
+
+	/**
+	 *  Original AppleSMC::smcReadData8 routine
+	 */
+	static mach_vm_address_t orgReadData8;
+
+	/**
+	 *  Original AppleSMC::smcWriteData8 routine
+	 */
+	static mach_vm_address_t orgWriteData8;
+
+	/**
+	 *  Direct-call replacement for AppleSMC::smcReadData8, offsets other than mmio registers
+	 *  (i.e. pmio ports) go to the original routine
+	 *
+	 *  @param that    AppleSMC instance
+	 *  @param offset  mmio register offset
+	 *
+	 *  @return register value
+	 */
+	static uint8_t directReadData8(void *that, uint32_t offset);
+
+	/**
+	 *  Direct-call replacement for AppleSMC::smcWriteData8, offsets other than mmio registers
+	 *  (i.e. pmio ports) go to the original routine
+	 *
+	 *  @param that    AppleSMC instance
+	 *  @param offset  mmio register offset
+	 *  @param value   register value
+	 */
+	static void directWriteData8(void *that, uint32_t offset, uint8_t value);
+
 	/**
 	 *  For better packing we only use 8 bits to describe our i/o access
 	 */
@@ -176,6 +260,7 @@ private:
 		uint8_t org[sizeof(Trampoline)];  /* back up of the original code */
 		mach_vm_address_t retAddr;        /* return address */
 		mach_vm_address_t mmioAddr;       /* mmio r/w address */
+		uint64_t entryTime;               /* trap entry time in nanoseconds */
 	};
 
 	/**
@@ -183,6 +268,50 @@ private:
 	 */
 	PageInfo pageInfo[SMCProtocolMMIO::WindowNPages] {};
 
+	/**
+	 *  Maximum amount of stack slots scanned when looking for AppleSMC return address
+	 */
+	static constexpr size_t MaxReturnSiteDepth {256};
+
+	/**
+	 *  Decoded instruction cache size, must be a power of two
+	 */
+	static constexpr size_t InstructionCacheSize {16};
+
+	/**
+	 *  Decoded instruction cache entry bits holding the instruction length, x86 instructions are at most 15 bytes.
+	 *  The rest holds the instruction address shifted left, which only drops copies of the canonical address sign bit.
+	 */
+	static constexpr uint64_t DecodedSizeMask {0xF};
+	static constexpr uint32_t DecodedAddressShift {4};
+
+	/**
+	 *  Decoded instruction cache indexed by instruction address, 0 marks an empty entry
+	 *  AppleSMC only has a few instructions accessing mmio directly, so the disassembler is only called once for each.
+	 *  Faults on several CPUs may update an entry at once, so address and length are stored together in one word.
+	 */
+	_Atomic(uint64_t) decodedInstructions[InstructionCacheSize] {};
+
+	/**
+	 *  Obtain the length of an AppleSMC mmio access instruction
+	 *
+	 *  @param addr  instruction address
+	 *
+	 *  @return instruction length
+	 */
+	static size_t getInstructionSize(mach_vm_address_t addr);
+
+	/**
+	 *  Find AppleSMC return address for a faulting instruction outside of AppleSMC
+	 *  The nearest AppleSMC address on the stack is used. Caching its slot per faulting instruction
+	 *  is not possible, as the same routine may be reached with AppleSMC addresses in different slots.
+	 *
+	 *  @param rsp  stack pointer at the fault
+	 *
+	 *  @return return address or 0
+	 */
+	static mach_vm_address_t findReturnSite(mach_vm_address_t rsp);
+
 	/**
 	 *  Monitored device mmio area region start and end
 	 */
@@ -191,7 +320,7 @@ private:
 	/**
 	 *  AppleSMC kext memory region start and end
 	 *  These are used to determine whether the fault address is an AppleSMC address
-	 *  When it is not (e.g. memcpy), we perform stack unwinding until we find an AppleSMC address
+	 *  When it is not (e.g. memcpy), we look up the AppleSMC address on the stack (see findReturnSite)
 	 */
 	static mach_vm_address_t monitorSmcStart, monitorSmcEnd;
 
@@ -0,0 +1,75 @@
+//
+//  kern_record.cpp
+//  VirtualSMC
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#include <Headers/kern_time.hpp>
+
+#include "kern_record.hpp"
+
+static_assert(sizeof(SMCTransactionRecorder::Transaction) == 16, "Transaction has unexpected size");
+
+bool SMCTransactionRecorder::init(uint32_t count) {
+	capacity = count > MaxTransactions ? MaxTransactions : count;
+	if (capacity == 0)
+		return false;
+
+	lock = IOSimpleLockAlloc();
+	transactions = Buffer::create<Transaction>(capacity);
+	if (!lock || !transactions) {
+		SYSLOG("record", "failed to allocate %u transactions", capacity);
+		deinit();
+		return false;
+	}
+
+	DBGLOG("record", "recording up to %u transactions", capacity);
+	return true;
+}
+
+void SMCTransactionRecorder::deinit() {
+	if (transactions) {
+		Buffer::deleter(transactions);
+		transactions = nullptr;
+	}
+
+	if (lock) {
+		IOSimpleLockFree(lock);
+		lock = nullptr;
+	}
+
+	capacity = 0;
+}
+
+void SMCTransactionRecorder::record(Protocol protocol, SMC_COMMAND command, SMC_KEY key, SMC_DATA_SIZE size, SMC_RESULT result) {
+	auto timestamp = getCurrentTimeNs();
+	IOSimpleLockLock(lock);
+	auto &entry = transactions[recorded % capacity];
+	entry.timestamp = timestamp;
+	entry.key = key;
+	entry.command = command;
+	entry.size = size;
+	entry.result = result;
+	entry.protocol = protocol;
+	recorded++;
+	IOSimpleLockUnlock(lock);
+}
+
+OSData *SMCTransactionRecorder::createLog() {
+	// Allocate beforehand, we cannot do that while holding a spinlock.
+	auto buf = Buffer::create<Transaction>(capacity);
+	if (!buf)
+		return nullptr;
+
+	IOSimpleLockLock(lock);
+	uint32_t count = recorded < capacity ? static_cast<uint32_t>(recorded) : capacity;
+	uint32_t start = recorded < capacity ? 0 : static_cast<uint32_t>(recorded % capacity);
+	lilu_os_memcpy(buf, transactions + start, (count - start) * sizeof(Transaction));
+	lilu_os_memcpy(buf + (count - start), transactions, start * sizeof(Transaction));
+	IOSimpleLockUnlock(lock);
+
+	auto data = OSData::withBytes(buf, count * sizeof(Transaction));
+	Buffer::deleter(buf);
+	return data;
+}
@@ -0,0 +1,107 @@
+//
+//  kern_record.hpp
+//  VirtualSMC
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_record_hpp
+#define kern_record_hpp
+
+#include <Headers/kern_util.hpp>
+#include <IOKit/IOLocks.h>
+#include <libkern/c++/OSData.h>
+#include <VirtualSMCSDK/AppleSmcBridge.hpp>
+
+class SMCTransactionRecorder {
+public:
+	/**
+	 *  Protocol a transaction arrived through
+	 */
+	enum Protocol : uint8_t {
+		ProtocolPMIO,
+		ProtocolMMIO
+	};
+
+	/**
+	 *  Recorded transaction as exported to the registry
+	 */
+	struct PACKED Transaction {
+		uint64_t timestamp;    // Completion time in nanoseconds
+		SMC_KEY key;           // Key name (as read by the protocol)
+		SMC_COMMAND command;   // Command code, e.g. SmcCmdReadValue
+		SMC_DATA_SIZE size;    // Transferred value size
+		SMC_RESULT result;     // Command result
+		Protocol protocol;     // Protocol used
+	};
+
+	/**
+	 *  Maximum amount of recorded transactions
+	 */
+	static constexpr uint32_t MaxTransactions {65536};
+
+private:
+	/**
+	 *  Transaction ring buffer
+	 */
+	Transaction *transactions {nullptr};
+
+	/**
+	 *  Transaction ring buffer capacity
+	 */
+	uint32_t capacity {0};
+
+	/**
+	 *  Total number of recorded transactions
+	 */
+	uint64_t recorded {0};
+
+	/**
+	 *  Ring buffer access lock
+	 */
+	IOSimpleLock *lock {nullptr};
+
+public:
+	/**
+	 *  Allocate recorder resources
+	 *
+	 *  @param count  ring buffer capacity in transactions (at most MaxTransactions)
+	 *
+	 *  @return true on success
+	 */
+	bool init(uint32_t count);
+
+	/**
+	 *  Free recorder resources
+	 */
+	void deinit();
+
+	/**
+	 *  Record a completed transaction, safe to call within the trap handler
+	 *
+	 *  @param protocol  protocol used
+	 *  @param command   command code
+	 *  @param key       key name
+	 *  @param size      transferred value size
+	 *  @param result    command result
+	 */
+	void record(Protocol protocol, SMC_COMMAND command, SMC_KEY key, SMC_DATA_SIZE size, SMC_RESULT result);
+
+	/**
+	 *  Export recorded transactions in chronological order
+	 *
+	 *  @return array of Transaction entries (must be released) or nullptr
+	 */
+	OSData *createLog();
+
+	/**
+	 *  Obtain total number of recorded transactions including overwritten ones
+	 *
+	 *  @return transaction count
+	 */
+	uint64_t getRecorded() const {
+		return recorded;
+	}
+};
+
+#endif /* kern_record_hpp */
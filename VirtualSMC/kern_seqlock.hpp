@@ -0,0 +1,82 @@
+//
+//  kern_seqlock.hpp
+//  VirtualSMC
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_seqlock_hpp
+#define kern_seqlock_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ *  Sequence lock for small data written by several writers and copied by lock-free readers.
+ *  The counter is odd while the data is being written, and writers wait for each other on it
+ *  unless they may skip the update (tryWrite).
+ *  A writer interrupted on its CPU by another writer of the same data would never finish,
+ *  so data written from interrupt context must be written with interrupts disabled.
+ */
+namespace SeqLock {
+	/**
+	 *  Update the data protected by a sequence counter
+	 *
+	 *  @param seq     sequence counter
+	 *  @param writer  data update callback
+	 */
+	template <typename T>
+	inline void write(_Atomic(uint32_t) &seq, T writer) {
+		uint32_t value = atomic_load_explicit(&seq, memory_order_relaxed);
+		while ((value & 1) || !atomic_compare_exchange_weak_explicit(&seq, &value, value + 1, memory_order_relaxed, memory_order_relaxed))
+			value = atomic_load_explicit(&seq, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
+		writer();
+		atomic_store_explicit(&seq, value + 2, memory_order_release);
+	}
+
+	/**
+	 *  Update the data protected by a sequence counter unless another writer is updating it
+	 *
+	 *  @param seq     sequence counter
+	 *  @param writer  data update callback
+	 *
+	 *  @return true if the data was updated
+	 */
+	template <typename T>
+	inline bool tryWrite(_Atomic(uint32_t) &seq, T writer) {
+		uint32_t value = atomic_load_explicit(&seq, memory_order_relaxed);
+		if ((value & 1) || !atomic_compare_exchange_strong_explicit(&seq, &value, value + 1, memory_order_relaxed, memory_order_relaxed))
+			return false;
+		atomic_thread_fence(memory_order_release);
+		writer();
+		atomic_store_explicit(&seq, value + 2, memory_order_release);
+		return true;
+	}
+
+	/**
+	 *  Copy the data protected by a sequence counter
+	 *
+	 *  @param seq       sequence counter
+	 *  @param reader    data copy callback, a copy made during a write is discarded
+	 *  @param attempts  maximum amount of copy attempts, 0 waits for a consistent copy
+	 *
+	 *  @return true if the last copy is consistent
+	 */
+	template <typename T>
+	inline bool read(_Atomic(uint32_t) &seq, T reader, size_t attempts = 0) {
+		for (size_t i = 0; attempts == 0 || i < attempts; i++) {
+			uint32_t value = atomic_load_explicit(&seq, memory_order_acquire);
+			if (value & 1)
+				continue;
+			reader();
+			atomic_thread_fence(memory_order_acquire);
+			if (atomic_load_explicit(&seq, memory_order_relaxed) == value)
+				return true;
+		}
+		return false;
+	}
+}
+
+#endif /* kern_seqlock_hpp */
@@ -0,0 +1,390 @@
+//
+//  kern_timer.cpp
+//  VirtualSMC
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#include <Headers/kern_time.hpp>
+
+#include "kern_timer.hpp"
+
+extern "C" {
+#include <i386/pmCPU.h>
+}
+
+static_assert(VirtualSMCTimerService::MaxTimers <= 0xFF, "Timer handles keep slot index in the lowest byte");
+
+VirtualSMCTimerService *VirtualSMCTimerService::instance;
+
+bool VirtualSMCTimerService::init(OSObject *target) {
+	owner = target;
+	workLoop = IOWorkLoop::workLoop();
+	if (!workLoop) {
+		SYSLOG("timer", "work loop allocation failure");
+		return false;
+	}
+
+	workerLock = IOLockAlloc();
+	if (!workerLock) {
+		SYSLOG("timer", "worker lock allocation failure");
+		return false;
+	}
+
+	source = IOTimerEventSource::timerEventSource(owner, timerAction);
+	if (!source) {
+		SYSLOG("timer", "timer event source allocation failure");
+		return false;
+	}
+
+	if (workLoop->addEventSource(source) != kIOReturnSuccess) {
+		SYSLOG("timer", "failed to add timer event source");
+		OSSafeReleaseNULL(source);
+		return false;
+	}
+
+	instance = this;
+	return true;
+}
+
+void VirtualSMCTimerService::deinit() {
+	if (workLoop && source) {
+		workLoop->runAction([](OSObject *, void *arg0, void *, void *, void *) {
+			auto that = static_cast<VirtualSMCTimerService *>(arg0);
+			that->source->cancelTimeout();
+			for (uint32_t cpu = 0; cpu < CPUInfo::MaxCpus; cpu++)
+				that->stopWorker(cpu);
+			for (auto &timer : that->timers) {
+				auto generation = timer.generation;
+				timer = {};
+				timer.generation = generation;
+			}
+			return kIOReturnSuccess;
+		}, owner, this);
+		workLoop->removeEventSource(source);
+	}
+
+	if (instance == this)
+		instance = nullptr;
+
+	OSSafeReleaseNULL(source);
+	OSSafeReleaseNULL(workLoop);
+	if (workerLock) {
+		IOLockFree(workerLock);
+		workerLock = nullptr;
+	}
+}
+
+uint32_t VirtualSMCTimerService::add(VirtualSMCAPI::TimerAction action, void *context, uint32_t intervalMs, bool periodic, uint32_t leewayMs) {
+	if (!action || intervalMs == 0) {
+		SYSLOG("timer", "invalid timer registration");
+		return 0;
+	}
+
+	Timer timer {};
+	timer.action = action;
+	timer.context = context;
+	timer.interval = intervalMs * NSEC_PER_MSEC;
+	timer.leeway = leewayMs * NSEC_PER_MSEC;
+	timer.cpu = VirtualSMCAPI::AnyCpu;
+	timer.periodic = periodic;
+	return insert(timer);
+}
+
+uint32_t VirtualSMCTimerService::add(const VirtualSMCAPI::SamplingTask &task) {
+	if (!task.action || task.periodMs == 0 || task.jitterMs >= task.periodMs ||
+		(task.cpu != VirtualSMCAPI::AnyCpu && (task.cpu < 0 || static_cast<size_t>(task.cpu) >= CPUInfo::MaxCpus))) {
+		SYSLOG("timer", "invalid sampling task registration");
+		return 0;
+	}
+
+	// Jitter is tolerated in both directions: late to join a later wakeup, and early to join an earlier one.
+	Timer timer {};
+	timer.action = task.action;
+	timer.context = task.context;
+	timer.interval = task.periodMs * NSEC_PER_MSEC;
+	timer.leeway = timer.advance = task.jitterMs * NSEC_PER_MSEC;
+	timer.cost = task.costUs;
+	timer.cpu = task.cpu;
+	timer.periodic = true;
+	return insert(timer);
+}
+
+uint32_t VirtualSMCTimerService::insert(Timer &timer) {
+	if (onWorkerThread()) {
+		SYSLOG("timer", "timer registration from cpu affine action");
+		return 0;
+	}
+
+	uint32_t handle = 0;
+
+	workLoop->runAction([](OSObject *, void *arg0, void *arg1, void *arg2, void *) {
+		auto that = static_cast<VirtualSMCTimerService *>(arg0);
+		auto timer = static_cast<Timer *>(arg1);
+		auto handle = static_cast<uint32_t *>(arg2);
+		if (timer->cpu != VirtualSMCAPI::AnyCpu && !that->startWorker(static_cast<uint32_t>(timer->cpu)))
+			return kIOReturnNoResources;
+		for (size_t i = 0; i < MaxTimers; i++) {
+			auto &slot = that->timers[i];
+			if (!slot.action) {
+				auto now = getCurrentTimeNs();
+				timer->generation = slot.generation + 1;
+				timer->deadline = now + timer->interval;
+				slot = *timer;
+				*handle = (timer->generation << 8) | static_cast<uint32_t>(i + 1);
+				that->rearm(now);
+				return kIOReturnSuccess;
+			}
+		}
+		SYSLOG("timer", "no free timer slots");
+		return kIOReturnNoResources;
+	}, owner, this, &timer, &handle);
+
+	return handle;
+}
+
+void VirtualSMCTimerService::remove(uint32_t timer) {
+	if (onWorkerThread()) {
+		SYSLOG("timer", "timer removal from cpu affine action");
+		return;
+	}
+
+	workLoop->runAction([](OSObject *, void *arg0, void *arg1, void *, void *) {
+		auto that = static_cast<VirtualSMCTimerService *>(arg0);
+		auto handle = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(arg1));
+		size_t index = (handle & 0xFF) - 1;
+		if (index >= MaxTimers || that->timers[index].generation != (handle >> 8) || !that->timers[index].action)
+			return kIOReturnNotFound;
+		auto generation = that->timers[index].generation;
+		auto cpu = that->timers[index].cpu;
+		that->timers[index] = {};
+		that->timers[index].generation = generation;
+		that->rearm(getCurrentTimeNs());
+
+		// Do not keep an idle thread bound to the CPU.
+		if (cpu != VirtualSMCAPI::AnyCpu) {
+			bool used = false;
+			for (auto &timer : that->timers)
+				used |= timer.action && timer.cpu == cpu;
+			if (!used)
+				that->stopWorker(static_cast<uint32_t>(cpu));
+		}
+		return kIOReturnSuccess;
+	}, owner, this, reinterpret_cast<void *>(static_cast<uintptr_t>(timer)));
+}
+
+void VirtualSMCTimerService::rearm(uint64_t now) {
+	uint64_t fireAt = UINT64_MAX;
+	for (auto &timer : timers) {
+		if (timer.action && timer.deadline + timer.leeway < fireAt)
+			fireAt = timer.deadline + timer.leeway;
+	}
+
+	if (fireAt == UINT64_MAX) {
+		source->cancelTimeout();
+		return;
+	}
+
+	uint64_t delayUs = fireAt > now ? (fireAt - now + NSEC_PER_USEC - 1) / NSEC_PER_USEC : 1;
+	source->setTimeoutUS(static_cast<uint32_t>(delayUs > UINT32_MAX ? UINT32_MAX : delayUs));
+}
+
+void VirtualSMCTimerService::fire() {
+	wakeups++;
+
+	// Every timer, which deadline has passed, fires now, even if its leeway is not over yet.
+	auto now = getCurrentTimeNs();
+	uint32_t batchCost = 0;
+	for (auto &timer : timers) {
+		if (timer.action && timer.deadline <= now)
+			batchCost += timer.cost;
+	}
+
+	bool dispatch = false;
+	for (auto &timer : timers) {
+		if (!timer.action)
+			continue;
+
+		// Sampling tasks close to their deadlines join this wakeup as long as it stays cheap.
+		if (timer.deadline > now) {
+			if (timer.deadline > now + timer.advance || batchCost + timer.cost > MaxBatchCostUs)
+				continue;
+			batchCost += timer.cost;
+			earlyInvocations++;
+		}
+
+		auto action = timer.action;
+		auto context = timer.context;
+		auto cpu = timer.cpu;
+		if (timer.periodic) {
+			timer.deadline += timer.interval;
+			if (timer.deadline <= now)
+				timer.deadline = now + timer.interval;
+		} else {
+			auto generation = timer.generation;
+			timer = {};
+			timer.generation = generation;
+		}
+
+		invocations++;
+		estimatedCost += timer.cost;
+		// CPU affine timers are always periodic sampling tasks, so their slots stay intact.
+		if (cpu != VirtualSMCAPI::AnyCpu) {
+			timer.dispatched = true;
+			dispatch = true;
+		} else {
+			action(context);
+		}
+	}
+
+	if (dispatch)
+		dispatchWorkers();
+
+	rearm(getCurrentTimeNs());
+}
+
+void VirtualSMCTimerService::dispatchWorkers() {
+	// Workers of different CPUs run in parallel, while the work loop gate stays held,
+	// so the timers cannot be modified until every dispatched action completes.
+	IOLockLock(workerLock);
+	for (auto &timer : timers) {
+		if (timer.dispatched) {
+			auto &worker = workers[timer.cpu];
+			if (!worker.pending) {
+				worker.pending = true;
+				busyWorkers++;
+				IOLockWakeup(workerLock, &worker, false);
+			}
+		}
+	}
+
+	while (busyWorkers > 0)
+		IOLockSleep(workerLock, &busyWorkers, THREAD_UNINT);
+	IOLockUnlock(workerLock);
+
+	for (auto &timer : timers)
+		timer.dispatched = false;
+}
+
+bool VirtualSMCTimerService::onWorkerThread() {
+	auto thread = current_thread();
+	bool found = false;
+	IOLockLock(workerLock);
+	for (auto &worker : workers)
+		found |= worker.thread == thread;
+	IOLockUnlock(workerLock);
+	return found;
+}
+
+bool VirtualSMCTimerService::startWorker(uint32_t cpu) {
+	auto &worker = workers[cpu];
+	if (worker.state == WorkerState::Running)
+		return true;
+
+	worker.service = this;
+	worker.cpu = cpu;
+
+	IOLockLock(workerLock);
+	worker.state = WorkerState::Starting;
+	thread_t thread;
+	if (kernel_thread_start(workerEntry, &worker, &thread) == KERN_SUCCESS) {
+		thread_deallocate(thread);
+		while (worker.state == WorkerState::Starting)
+			IOLockSleep(workerLock, &worker, THREAD_UNINT);
+	} else {
+		worker.state = WorkerState::Failed;
+	}
+	bool running = worker.state == WorkerState::Running;
+	if (!running)
+		worker.state = WorkerState::Stopped;
+	IOLockUnlock(workerLock);
+
+	if (!running)
+		SYSLOG("timer", "failed to start worker for cpu %u", cpu);
+	return running;
+}
+
+void VirtualSMCTimerService::stopWorker(uint32_t cpu) {
+	auto &worker = workers[cpu];
+	IOLockLock(workerLock);
+	if (worker.state == WorkerState::Running) {
+		worker.state = WorkerState::Stopping;
+		IOLockWakeup(workerLock, &worker, false);
+		while (worker.state == WorkerState::Stopping)
+			IOLockSleep(workerLock, &worker, THREAD_UNINT);
+	}
+	IOLockUnlock(workerLock);
+}
+
+bool VirtualSMCTimerService::bindCurrentThread(uint32_t cpu) {
+	// Obtain power management callbacks
+	pmCallBacks_t callbacks {};
+	pmKextRegister(PM_DISPATCH_VERSION, nullptr, &callbacks);
+
+	if (!callbacks.LCPUtoProcessor || !callbacks.ThreadBind) {
+		SYSLOG("timer", "failed to obtain thread binding callbacks");
+		return false;
+	}
+
+	bool success = true;
+	auto enable = ml_set_interrupts_enabled(FALSE);
+	auto processor = callbacks.LCPUtoProcessor(cpu);
+	if (processor != nullptr)
+		callbacks.ThreadBind(processor);
+	else
+		success = false;
+	ml_set_interrupts_enabled(enable);
+
+	if (!success)
+		SYSLOG("timer", "failed to call LCPUtoProcessor with cpu %u", cpu);
+	return success;
+}
+
+void VirtualSMCTimerService::workerEntry(void *parameter, wait_result_t) {
+	auto &worker = *static_cast<CpuWorker *>(parameter);
+	auto that = worker.service;
+	bool bound = bindCurrentThread(worker.cpu);
+
+	IOLockLock(that->workerLock);
+	worker.state = bound ? WorkerState::Running : WorkerState::Failed;
+	if (bound)
+		worker.thread = current_thread();
+	IOLockWakeup(that->workerLock, &worker, false);
+
+	// Binding takes effect once the thread blocks, which always happens before the first dispatch.
+	// Workers are only dispatched and stopped within the work loop gate, so a stopped worker has no pending actions.
+	while (bound) {
+		while (!worker.pending && worker.state == WorkerState::Running)
+			IOLockSleep(that->workerLock, &worker, THREAD_UNINT);
+		if (worker.state != WorkerState::Running)
+			break;
+		IOLockUnlock(that->workerLock);
+
+		for (auto &timer : that->timers) {
+			if (timer.dispatched && timer.cpu == static_cast<int32_t>(worker.cpu))
+				timer.action(timer.context);
+		}
+
+		IOLockLock(that->workerLock);
+		worker.pending = false;
+		if (--that->busyWorkers == 0)
+			IOLockWakeup(that->workerLock, &that->busyWorkers, true);
+	}
+
+	if (bound) {
+		worker.state = WorkerState::Stopped;
+		worker.thread = nullptr;
+		IOLockWakeup(that->workerLock, &worker, false);
+	}
+	IOLockUnlock(that->workerLock);
+
+	// Returning from the continuation terminates the thread.
+}
+
+void VirtualSMCTimerService::timerAction(OSObject *, IOTimerEventSource *) {
+	auto service = instance;
+	if (service)
+		service->fire();
+	else
+		SYSLOG("timer", "timer action without service");
+}
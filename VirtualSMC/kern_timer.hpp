@@ -0,0 +1,284 @@
+//
+//  kern_timer.hpp
+//  VirtualSMC
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_timer_hpp
+#define kern_timer_hpp
+
+#include <Headers/kern_util.hpp>
+#include <Headers/kern_cpu.hpp>
+#include <IOKit/IOLocks.h>
+#include <IOKit/IOWorkLoop.h>
+#include <IOKit/IOTimerEventSource.h>
+#include <kern/thread.h>
+#include <VirtualSMCSDK/kern_vsmctypes.hpp>
+
+/**
+ *  Shared timer service multiplexing VirtualSMC and plugin deadlines onto a single work loop timer.
+ *  The service has its own work loop, so that slow actions, like ACPI evaluation in sensor plugins,
+ *  never hold back the watchdog jobs and the deferred interrupts handled on the watchdog work loop.
+ *  Each timer may specify a leeway, which lets the service fire several nearby deadlines with one wakeup.
+ *  Sampling tasks may additionally run early, and CPU affine ones are handed to per-CPU bound workers.
+ *  All the timer state is accessed within the work loop gate, so no additional locking is performed.
+ */
+class VirtualSMCTimerService {
+public:
+	/**
+	 *  Maximum amount of simultaneously registered timers, enough for a CPU affine task on every core
+	 */
+	static constexpr size_t MaxTimers {255};
+
+	/**
+	 *  Maximum total cost hint of the tasks pulled into a wakeup ahead of their deadlines
+	 */
+	static constexpr uint32_t MaxBatchCostUs {1000};
+
+	/**
+	 *  Initialise the service and create its work loop, there must be only one service at a time
+	 *
+	 *  @param target  owner object for work loop actions
+	 *
+	 *  @return true on success
+	 */
+	bool init(OSObject *target);
+
+	/**
+	 *  Stop the CPU workers and release the resources, no timer action is running or invoked afterwards
+	 */
+	void deinit();
+
+	/**
+	 *  Register a timer, must not be called from interrupt context or CPU affine actions
+	 *
+	 *  @param action      timer action
+	 *  @param context     timer action context
+	 *  @param intervalMs  interval before the (first) invocation
+	 *  @param periodic    repeat every intervalMs until removed
+	 *  @param leewayMs    allowed invocation delay for wakeup coalescing
+	 *
+	 *  @return timer handle or 0
+	 */
+	uint32_t add(VirtualSMCAPI::TimerAction action, void *context, uint32_t intervalMs, bool periodic, uint32_t leewayMs);
+
+	/**
+	 *  Register a sampling task, must not be called from interrupt context or CPU affine actions
+	 *
+	 *  @param task  sampling task description
+	 *
+	 *  @return timer handle or 0
+	 */
+	uint32_t add(const VirtualSMCAPI::SamplingTask &task);
+
+	/**
+	 *  Unregister a timer, must not be called from interrupt context or CPU affine actions
+	 *  Once this returns the timer action is guaranteed to be neither running nor invoked later.
+	 *  The CPU worker exits with the last sampling task bound to its CPU.
+	 *
+	 *  @param timer  timer handle
+	 */
+	void remove(uint32_t timer);
+
+	/**
+	 *  Obtain the amount of timer wakeups handled
+	 *
+	 *  @return wakeup count
+	 */
+	uint64_t getWakeups() const {
+		return wakeups;
+	}
+
+	/**
+	 *  Obtain the amount of timer actions invoked
+	 *
+	 *  @return invocation count
+	 */
+	uint64_t getInvocations() const {
+		return invocations;
+	}
+
+	/**
+	 *  Obtain the amount of sampling tasks invoked ahead of their deadlines
+	 *
+	 *  @return early invocation count
+	 */
+	uint64_t getEarlyInvocations() const {
+		return earlyInvocations;
+	}
+
+	/**
+	 *  Obtain the summed cost hints of the invoked actions, an energy consumption estimate
+	 *
+	 *  @return estimated action time in microseconds
+	 */
+	uint64_t getEstimatedCost() const {
+		return estimatedCost;
+	}
+
+private:
+	/**
+	 *  Registered timer
+	 */
+	struct Timer {
+		VirtualSMCAPI::TimerAction action;     // Timer action, nullptr for free slots
+		void *context;                         // Timer action context
+		uint64_t interval;                     // Interval in nanoseconds
+		uint64_t leeway;                       // Allowed delay in nanoseconds
+		uint64_t advance;                      // Allowed early invocation in nanoseconds
+		uint64_t deadline;                     // Next invocation time in nanoseconds
+		uint32_t cost;                         // Expected action duration in microseconds
+		uint32_t generation;                   // Slot reuse counter for stale handle detection
+		int32_t cpu;                           // CPU to invoke the action on or AnyCpu
+		bool periodic;                         // Repeat after invocation
+		bool dispatched;                       // Handed to a CPU worker in the current wakeup
+	};
+
+	/**
+	 *  CPU worker state
+	 */
+	enum class WorkerState : uint8_t {
+		Stopped,
+		Starting,
+		Running,
+		Stopping,
+		Failed
+	};
+
+	/**
+	 *  Kernel thread bound to a CPU, which invokes CPU affine timer actions
+	 */
+	struct CpuWorker {
+		VirtualSMCTimerService *service;    // Owning timer service
+		uint32_t cpu;                       // CPU number
+		WorkerState state;                  // Worker state, protected by workerLock
+		thread_t thread;                    // Worker thread while it runs, protected by workerLock
+		bool pending;                       // Dispatched actions are waiting, protected by workerLock
+	};
+
+	/**
+	 *  Registered timers
+	 */
+	Timer timers[MaxTimers] {};
+
+	/**
+	 *  CPU workers indexed by CPU number
+	 */
+	CpuWorker workers[CPUInfo::MaxCpus] {};
+
+	/**
+	 *  Lock protecting CPU worker handoffs
+	 */
+	IOLock *workerLock {nullptr};
+
+	/**
+	 *  Amount of CPU workers still running dispatched actions, protected by workerLock
+	 */
+	uint32_t busyWorkers {0};
+
+	/**
+	 *  Initialised service for the timer event source action
+	 */
+	static VirtualSMCTimerService *instance;
+
+	/**
+	 *  Work loop all the timers are multiplexed on, owned by the service
+	 */
+	IOWorkLoop *workLoop {nullptr};
+
+	/**
+	 *  Owner object for work loop actions
+	 */
+	OSObject *owner {nullptr};
+
+	/**
+	 *  The only timer event source used
+	 */
+	IOTimerEventSource *source {nullptr};
+
+	/**
+	 *  Timer statistics
+	 */
+	uint64_t wakeups {0};
+	uint64_t invocations {0};
+	uint64_t earlyInvocations {0};
+	uint64_t estimatedCost {0};
+
+	/**
+	 *  Insert a timer into a free slot and schedule it
+	 *
+	 *  @param timer  timer to insert, generation and deadline are assigned
+	 *
+	 *  @return timer handle or 0
+	 */
+	uint32_t insert(Timer &timer);
+
+	/**
+	 *  Check whether the current thread is a CPU worker, which must not wait for the work loop gate
+	 *  held by the wakeup waiting for it
+	 *
+	 *  @return true if called from a CPU affine action
+	 */
+	bool onWorkerThread();
+
+	/**
+	 *  Start the CPU worker unless it is already running, must be called within the work loop gate
+	 *
+	 *  @param cpu  CPU number
+	 *
+	 *  @return true if the worker is running and bound to the CPU
+	 */
+	bool startWorker(uint32_t cpu);
+
+	/**
+	 *  Stop the CPU worker if it is running and wait for it to exit, must be called within the work loop gate
+	 *
+	 *  @param cpu  CPU number
+	 */
+	void stopWorker(uint32_t cpu);
+
+	/**
+	 *  Hand dispatched timer actions to their CPU workers and wait for them to complete
+	 */
+	void dispatchWorkers();
+
+	/**
+	 *  Bind current thread to the specified CPU, effective after the thread blocks
+	 *
+	 *  @param cpu  CPU number
+	 *
+	 *  @return true on success
+	 */
+	static bool bindCurrentThread(uint32_t cpu);
+
+	/**
+	 *  CPU worker thread entry, returns when the worker is stopped or fails to bind
+	 *
+	 *  @param parameter  CPU worker
+	 *  @param wresult    wait result
+	 */
+	static void workerEntry(void *parameter, wait_result_t wresult);
+
+	/**
+	 *  Schedule the event source for the earliest deadline including its leeway
+	 *
+	 *  @param now  current time in nanoseconds
+	 */
+	void rearm(uint64_t now);
+
+	/**
+	 *  Invoke expired timers and schedule the next wakeup
+	 */
+	void fire();
+
+	/**
+	 *  Timer event source action handler
+	 *
+	 *  @param owner   owner object
+	 *  @param sender  timer event source
+	 */
+	static void timerAction(OSObject *owner, IOTimerEventSource *sender);
+};
+
+#endif /* kern_timer_hpp */
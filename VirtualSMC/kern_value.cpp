@@ -6,8 +6,10 @@
 //
 
 #include <Headers/kern_iokit.hpp>
+#include <Headers/kern_time.hpp>
 #include <Headers/kern_util.hpp>
 #include <VirtualSMCSDK/kern_value.hpp>
+#include <VirtualSMCSDK/kern_vsmcapi.hpp>
 
 bool VirtualSMCValue::init(const SMC_DATA *d, SMC_DATA_SIZE sz, SMC_KEY_TYPE t, SMC_KEY_ATTRIBUTES a, SerializeLevel s) {
 	if (sz <= SMC_MAX_DATA_SIZE) {
@@ -30,12 +32,20 @@ bool VirtualSMCValue::init(const OSDictionary *dict) {
 	}
 	
 	auto value = OSDynamicCast(OSData, dict->getObject("value"));
-	if ((!value && !WIOKit::getOSDataValue(dict, "size", size)) ||
-		!WIOKit::getOSDataValue(dict, "type", type) ||
+	if (!WIOKit::getOSDataValue(dict, "type", type) ||
 		!WIOKit::getOSDataValue(dict, "attr", attr)) {
 		DBGLOG("value", "mandatory data missing in dictionary");
 		return false;
 	}
+
+	// Size may be omitted for value-less fixed-width types.
+	if (!value && !WIOKit::getOSDataValue(dict, "size", size)) {
+		size = VirtualSMCAPI::getTypeSize(type);
+		if (size == 0) {
+			DBGLOG("value", "mandatory size missing in dictionary");
+			return false;
+		}
+	}
 	
 	if (size == 0 && value)
 		size = value->getLength();
@@ -63,3 +73,7 @@ SMC_RESULT VirtualSMCValue::update(const SMC_DATA *src) {
 	lilu_os_memcpy(data, src, size);
 	return SmcSuccess;
 }
+
+bool VirtualSMCValue::validSize() const {
+	return VirtualSMCAPI::isValidTypeSize(type, size);
+}
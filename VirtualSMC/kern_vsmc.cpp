@@ -11,9 +11,11 @@
 #include <Headers/kern_iokit.hpp>
 #include <Headers/kern_crypto.hpp>
 #include <Headers/kern_version.hpp>
+#include <Headers/kern_time.hpp>
 #include <Headers/plugin_start.hpp>
 #include <IOKit/pwr_mgt/IOPM.h>
 #include <IOKit/IODeviceTreeSupport.h>
+#include <IOKit/IOUserClient.h>
 #include <VirtualSMCSDK/AppleSmcBridge.hpp>
 
 #include "kern_vsmc.hpp"
@@ -74,6 +76,16 @@ bool VirtualSMC::start(IOService *provider) {
 		SYSLOG("vsmc", "watchdog loop allocation failure");
 	}
 
+	// Timer actions may take long (e.g. ACPI evaluation), so the service does not share the watchdog work loop.
+	timerService = new VirtualSMCTimerService;
+	if (!timerService || !timerService->init(this)) {
+		SYSLOG("vsmc", "timer service allocation failure");
+		if (timerService)
+			timerService->deinit();
+		delete timerService;
+		timerService = nullptr;
+	}
+
 	int computerModel = BaseDeviceInfo::get().modelType;
 	if (computerModel == WIOKit::ComputerModel::ComputerAny) {
 		DBGLOG("vsmc", "failed to determine laptop or desktop model");
@@ -105,12 +117,19 @@ bool VirtualSMC::start(IOService *provider) {
 
 	auto store = OSDynamicCast(OSDictionary, getProperty("Keystore"));
 	auto userStore = OSDynamicCast(OSDictionary, getProperty("UserKeystore"));
-	if (!keystore->init(store, userStore, deviceInfo, boardIdentifier, computerModel, VirtualSMCProvider::getFirmwareBackendStatus())) {
+	if (!keystore->init(store, userStore, deviceInfo, boardIdentifier, computerModel, VirtualSMCProvider::getFirmwareBackendStatus(), timerService)) {
 		SYSLOG("vsmc", "keystore initialisation failure");
 		delete keystore;
 		return false;
 	}
 
+	auto freezeTimeout = keystore->getFreezeTimeout();
+	// Freezing does not need to be precise, let it share a wakeup.
+	if (timerService && freezeTimeout > 0 && !timerService->add(freezeAction, this, freezeTimeout * 1000, false, 1000))
+		SYSLOG("vsmc", "freeze timer allocation failure");
+
+	loadInterruptPolicies();
+
 	PMinit();
 	provider->joinPMtree(this);
 	registerPowerDriver(this, powerStates, arrsize(powerStates));
@@ -125,12 +144,13 @@ bool VirtualSMC::start(IOService *provider) {
 	removeProperty("OverrideModelInfo");
 	removeProperty("Keystore");
 	removeProperty("UserKeystore");
+	removeProperty("InterruptPolicy");
 
 	setProperty("VersionInfo", kextVersion);
 
-	pmio = new SMCProtocolPMIO;
+	pmio = new SMCProtocolPMIO(keystore, &protocolEvents);
 	if (deviceInfo.getGeneration() >= SMCInfo::Generation::V2)
-		mmio = new SMCProtocolMMIO;
+		mmio = new SMCProtocolMMIO(keystore, &protocolEvents);
 	
 	if (!pmio || (!mmio && deviceInfo.getGeneration() >= SMCInfo::Generation::V2)) {
 		SYSLOG("vsmc", "protocol allocation failure");
@@ -140,15 +160,27 @@ bool VirtualSMC::start(IOService *provider) {
 		return false;
 	}
 
-	interruptsLock = IOSimpleLockAlloc();
-	if (!interruptsLock)
-		PANIC("vsmc", "failed to allocate interrupt lock");
+	uint32_t recordCount = 0;
+	if (lilu_get_boot_args("vsmcrec", &recordCount, sizeof(recordCount)) && recordCount > 0) {
+		recorder = new SMCTransactionRecorder;
+		if (recorder && recorder->init(recordCount)) {
+			pmio->setRecorder(recorder);
+			if (mmio)
+				mmio->setRecorder(recorder);
+		} else {
+			SYSLOG("vsmc", "transaction recorder allocation failure");
+			delete recorder;
+			recorder = nullptr;
+		}
+	}
 
 	// Reserve interrupt slots
-	if (!storedInterrupts.reserve(MaxActiveInterrupts) ||
-		!registeredInterrupts.reserve(MaxActiveInterrupts)) {
+	if (!registeredInterrupts.reserve(MaxActiveInterrupts))
 		PANIC("vsmc", "failed to reserve interrupt slots");
-	}
+
+	// Interrupt data takes 256 slots of SMC_MAX_LOG_SIZE bytes, keep it out of the service object.
+	if (!interruptQueue.init())
+		PANIC("vsmc", "failed to allocate interrupt data");
 
 	// Service initialisation may be delayed to allow trap hook to be initialised
 	instance = this;
@@ -174,6 +206,163 @@ bool VirtualSMC::start(IOService *provider) {
 	return true;
 }
 
+void VirtualSMC::freezeAction(void *owner) {
+	auto vsmc = OSDynamicCast(VirtualSMC, static_cast<OSObject *>(owner));
+	if (vsmc) {
+		DBGLOG("vsmc", "freeze timeout arrived");
+		vsmc->keystore->freeze();
+	} else {
+		SYSLOG("vsmc", "freeze action conversion failure");
+	}
+}
+
+void VirtualSMC::loadInterruptPolicies() {
+	auto policies = OSDynamicCast(OSDictionary, getProperty("InterruptPolicy"));
+	auto iterator = policies ? OSCollectionIterator::withCollection(policies) : nullptr;
+	if (iterator) {
+		OSSymbol *key;
+		while ((key = OSDynamicCast(OSSymbol, iterator->getNextObject())) != nullptr) {
+			auto code = strtoul(key->getCStringNoCopy(), nullptr, 0);
+			auto policy = OSDynamicCast(OSDictionary, policies->getObject(key));
+			// Key done events are part of the protocol and must never be delayed.
+			if (!policy || code == 0 || code >= InterruptRingSize || code == SmcEventKeyDone) {
+				SYSLOG("vsmc", "ignoring invalid interrupt policy %s", key->getCStringNoCopy());
+				continue;
+			}
+
+			auto window = OSDynamicCast(OSNumber, policy->getObject("CoalesceWindow"));
+			auto rate = OSDynamicCast(OSNumber, policy->getObject("RateLimit"));
+			auto &p = interruptPolicies[code];
+			p.window = window ? window->unsigned64BitValue() * NSEC_PER_MSEC : 0;
+			p.rate = p.burst = rate ? rate->unsigned32BitValue() : 0;
+		}
+		iterator->release();
+	}
+
+	uint32_t window = 0, rate = 0;
+	bool hasWindow = lilu_get_boot_args("vsmcintwin", &window, sizeof(window));
+	bool hasRate = lilu_get_boot_args("vsmcintrate", &rate, sizeof(rate));
+
+	bool anyPolicy = false;
+	for (size_t code = 1; code < InterruptRingSize; code++) {
+		if (code == SmcEventKeyDone)
+			continue;
+		auto &p = interruptPolicies[code];
+		if (hasWindow)
+			p.window = static_cast<uint64_t>(window) * NSEC_PER_MSEC;
+		if (hasRate)
+			p.rate = p.burst = rate;
+		if (p.window > 0 || p.rate > 0)
+			anyPolicy = true;
+	}
+
+	if (anyPolicy && watchDogWorkLoop) {
+		interruptTimer = IOTimerEventSource::timerEventSource(this, interruptAction);
+		if (interruptTimer)
+			watchDogWorkLoop->addEventSource(interruptTimer);
+		else
+			SYSLOG("vsmc", "interrupt timer allocation failure");
+	}
+}
+
+uint64_t VirtualSMC::checkInterruptPolicy(SMC_EVENT_CODE code, uint64_t now) {
+	auto &p = interruptPolicies[code];
+	uint64_t delay = 0;
+
+	if (p.window > 0 && p.lastQueued > 0 && now - p.lastQueued < p.window)
+		delay = p.window - (now - p.lastQueued);
+
+	if (p.rate > 0) {
+		uint64_t capacity = static_cast<uint64_t>(p.burst) * NSEC_PER_SEC;
+		uint64_t elapsed = now - p.lastRefill;
+		if (elapsed >= (capacity - p.tokens) / p.rate)
+			p.tokens = capacity;
+		else
+			p.tokens += elapsed * p.rate;
+		p.lastRefill = now;
+
+		if (p.tokens < NSEC_PER_SEC) {
+			uint64_t wait = (NSEC_PER_SEC - p.tokens + p.rate - 1) / p.rate;
+			if (wait > delay)
+				delay = wait;
+		}
+	}
+
+	if (delay == 0) {
+		if (p.rate > 0)
+			p.tokens -= NSEC_PER_SEC;
+		p.lastQueued = now;
+	}
+
+	return delay;
+}
+
+void VirtualSMC::scheduleInterruptTimer(uint64_t deadline, uint64_t now) {
+	uint64_t current = atomic_load(&interruptTimerDeadline);
+	while (deadline < current) {
+		if (atomic_compare_exchange_weak(&interruptTimerDeadline, &current, deadline)) {
+			// Callers winning one after another may arm the timer in reverse order. Whoever lowered the deadline
+			// arms after us, so re-arming while the deadline is below ours leaves the earliest one armed last.
+			while (true) {
+				uint64_t delayUs = deadline > now ? (deadline - now + NSEC_PER_USEC - 1) / NSEC_PER_USEC : 1;
+				interruptTimer->setTimeoutUS(static_cast<uint32_t>(delayUs > UINT32_MAX ? UINT32_MAX : delayUs));
+				current = atomic_load(&interruptTimerDeadline);
+				if (current >= deadline)
+					break;
+				deadline = current;
+				now = getCurrentTimeNs();
+			}
+			break;
+		}
+	}
+}
+
+void VirtualSMC::interruptAction(OSObject *owner, IOTimerEventSource *sender) {
+	auto vsmc = OSDynamicCast(VirtualSMC, owner);
+	if (!vsmc) {
+		SYSLOG("vsmc", "interrupt action conversion failure");
+		return;
+	}
+
+	// Reset the deadline before scanning, so that any code deferred afterwards reschedules the timer.
+	atomic_store(&vsmc->interruptTimerDeadline, UINT64_MAX);
+
+	auto now = getCurrentTimeNs();
+	uint64_t next = UINT64_MAX;
+	bool cause = false;
+
+	for (size_t i = 0; i < arrsize(vsmc->deferredInterrupts); i++) {
+		uint64_t bits = atomic_load(&vsmc->deferredInterrupts[i]);
+		while (bits) {
+			auto bit = __builtin_ctzll(bits);
+			bits &= bits - 1;
+
+			auto code = static_cast<SMC_EVENT_CODE>(i * 64 + bit);
+			auto delay = vsmc->checkInterruptPolicy(code, now);
+			if (delay > 0) {
+				if (now + delay < next)
+					next = now + delay;
+				continue;
+			}
+
+			atomic_fetch_and(&vsmc->deferredInterrupts[i], ~(1ULL << bit));
+			vsmc->interruptQueue.at(code).queueTime = now;
+			bool intrs = ml_set_interrupts_enabled(FALSE);
+			if (vsmc->interruptQueue.push(code))
+				cause = true;
+			ml_set_interrupts_enabled(intrs);
+		}
+	}
+
+	if (next != UINT64_MAX)
+		vsmc->scheduleInterruptTimer(next, now);
+
+	if (cause) {
+		DBGLOG("vsmc", "causing deferred interrupt");
+		vsmc->causeInterrupt(EventInterruptNo);
+	}
+}
+
 void VirtualSMC::watchDogAction(OSObject *owner, IOTimerEventSource *sender) {
 	auto vsmc = OSDynamicCast(VirtualSMC, owner);
 	if (vsmc) {
@@ -361,6 +550,101 @@ void VirtualSMC::stop(IOService * provider) {
 	IOACPIPlatformDevice::stop(this);
 }
 
+bool VirtualSMC::serializeProperties(OSSerialize *s) const {
+	if (keystore) {
+		auto stats = keystore->createStatistics();
+		if (stats) {
+			const_cast<VirtualSMC *>(this)->setProperty("KeystoreStatistics", stats);
+			stats->release();
+		}
+	}
+
+	// The log itself can be up to a megabyte, it is only exported on request (see setProperties).
+	if (recorder)
+		const_cast<VirtualSMC *>(this)->setProperty("TransactionCount", recorder->getRecorded(), 64);
+
+	auto intrStats = OSDictionary::withCapacity(4);
+	if (intrStats) {
+		struct {
+			const char *name;
+			uint64_t value;
+		} counters[] {
+			{"Posted", atomic_load_explicit(&interruptsPosted, memory_order_relaxed)},
+			{"Coalesced", atomic_load_explicit(&interruptsCoalesced, memory_order_relaxed)},
+			{"Deferred", atomic_load_explicit(&interruptsDeferred, memory_order_relaxed)},
+			{"Delivered", atomic_load_explicit(&interruptsDelivered, memory_order_relaxed)}
+		};
+
+		for (auto &counter : counters) {
+			auto num = OSNumber::withNumber(counter.value, 64);
+			if (num) {
+				intrStats->setObject(counter.name, num);
+				num->release();
+			}
+		}
+
+		const_cast<VirtualSMC *>(this)->setProperty("InterruptStatistics", intrStats);
+		intrStats->release();
+	}
+
+	if (timerService) {
+		const_cast<VirtualSMC *>(this)->setProperty("TimerWakeups", timerService->getWakeups(), 64);
+		const_cast<VirtualSMC *>(this)->setProperty("TimerInvocations", timerService->getInvocations(), 64);
+		const_cast<VirtualSMC *>(this)->setProperty("TimerEarlyInvocations", timerService->getEarlyInvocations(), 64);
+		const_cast<VirtualSMC *>(this)->setProperty("TimerEstimatedCostUs", timerService->getEstimatedCost(), 64);
+	}
+
+	auto intrLatency = const_cast<VirtualSMC *>(this)->interruptTracer.createStatistics();
+	if (intrLatency) {
+		const_cast<VirtualSMC *>(this)->setProperty("InterruptLatency", intrLatency);
+		intrLatency->release();
+	}
+
+	if (mmio) {
+		auto trapStats = VirtualSMCProvider::createTrapStatistics();
+		if (trapStats) {
+			const_cast<VirtualSMC *>(this)->setProperty("MMIOTrapStatistics", trapStats);
+			trapStats->release();
+		}
+	}
+
+	return IOACPIPlatformDevice::serializeProperties(s);
+}
+
+IOReturn VirtualSMC::setProperties(OSObject *properties) {
+	auto dict = OSDynamicCast(OSDictionary, properties);
+	auto dump = dict ? dict->getObject("DumpTransactionLog") : nullptr;
+	if (dump == kOSBooleanTrue || dump == kOSBooleanFalse) {
+		// Recorded key names reveal the host activity, only let administrators see them.
+		if (IOUserClient::clientHasPrivilege(current_task(), kIOClientPrivilegeAdministrator) != kIOReturnSuccess)
+			return kIOReturnNotPrivileged;
+		if (!recorder)
+			return kIOReturnUnsupported;
+		// Take a snapshot to be read from TransactionLog, false drops it.
+		if (dump == kOSBooleanTrue) {
+			auto log = recorder->createLog();
+			if (!log)
+				return kIOReturnNoMemory;
+			setProperty("TransactionLog", log);
+			log->release();
+		} else {
+			removeProperty("TransactionLog");
+		}
+		return kIOReturnSuccess;
+	}
+
+	if (dict && dict->getObject("ResetMMIOTrapStatistics") == kOSBooleanTrue) {
+		// Any client could otherwise wipe the statistics someone else is collecting.
+		if (IOUserClient::clientHasPrivilege(current_task(), kIOClientPrivilegeAdministrator) != kIOReturnSuccess)
+			return kIOReturnNotPrivileged;
+		DBGLOG("vsmc", "resetting mmio trap statistics");
+		VirtualSMCProvider::resetTrapStatistics();
+		return kIOReturnSuccess;
+	}
+
+	return IOACPIPlatformDevice::setProperties(properties);
+}
+
 bool VirtualSMC::devicesPresent(IOService *provider) {
 	// The use of getMatchingServices appears to be no longer possible due to IOService changes in 10.13.
 
@@ -425,94 +709,89 @@ SMCInfo::Generation VirtualSMC::forcedGeneration() {
 }
 
 void VirtualSMC::setInterrupts(bool enable) {
-	if (instance) {
-		IOSimpleLockLock(instance->interruptsLock);
-		instance->interruptsEnabled = enable;
-		IOSimpleLockUnlock(instance->interruptsLock);
-	}
+	if (instance)
+		atomic_store_explicit(&instance->interruptsEnabled, enable, memory_order_release);
 }
 
 bool VirtualSMC::postInterrupt(SMC_EVENT_CODE code, const void *data, uint32_t dataSize) {
-	if (instance) {
-		IOSimpleLockLock(instance->interruptsLock);
-		if (instance->interruptsEnabled && code > 0) {
-			if (dataSize > sizeof(StoredInterrupt::data)) {
-				IOSimpleLockUnlock(instance->interruptsLock);
-				SYSLOG("vsmc", "postInterrupt dataSize overflow %u", dataSize);
-				return false;
-			}
+	if (!instance || code == 0 || !atomic_load_explicit(&instance->interruptsEnabled, memory_order_acquire))
+		return false;
 
-			for (size_t i = 0; i < instance->storedInterrupts.size(); i++) {
-				auto &si = instance->storedInterrupts[i];
-				if (si.code == code) {
-					si.size = dataSize;
-					if (dataSize > 0)
-						lilu_os_memcpy(si.data, data, dataSize);
+	if (dataSize > sizeof(StoredInterrupt::data)) {
+		SYSLOG("vsmc", "postInterrupt dataSize overflow %u", dataSize);
+		return false;
+	}
 
-					// It should be already caused when it was added
-					IOSimpleLockUnlock(instance->interruptsLock);
-					return true;
-				}
-			}
+	atomic_fetch_add_explicit(&instance->interruptsPosted, 1, memory_order_relaxed);
 
-			if (instance->storedInterrupts.size() == MaxActiveInterrupts) {
-				IOSimpleLockUnlock(instance->interruptsLock);
-				SYSLOG("vsmc", "postInterrupt reserve overflow");
-				return false;
-			}
+	// Avoid being preempted while holding the data slot, the consumer may spin on it with interrupts disabled.
+	bool intrs = ml_set_interrupts_enabled(FALSE);
 
-			StoredInterrupt si {code, dataSize};
-			if (dataSize > 0)
-				lilu_os_memcpy(si.data, data, dataSize);
-			if (instance->storedInterrupts.push_back(si)) {
-				// Cause interrupt immediately if it is the first one
-				bool oneIntr = instance->storedInterrupts.size() == 1;
-				IOSimpleLockUnlock(instance->interruptsLock);
-				if (oneIntr) {
-					DBGLOG("vsmc", "causing interrupt %02X with size %u", code, dataSize);
-					instance->causeInterrupt(EventInterruptNo);
-				}
-				return true;
-			}
+	// Update the latest data, concurrent posters of the same code are serialised by the sequence counter.
+	auto &queue = instance->interruptQueue;
+	queue.store(code, data, dataSize);
 
-			IOSimpleLockUnlock(instance->interruptsLock);
-			SYSLOG("vsmc", "unable to store interrupt");
-		} else {
-			IOSimpleLockUnlock(instance->interruptsLock);
+	// Already queued codes deliver the updated data, it should be already caused when it was added.
+	if (!queue.setPending(code)) {
+		ml_set_interrupts_enabled(intrs);
+		atomic_fetch_add_explicit(&instance->interruptsCoalesced, 1, memory_order_relaxed);
+		return true;
+	}
+
+	auto now = getCurrentTimeNs();
+	auto &si = queue.at(code);
+	si.postTime = si.queueTime = now;
+
+	// Hold the code back if its policy does not allow delivery yet, further posts coalesce meanwhile.
+	auto &policy = instance->interruptPolicies[code];
+	if (instance->interruptTimer && (policy.window > 0 || policy.rate > 0)) {
+		auto delay = instance->checkInterruptPolicy(code, now);
+		if (delay > 0) {
+			atomic_fetch_or(&instance->deferredInterrupts[code / 64], 1ULL << (code % 64));
+			ml_set_interrupts_enabled(intrs);
+			atomic_fetch_add_explicit(&instance->interruptsDeferred, 1, memory_order_relaxed);
+			instance->scheduleInterruptTimer(now + delay, now);
+			return true;
 		}
 	}
-	
-	return false;
+
+	bool oneIntr = queue.push(code);
+
+	ml_set_interrupts_enabled(intrs);
+
+	if (oneIntr) {
+		DBGLOG("vsmc", "causing interrupt %02X with size %u", code, dataSize);
+		instance->causeInterrupt(EventInterruptNo);
+	}
+
+	return true;
 }
 
 SMC_EVENT_CODE VirtualSMC::getInterrupt() {
 	if (instance) {
-		IOSimpleLockLock(instance->interruptsLock);
-
-		if (instance->storedInterrupts.size() > 0) {
-			auto &si = instance->storedInterrupts[0];
+		auto &queue = instance->interruptQueue;
+		uint64_t postTime, queueTime;
+		auto code = queue.pop(postTime, queueTime);
+		if (code != 0) {
+			uint8_t data[sizeof(StoredInterrupt::data)];
+			auto size = queue.load(code, data);
 
-			//DBGLOG("vsmc", "setting interrupt %02X with size %u", si.code, si.size);
+			//DBGLOG("vsmc", "setting interrupt %02X with size %u", code, size);
 
 			if (instance->mmio)
-				instance->mmio->setInterrupt(si.code, si.data, si.size);
+				instance->mmio->setInterrupt(code, data, size);
 			else
-				instance->pmio->setInterrupt(si.code, si.data, si.size);
+				instance->pmio->setInterrupt(code, data, size);
 
-			instance->currentEventCode = si.code;
-			instance->storedInterrupts.erase(0, false);
-
-			auto code = instance->currentEventCode;
-			auto moreIntrs = instance->storedInterrupts.size() > 0;
-			IOSimpleLockUnlock(instance->interruptsLock);
+			instance->currentEventCode = code;
+			atomic_fetch_add_explicit(&instance->interruptsDelivered, 1, memory_order_relaxed);
+			instance->interruptTracer.recordDelivery(code, postTime, queueTime, getCurrentTimeNs());
 
 			// Continue processing interrupts that are left
-			if (moreIntrs)
+			if (queue.complete())
 				instance->causeInterrupt(EventInterruptNo);
 
 			return code;
-		} else {
-			IOSimpleLockUnlock(instance->interruptsLock);
 		}
 	}
 	
@@ -520,6 +799,14 @@ SMC_EVENT_CODE VirtualSMC::getInterrupt() {
 	return 0;
 }
 
+void VirtualSMC::ProtocolEvents::postInterrupt(SMC_EVENT_CODE code) {
+	VirtualSMC::postInterrupt(code);
+}
+
+SMC_EVENT_CODE VirtualSMC::ProtocolEvents::getInterrupt() {
+	return VirtualSMC::getInterrupt();
+}
+
 void VirtualSMC::postWatchDogJob(uint8_t code, uint64_t timeout, bool last) {
 	if (instance && instance->watchDogTimer && instance->watchDogAcceptJobs) {
 		instance->watchDogTimer->cancelTimeout();
@@ -604,6 +891,10 @@ UInt8 VirtualSMC::ioRead8(UInt16 offset, IOMemoryMap *map) {
 			case SMC_PORT_OFFSET_RESULT:
 				return pmio->readResult();
 			case SMC_PORT_OFFSET_EVENT:
+				// In port i/o mode reading the event port dequeues the next stored interrupt and signals the following one.
+				// MMIO consumes them through the event status register, so only report the last delivered code here.
+				if (!mmio)
+					return pmio->readEvent();
 				return currentEventCode;
 			default:
 				PANIC("vsmc", "read to unsupported port %02X", offset);
@@ -702,6 +993,8 @@ IOReturn VirtualSMC::disableInterrupt(int source) {
 
 IOReturn VirtualSMC::causeInterrupt(int source) {
 	DBGLOG("vsmc", "causeInterrupt %d", source);
+
+	interruptTracer.recordCause(getCurrentTimeNs());
 	
 	for (size_t i = 0; i < registeredInterrupts.size(); i++) {
 		if (source == registeredInterrupts[i].source) {
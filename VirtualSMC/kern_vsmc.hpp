@@ -20,6 +20,8 @@
 #include "kern_mmio.hpp"
 #include "kern_keystore.hpp"
 #include "kern_intrs.hpp"
+#include "kern_intrtrace.hpp"
+#include "kern_timer.hpp"
 
 class EXPORT VirtualSMC : public IOACPIPlatformDevice {
 	OSDeclareDefaultStructors(VirtualSMC)
@@ -42,10 +44,15 @@ class EXPORT VirtualSMC : public IOACPIPlatformDevice {
 	/**
 	 *  Interrupts may happen during hibernation, so we are not allowed to alloc.
 	 *  For this reason we reserve the necessary amount of memory at kext start.
-	 *  Affects registeredInterrupts and storedInterrupts.
+	 *  Affects registeredInterrupts.
 	 */
 	static constexpr size_t MaxActiveInterrupts {16};
 
+	/**
+	 *  Amount of event codes, the interrupt ring has a slot for each.
+	 */
+	static constexpr size_t InterruptRingSize {SMCInterruptQueue::Size};
+
 	/**
 	 *  Maximum interrupt data size used instead of pool allocation.
 	 */
@@ -57,22 +64,96 @@ class EXPORT VirtualSMC : public IOACPIPlatformDevice {
 	evector<RegisteredInterrupt&> registeredInterrupts;
 
 	/**
-	 *  Stored interrupts for the delivery (event queue)
+	 *  Pending interrupts with their latest data, the data table is allocated at start
 	 */
-	evector<StoredInterrupt&> storedInterrupts;
+	SMCInterruptQueue interruptQueue;
 
 	/**
 	 *  Interrupt status set by enableInterrupt/disableInterrupt functions
 	 */
-	bool interruptsEnabled {false};
+	_Atomic(bool) interruptsEnabled {false};
+
+	/**
+	 *  Interrupt delivery policy and its state for a single event code.
+	 *  The state is only accessed by the owner of the pending bit of the code.
+	 */
+	struct InterruptPolicy {
+		uint64_t window;      /* minimal interval between queueing in nanoseconds, 0 - off */
+		uint32_t rate;        /* token bucket refill rate in events per second, 0 - off */
+		uint32_t burst;       /* token bucket capacity in events */
+		uint64_t lastQueued;  /* last queueing time in nanoseconds */
+		uint64_t tokens;      /* available tokens in 1/NSEC_PER_SEC units */
+		uint64_t lastRefill;  /* last token refill time in nanoseconds */
+	};
+
+	/**
+	 *  Interrupt delivery policies indexed by event code (configured by InterruptPolicy property,
+	 *  vsmcintwin and vsmcintrate boot-args)
+	 */
+	InterruptPolicy interruptPolicies[InterruptRingSize] {};
+
+	/**
+	 *  Bitmap of event codes held back by their policy (the pending bit stays set meanwhile)
+	 */
+	_Atomic(uint64_t) deferredInterrupts[InterruptRingSize / 64] {};
+
+	/**
+	 *  Deferred interrupt delivery timer, shares the watchdog work loop, only present when any policy is set
+	 */
+	IOTimerEventSource *interruptTimer {nullptr};
+
+	/**
+	 *  Currently scheduled interruptTimer deadline in nanoseconds
+	 */
+	_Atomic(uint64_t) interruptTimerDeadline {UINT64_MAX};
+
+	/**
+	 *  Interrupt delivery latency tracer
+	 */
+	SMCInterruptTracer interruptTracer;
+
+	/**
+	 *  Interrupt statistics
+	 */
+	_Atomic(uint64_t) interruptsPosted {0};
+	_Atomic(uint64_t) interruptsCoalesced {0};
+	_Atomic(uint64_t) interruptsDeferred {0};
+	_Atomic(uint64_t) interruptsDelivered {0};
 
 	/**
-	 *  Interrupt access lock
+	 *  Load interrupt delivery policies from the properties and boot-args
 	 */
-	IOSimpleLock *interruptsLock {nullptr};
+	void loadInterruptPolicies();
 
 	/**
-	 *  Current pending interrupt code
+	 *  Check whether the event code may be queued now and account it if so.
+	 *  Must only be called by the owner of the pending bit of the code.
+	 *
+	 *  @param code  event code
+	 *  @param now   current time in nanoseconds
+	 *
+	 *  @return 0 when queued or remaining delay in nanoseconds
+	 */
+	uint64_t checkInterruptPolicy(SMC_EVENT_CODE code, uint64_t now);
+
+	/**
+	 *  Schedule interruptTimer unless it is scheduled earlier, safe to call concurrently
+	 *
+	 *  @param deadline  deadline in nanoseconds
+	 *  @param now       current time in nanoseconds
+	 */
+	void scheduleInterruptTimer(uint64_t deadline, uint64_t now);
+
+	/**
+	 *  Deferred interrupt delivery timer action handler
+	 *
+	 *  @param owner   VirtualSMC instance
+	 *  @param sender  interruptTimer pointer
+	 */
+	static void interruptAction(OSObject *owner, IOTimerEventSource *sender);
+
+	/**
+	 *  Last delivered interrupt code
 	 */
 	SMC_EVENT_CODE currentEventCode {};
 
@@ -96,6 +177,20 @@ class EXPORT VirtualSMC : public IOACPIPlatformDevice {
 	 */
 	SMCProtocolMMIO *mmio {nullptr};
 
+	/**
+	 *  Protocol interrupt delivery forwarded to postInterrupt and getInterrupt
+	 */
+	class ProtocolEvents : public SMCProtocolEvents {
+	public:
+		void postInterrupt(SMC_EVENT_CODE code) override;
+		SMC_EVENT_CODE getInterrupt() override;
+	} protocolEvents;
+
+	/**
+	 *  Transaction recorder (configured by vsmcrec boot-arg, off by default)
+	 */
+	SMCTransactionRecorder *recorder {nullptr};
+
 	/**
 	 *  Power state name indexes
 	 */
@@ -115,6 +210,9 @@ class EXPORT VirtualSMC : public IOACPIPlatformDevice {
 
 	/**
 	 *  Software implementation for watchdog timer
+	 *  It does not use the timer service: jobs are posted from NATJ and OSWD writes, which may come
+	 *  from the MMIO trap handler and cannot enter the service gate, and a forced restart must not
+	 *  wait for plugin timer actions, which may be the very thing that is stuck.
 	 */
 	IOTimerEventSource *watchDogTimer {nullptr};
 
@@ -152,6 +250,18 @@ class EXPORT VirtualSMC : public IOACPIPlatformDevice {
 	 */
 	static void watchDogAction(OSObject *owner, IOTimerEventSource *sender);
 
+	/**
+	 *  Shared timer service for VirtualSMC and plugins, runs on its own work loop
+	 */
+	VirtualSMCTimerService *timerService {nullptr};
+
+	/**
+	 *  Keystore freeze timer action handler
+	 *
+	 *  @param owner  VirtualSMC instance
+	 */
+	static void freezeAction(void *owner);
+
 	/**
 	 *  Cached value of AppleSMCBufferPMIO mapping
 	 */
@@ -248,6 +358,24 @@ public:
 	 */
 	void stop(IOService *provider) override;
 
+	/**
+	 *  Refresh runtime statistics before the registry properties are serialized.
+	 *
+	 *  @param s  serializer
+	 *
+	 *  @return true on success
+	 */
+	bool serializeProperties(OSSerialize *s) const override;
+
+	/**
+	 *  Handle runtime control properties (DumpTransactionLog, ResetMMIOTrapStatistics), both need administrator privileges.
+	 *
+	 *  @param properties  property dictionary
+	 *
+	 *  @return kIOReturnSuccess on success
+	 */
+	IOReturn setProperties(OSObject *properties) override;
+
 	/**
 	 *  Obtain shared keystore, pmio/mmio protocols need it.
 	 *  Also signals vsmc availability.
@@ -258,6 +386,15 @@ public:
 		return instance->keystore;
 	}
 
+	/**
+	 *  Obtain shared timer service.
+	 *
+	 *  @return timer service or nullptr
+	 */
+	static VirtualSMCTimerService *getTimerService() {
+		return instance ? instance->timerService : nullptr;
+	}
+
 	/**
 	 *  Reports whether instance is available.
 	 *
@@ -316,6 +453,35 @@ public:
 			PANIC("vsmc", "missing mmio instance for write, instance %d", instance != nullptr);
 	}
 
+	/**
+	 *  Transfer direct-call mmio register read to the implementation.
+	 *
+	 *  @param base  mmio virtual region base address
+	 *  @param off   register offset in mmio virtual region
+	 *
+	 *  @return register value
+	 */
+	static uint8_t handleDirectRead(mach_vm_address_t base, uint32_t off) {
+		if (instance && instance->mmio)
+			return instance->mmio->directRead(base, off);
+		PANIC("vsmc", "missing mmio instance for direct read, instance %d", instance != nullptr);
+		return 0;
+	}
+
+	/**
+	 *  Transfer direct-call mmio register write to the implementation.
+	 *
+	 *  @param base   mmio virtual region base address
+	 *  @param off    register offset in mmio virtual region
+	 *  @param value  register value
+	 */
+	static void handleDirectWrite(mach_vm_address_t base, uint32_t off, uint8_t value) {
+		if (instance && instance->mmio)
+			instance->mmio->directWrite(base, off, value);
+		else
+			PANIC("vsmc", "missing mmio instance for direct write, instance %d", instance != nullptr);
+	}
+
 	/**
 	 *  Detect user-specified or os-specific overrides enforcing SMC generation to use.
 	 *  Currently the override list includes:
@@ -346,7 +512,9 @@ public:
 	static bool postInterrupt(SMC_EVENT_CODE code, const void *data=nullptr, uint32_t dataSize=0);
 
 	/**
-	 *  Consume stored interrupt.
+	 *  Consume stored interrupt. There must be exactly one consumer: only the SMC protocol handling
+	 *  may call this, and AppleSMC must serialise its event register reads. Concurrent callers corrupt
+	 *  the ring head and may deliver one code twice or lose another.
 	 *
 	 *  @retrun interrupt code or 0 if nothing is found
 	 */
@@ -35,6 +35,40 @@ bool VirtualSMCAPI::postInterrupt(SMC_EVENT_CODE code, const void *data, uint32_
 	return VirtualSMC::postInterrupt(code, data, dataSize);
 }
 
+uint32_t VirtualSMCAPI::registerTimer(TimerAction action, void *context, uint32_t intervalMs, bool periodic, uint32_t leewayMs) {
+	auto service = VirtualSMC::getTimerService();
+	if (!service) {
+		SYSLOG("vsmcapi", "timer service is unavailable");
+		return 0;
+	}
+	return service->add(action, context, intervalMs, periodic, leewayMs);
+}
+
+uint32_t VirtualSMCAPI::registerSamplingTask(const SamplingTask &task) {
+	auto service = VirtualSMC::getTimerService();
+	if (!service) {
+		SYSLOG("vsmcapi", "timer service is unavailable");
+		return 0;
+	}
+	return service->add(task);
+}
+
+void VirtualSMCAPI::unregisterTimer(uint32_t timer) {
+	auto service = VirtualSMC::getTimerService();
+	if (service && timer != 0)
+		service->remove(timer);
+}
+
+bool VirtualSMCAPI::updateKeys(Plugin *plugin, KeyStorage &data, KeyStorage &dataHidden, const SMC_KEY *removed, size_t removedNum) {
+	if (!VirtualSMC::isServicingReady()) {
+		SYSLOG("vsmcapi", "key update before servicing from %s", plugin->product);
+		data.deinit();
+		dataHidden.deinit();
+		return false;
+	}
+	return VirtualSMC::getKeystore()->updatePlugin(plugin, data, dataHidden, removed, removedNum) == kIOReturnSuccess;
+}
+
 bool VirtualSMCAPI::getDeviceInfo(SMCInfo &info) {
 	if (!VirtualSMC::isServicingReady())
 		return false;
@@ -44,7 +78,10 @@ bool VirtualSMCAPI::getDeviceInfo(SMCInfo &info) {
 
 bool VirtualSMCAPI::addKey(SMC_KEY key, VirtualSMCAPI::KeyStorage &data, VirtualSMCValue *val) {
 	if (val) {
-		if (data.push_back<4>(VirtualSMCKeyValue::create(key, val))) {
+		if (!val->validSize()) {
+			SYSLOG("vsmcapi", "invalid size for key [%08X] type", key);
+			delete val;
+		} else if (data.push_back<4>(VirtualSMCKeyValue::create(key, val))) {
 			DBGLOG("vsmcapi", "inserted key [%08X]", key);
 			return true;
 		} else {
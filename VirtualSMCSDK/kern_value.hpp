@@ -10,6 +10,7 @@
 
 #include <Headers/kern_util.hpp>
 #include <libkern/c++/OSData.h>
+#include <stdatomic.h>
 
 #include <VirtualSMCSDK/AppleSmcBridge.hpp>
 
@@ -119,6 +120,14 @@ public:
 	 */
 	virtual SMC_RESULT update(const SMC_DATA *src);
 
+	/**
+	 *  Checks value size against the canonical size of its type
+	 *  (see VirtualSMCAPI::getTypeSize)
+	 *
+	 *  @return true if the size is valid for the type
+	 */
+	EXPORT bool validSize() const;
+
 	/**
 	 *  Checks serialization necessity
 	 *
@@ -11,6 +11,7 @@
 #include <Headers/kern_util.hpp>
 #include <VirtualSMCSDK/kern_smcinfo.hpp>
 #include <VirtualSMCSDK/kern_keyvalue.hpp>
+#include <VirtualSMCSDK/kern_vsmctypes.hpp>
 #include <IOKit/IOService.h>
 
 namespace VirtualSMCAPI {
@@ -28,20 +29,130 @@ namespace VirtualSMCAPI {
 	static constexpr const char *SubmitPlugin = "VirtualSMCSubmitPlugin";
 
 	/**
-	 *  A total maximum of allowed plugins for installation.
+	 *  Former maximum of allowed plugins for installation, kept for source compatibility.
+	 *  The amount of plugins is no longer limited.
 	 */
 	static constexpr size_t PluginMax = 16;
 
 	/**
 	 *  Accepted plugin API (and ABI) compatibility
+	 *  Version 2 allows updating plugin keys after submission (see updateKeys).
 	 */
-	static constexpr size_t Version = 1;
+	static constexpr size_t Version = 2;
+
+	/**
+	 *  Oldest accepted plugin API, Plugin structure fields past dataHidden are only read since version 2
+	 */
+	static constexpr size_t VersionMin = 1;
 
 	/**
 	 *  Sorted key storage containing pairs of keys and values.
 	 */
 	using KeyStorage = evector<VirtualSMCKeyValue&, VirtualSMCKeyValue::deleter>;
 
+	/**
+	 *  Canonical value size table entry
+	 */
+	struct TypeSize {
+		SMC_KEY_TYPE type;
+		SMC_DATA_SIZE size;
+	};
+
+	/**
+	 *  Canonical value sizes of fixed-width key types.
+	 *  Types with model-specific layouts, such as strings, arrays (including ui8 and ui16),
+	 *  and several structures (e.g. {lim or {jst) have no fixed size and are not listed.
+	 *  Sizes were verified against the SMC dumps found in Docs/SMCDumps.
+	 */
+	static constexpr TypeSize TypeSizes[] {
+		{SmcKeyTypeChar, 1},
+		{SmcKeyTypeFlag, 1},
+		{SmcKeyTypeSint8, 1},
+		{SmcKeyTypeMss, 1},
+		{SmcKeyTypeFp1f, 2},
+		{SmcKeyTypeFp2e, 2},
+		{SmcKeyTypeFp3d, 2},
+		{SmcKeyTypeFp4c, 2},
+		{SmcKeyTypeFp5b, 2},
+		{SmcKeyTypeFp6a, 2},
+		{SmcKeyTypeFp79, 2},
+		{SmcKeyTypeFp88, 2},
+		{SmcKeyTypeFp97, 2},
+		{SmcKeyTypeFpa6, 2},
+		{SmcKeyTypeFpb5, 2},
+		{SmcKeyTypeFpc4, 2},
+		{SmcKeyTypeFpd3, 2},
+		{SmcKeyTypeFpe2, 2},
+		{SmcKeyTypeFpf1, 2},
+		{SmcKeyTypeSp1e, 2},
+		{SmcKeyTypeSp2d, 2},
+		{SmcKeyTypeSp3c, 2},
+		{SmcKeyTypeSp4b, 2},
+		{SmcKeyTypeSp5a, 2},
+		{SmcKeyTypeSp69, 2},
+		{SmcKeyTypeSp78, 2},
+		{SmcKeyTypeSp87, 2},
+		{SmcKeyTypeSp96, 2},
+		{SmcKeyTypeSpa5, 2},
+		{SmcKeyTypeSpb4, 2},
+		{SmcKeyTypeSpc3, 2},
+		{SmcKeyTypeSpd2, 2},
+		{SmcKeyTypeSpe1, 2},
+		{SmcKeyTypeSpf0, 2},
+		{SmcKeyTypeSint16, 2},
+		{SmcKeyTypeLkb, 2},
+		{SmcKeyTypeLks, 2},
+		{SmcKeyTypeLso, 2},
+		{SmcKeyTypePwm, 2},
+		{SmcKeyTypeFloat, 4},
+		{SmcKeyTypeSint32, 4},
+		{SmcKeyTypeUint32, 4},
+		{SmcKeyTypeAli, 4},
+		{SmcKeyTypeAlp, 4},
+		{SmcKeyTypeAlt, 4},
+		{SmcKeyTypeLia, 4},
+		{SmcKeyTypeAla, 6},
+		{SmcKeyTypeLsf, 6},
+		{SmcKeyTypeRev, 6},
+		{SmcKeyTypeIoft, 8},
+		{SmcKeyTypeSint64, 8},
+		{SmcKeyTypeUint64, 8},
+		{SmcKeyTypeClh, 8},
+		{SmcKeyTypeLsd, 8},
+		{SmcKeyTypeAlr, 10},
+		{SmcKeyTypeAlv, 10},
+		{SmcKeyTypeClc, 10},
+		{SmcKeyTypeLsc, 10},
+		{SmcKeyTypeHdi, 14},
+		{SmcKeyTypeAlc, 16},
+		{SmcKeyTypeFds, 16}
+	};
+
+	/**
+	 *  Obtain canonical value size for a key type
+	 *
+	 *  @param type   key type, e.g. SmcKeyTypeSp78
+	 *  @param index  TypeSizes lookup start (internal)
+	 *
+	 *  @return value size in bytes or 0 if it is not fixed
+	 */
+	constexpr SMC_DATA_SIZE getTypeSize(SMC_KEY_TYPE type, size_t index = 0) {
+		return index < arrsize(TypeSizes) ?
+			(TypeSizes[index].type == type ? TypeSizes[index].size : getTypeSize(type, index + 1)) : 0;
+	}
+
+	/**
+	 *  Check value size validity for the given key type
+	 *
+	 *  @param type  key type, e.g. SmcKeyTypeSp78
+	 *  @param size  value size
+	 *
+	 *  @return true if the size fits SMC_DATA and matches canonical size if any
+	 */
+	constexpr bool isValidTypeSize(SMC_KEY_TYPE type, SMC_DATA_SIZE size) {
+		return size > 0 && size <= SMC_MAX_DATA_SIZE && (getTypeSize(type) == 0 || getTypeSize(type) == size);
+	}
+
 	/**
 	 *  Main description structure submitted by a plugin. Must be unchanged and never deallocated after submission.
 	 */
@@ -51,6 +162,12 @@ namespace VirtualSMCAPI {
 		size_t apiver;              // Product API compatibility (i.e. VirtualSMCAPIVersion)
 		// Please note, that storage vectors MUST be sorted. Otherwise the behaviour is undefined.
 		KeyStorage data, dataHidden;
+		// Owned key ranges (API version 2), all plugin keys must be within them.
+		// Plugins with ranges overlapping other ranges or keys of other plugins are refused,
+		// and lookups of keys within ranges only consult the declaring plugin.
+		// Plugins declaring no ranges may own any key outside of declared ranges.
+		const KeyRange *ranges {nullptr};
+		size_t rangeNum {0};
 	};
 
 	/**
@@ -75,6 +192,61 @@ namespace VirtualSMCAPI {
 	 */
 	EXPORT bool postInterrupt(SMC_EVENT_CODE code, const void *data=nullptr, uint32_t dataSize=0);
 
+	/**
+	 *  Register a timer on the shared VirtualSMC timer service instead of creating own timers.
+	 *  Timers with a leeway may be delayed to share wakeups with others.
+	 *  Note, this may only be used after SubmitPlugin and not from interrupt context.
+	 *
+	 *  @param action      timer action
+	 *  @param context     timer action context
+	 *  @param intervalMs  interval before the (first) invocation in milliseconds
+	 *  @param periodic    repeat every intervalMs until unregistered
+	 *  @param leewayMs    allowed invocation delay in milliseconds
+	 *
+	 *  @return timer handle or 0 on failure
+	 */
+	EXPORT uint32_t registerTimer(TimerAction action, void *context, uint32_t intervalMs, bool periodic=true, uint32_t leewayMs=0);
+
+	/**
+	 *  Register a sampling task on the shared VirtualSMC timer service instead of polling in own threads.
+	 *  Due tasks are batched into a single wakeup, and tasks within their jitter may run early to join it.
+	 *  CPU affine actions run on a worker thread bound to the requested CPU, while the timer work loop waits,
+	 *  so they must be short, and registering or unregistering timers from them fails.
+	 *  Note, this may only be used after SubmitPlugin and not from interrupt context.
+	 *
+	 *  @param task  sampling task description
+	 *
+	 *  @return timer handle for unregisterTimer or 0 on failure
+	 */
+	EXPORT uint32_t registerSamplingTask(const SamplingTask &task);
+
+	/**
+	 *  Unregister a timer registered by registerTimer or registerSamplingTask.
+	 *  Once this returns the timer action is neither running nor invoked later.
+	 *
+	 *  @param timer  timer handle
+	 */
+	EXPORT void unregisterTimer(uint32_t timer);
+
+	/**
+	 *  Atomically add and remove plugin keys after submission.
+	 *  New key set is published at once, SMC readers never observe partial updates and never block.
+	 *  Removed values are deleted after all the SMC transactions that could see them finish.
+	 *  Added keys must not exist in the keystore unless they are removed by the same call.
+	 *  Updates do not freeze the keystore (see vsmcfrzq and vsmcfrzt), an unfrozen one stays unfrozen.
+	 *  Note, this may only be used by API version 2 plugins after SubmitPlugin, not from interrupt context,
+	 *  and not from within key value callbacks.
+	 *
+	 *  @param plugin      submitted plugin
+	 *  @param data        sorted public keys to add, consumed and left empty
+	 *  @param dataHidden  sorted hidden keys to add, consumed and left empty
+	 *  @param removed     plugin keys to remove
+	 *  @param removedNum  number of keys to remove
+	 *
+	 *  @return true on success, invalid arguments leave the key set unchanged
+	 */
+	EXPORT bool updateKeys(Plugin *plugin, KeyStorage &data, KeyStorage &dataHidden, const SMC_KEY *removed=nullptr, size_t removedNum=0);
+
 	/**
 	 *  Obtain emulated SMC device info to determine used keys and their format.
 	 *  Note, this may only be used within SubmitPlugin or afterwards.
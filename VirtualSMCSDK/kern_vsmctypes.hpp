@@ -0,0 +1,68 @@
+//
+//  kern_vsmctypes.hpp
+//  VirtualSMC
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_vsmctypes_hpp
+#define kern_vsmctypes_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <VirtualSMCSDK/AppleSmcBridge.hpp>
+
+/**
+ *  Plain VirtualSMC API types, which do not depend on kernel objects
+ */
+namespace VirtualSMCAPI {
+	/**
+	 *  Inclusive range of keys in VirtualSMCKeyValue::compare order
+	 */
+	struct KeyRange {
+		SMC_KEY first;
+		SMC_KEY last;
+	};
+
+	/**
+	 *  Make a range of all keys starting with the given characters
+	 *
+	 *  @param a  first key character
+	 *  @param b  second key character
+	 *
+	 *  @return key range
+	 */
+	constexpr KeyRange makeKeyRange(uint8_t a) {
+		return {SMC_MAKE_IDENTIFIER(a, 0x00, 0x00, 0x00), SMC_MAKE_IDENTIFIER(a, 0xFF, 0xFF, 0xFF)};
+	}
+
+	constexpr KeyRange makeKeyRange(uint8_t a, uint8_t b) {
+		return {SMC_MAKE_IDENTIFIER(a, b, 0x00, 0x00), SMC_MAKE_IDENTIFIER(a, b, 0xFF, 0xFF)};
+	}
+
+	/**
+	 *  Shared timer action, invoked on the VirtualSMC timer work loop
+	 *
+	 *  @param context  context passed at registration
+	 */
+	using TimerAction = void (*)(void *context);
+
+	/**
+	 *  CPU affinity value for sampling tasks runnable on any CPU
+	 */
+	static constexpr int32_t AnyCpu {-1};
+
+	/**
+	 *  Periodic sensor sampling task description
+	 */
+	struct SamplingTask {
+		TimerAction action {nullptr};      // Sampling action
+		void *context {nullptr};           // Sampling action context
+		uint32_t periodMs {0};             // Sampling period in milliseconds
+		uint32_t jitterMs {0};             // Tolerated deviation from the period in either direction, less than periodMs
+		uint32_t costUs {0};               // Expected action duration in microseconds
+		int32_t cpu {AnyCpu};              // CPU number to sample on or AnyCpu
+	};
+}
+
+#endif /* kern_vsmctypes_hpp */